@@ -20,5 +20,18 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/* One file descriptor watched by poll; same layout and bits as Linux. */
+struct ece391_pollfd {
+	int32_t fd;
+	int16_t events;
+	int16_t revents;
+};
+
+#define POLLIN		0x01
+#define POLLOUT		0x04
+
+extern int32_t ece391_poll (struct ece391_pollfd* fds, int32_t nfds,
+			    int32_t timeout);
+
 #endif /* ECE391SYSCALL_H */
 
@@ -10,6 +10,7 @@ uint8_t *mp1_set_video_mode (void);
 void add_frames(uint8_t *, uint8_t *, int32_t);
 void ece391_memset(void* memory, char c, int n);
 int32_t ece391_memcpy(void* dest, const void* src, int32_t n);
+int32_t wait_ticks(int32_t rtc_fd, int32_t n);
 
 uint8_t file0[] = "frame0.txt";
 uint8_t file1[] = "frame1.txt";
@@ -22,7 +23,7 @@ static struct mp1_blink_struct blink_array[80*25];
 
 int main(void)
 {
-    int rtc_fd, ret_val, i, garbage;
+    int rtc_fd, ret_val;
     struct mp1_blink_struct blink_struct;
 
     ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
@@ -38,9 +39,8 @@ int main(void)
     ret_val = 32;
     ret_val = ece391_write(rtc_fd, &ret_val, 4);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    if(wait_ticks(rtc_fd, WAIT) == -1) {
+        goto done;
     }
 
     blink_struct.on_char = 'I';
@@ -51,30 +51,61 @@ int main(void)
 
     mp1_ioctl((unsigned long)&blink_struct, RTC_ADD);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    if(wait_ticks(rtc_fd, WAIT) == -1) {
+        goto done;
     }
 
     mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+    if(wait_ticks(rtc_fd, WAIT) == -1) {
+        goto done;
     }
 
     mp1_ioctl(6*80+60, RTC_REMOVE);
 
-    for(i=0; i<WAIT; i++) {
-        ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
-    }
+    wait_ticks(rtc_fd, WAIT);
+
+done:
 
     ece391_close(rtc_fd);
 
     return 0;
 }
 
+/*
+ * Run the blink tasklet for n RTC ticks.  The keyboard is watched at the
+ * same time, so that entering a line ends the animation right away.
+ * Returns -1 if a line was entered, 0 otherwise.
+ */
+int32_t
+wait_ticks(int32_t rtc_fd, int32_t n)
+{
+    struct ece391_pollfd fds[2];
+    uint8_t line[128];
+    int32_t i, garbage;
+
+    fds[0].fd = 0;
+    fds[0].events = POLLIN;
+    fds[1].fd = rtc_fd;
+    fds[1].events = POLLIN;
+
+    for(i=0; i<n; ) {
+        if(ece391_poll(fds, 2, -1) == -1) {
+            return -1;
+        }
+        if(fds[0].revents & POLLIN) {
+            ece391_read(0, line, 128);
+            return -1;
+        }
+        if(fds[1].revents & POLLIN) {
+            ece391_read(rtc_fd, &garbage, 4);
+            mp1_rtc_tasklet(garbage);
+            i++;
+        }
+    }
+    return 0;
+}
+
 void
 add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 {
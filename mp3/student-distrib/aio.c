@@ -0,0 +1,308 @@
+#include "aio.h"
+#include "lib.h"
+#include "page.h"
+#include "rtc.h"
+#include "terminal.h"
+#include "system_calls.h"
+
+#define AIO_DEV_TERMINAL 0          // pending read of a line from a terminal
+#define AIO_DEV_RTC 1               // pending read of a virtual RTC tick
+
+// an operation waiting for a device interrupt
+typedef struct aio_pending_t
+{
+    uint32_t used;
+    int32_t pid;                    // owner, its ring gets the completion
+    int32_t dev;                    // AIO_DEV_TERMINAL or AIO_DEV_RTC
+    int32_t term;                   // terminal of the owner
+    uint8_t* buf;                   // kernel address of the buffer inside the ring pages
+    int32_t nbytes;
+    uint32_t user_data;
+    uint32_t seq;                   // submission order, lines go to the oldest read
+} aio_pending_t;
+
+static aio_ring_t* aio_rings[PROCESS_MAX];         // kernel address of the ring of each process, NULL if none
+static aio_pending_t aio_pending[AIO_PENDING_MAX];
+static uint32_t aio_seq = 0;
+
+/*
+* aio_post
+*   DESCRIPTION: add a completion to the ring of process pid, from any process or interrupt
+*   INPUTS: pid - owner of the ring
+*           user_data - value of the submission
+*           res - result of the operation
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: counts an overflow instead when the completion queue is full
+*/
+static void aio_post(int32_t pid, uint32_t user_data, int32_t res)
+{
+    uint32_t flags;
+    aio_ring_t* ring;
+
+    cli_and_save(flags);
+    ring = aio_rings[pid];
+    if (ring != NULL) {
+        if (ring->cq_tail - ring->cq_head >= AIO_CQ_ENTRIES) {
+            ring->cq_overflow++;
+        } else {
+            ring->cq[ring->cq_tail % AIO_CQ_ENTRIES].user_data = user_data;
+            ring->cq[ring->cq_tail % AIO_CQ_ENTRIES].res = res;
+            ring->cq_tail++;
+        }
+    }
+    restore_flags(flags);
+}
+
+/*
+* aio_queue
+*   DESCRIPTION: park a read until its device interrupt completes it
+*   INPUTS: pid - owner
+*           dev - AIO_DEV_TERMINAL or AIO_DEV_RTC
+*           term - terminal of the owner
+*           buf - kernel address of the buffer
+*           nbytes - size of the buffer
+*           user_data - value of the submission
+*   OUTPUTS: none
+*   RETURN VALUE: 0 on success, -1 if too many operations are pending
+*   SIDE EFFECTS: none
+*/
+static int32_t aio_queue(int32_t pid, int32_t dev, int32_t term, uint8_t* buf, int32_t nbytes, uint32_t user_data)
+{
+    uint32_t flags;
+    int32_t i;
+
+    cli_and_save(flags);
+    for (i = 0; i < AIO_PENDING_MAX; i++) {
+        if (aio_pending[i].used == 0) {
+            aio_pending[i].used = 1;
+            aio_pending[i].pid = pid;
+            aio_pending[i].dev = dev;
+            aio_pending[i].term = term;
+            aio_pending[i].buf = buf;
+            aio_pending[i].nbytes = nbytes;
+            aio_pending[i].user_data = user_data;
+            aio_pending[i].seq = aio_seq++;
+            restore_flags(flags);
+            return 0;
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/*
+* aio_submit
+*   DESCRIPTION: start one submission of the current process. Terminal and RTC reads wait for their
+*                interrupts, every other operation runs now
+*   INPUTS: sqe - copy of the submission
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: posts the completion unless the operation is pending
+*/
+static void aio_submit(const aio_sqe_t* sqe)
+{
+    int32_t pid = get_pid();
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    file_descriptor* file;
+    aio_ring_t* ring = aio_rings[pid];
+    uint32_t data_user = PROGRAM_VIRT_ADDR + (AIO_RING_INDEX + 1) * PAGE_SIZE;
+    uint8_t* data_kernel = (uint8_t*)ring + PAGE_SIZE;
+    uint32_t buf = (uint32_t)sqe->buf;
+    int32_t res;
+
+    if (sqe->opcode == AIO_NOP) {
+        aio_post(pid, sqe->user_data, 0);
+        return;
+    }
+    // a non-empty buffer must lie in the buffer area
+    if ((sqe->opcode != AIO_READ && sqe->opcode != AIO_WRITE) || sqe->fd < 0 || sqe->fd >= cur_pcb->fd_capacity ||
+        cur_pcb->file_descriptor_array[sqe->fd].flags == 0 || sqe->nbytes < 0 ||
+        (sqe->nbytes > 0 && (buf < data_user || buf + sqe->nbytes > data_user + AIO_DATA_SIZE))) {
+        aio_post(pid, sqe->user_data, -1);
+        return;
+    }
+    file = &cur_pcb->file_descriptor_array[sqe->fd];
+
+    if (sqe->opcode == AIO_WRITE) {
+        res = file->file_operations_table_ptr.write(sqe->fd, sqe->buf, sqe->nbytes);
+    } else if (file->file_operations_table_ptr.read == terminal_read) {
+        res = aio_queue(pid, AIO_DEV_TERMINAL, cur_pcb->terminal, data_kernel + (buf - data_user),
+                        sqe->nbytes, sqe->user_data);
+        if (res == 0) {
+            return;
+        }
+    } else if (file->file_operations_table_ptr.read == RTC_read) {
+        res = aio_queue(pid, AIO_DEV_RTC, cur_pcb->terminal, NULL, 0, sqe->user_data);
+        if (res == 0) {
+            return;
+        }
+    } else {
+        res = file->file_operations_table_ptr.read(sqe->fd, sqe->buf, sqe->nbytes);
+    }
+    aio_post(pid, sqe->user_data, res);
+}
+
+/*
+* aio_setup
+*   DESCRIPTION: map a submission/completion ring into the program region of the current process,
+*                followed by a 4KB buffer area. Calling it again returns the same ring
+*   INPUTS: ring - where to store the user address of the ring
+*   OUTPUTS: the ring address in *ring
+*   RETURN VALUE: 0 on success, -1 on failure
+*   SIDE EFFECTS: allocates two pages from the kernel page pool
+*/
+int32_t aio_setup(uint8_t** ring)
+{
+    int32_t pid = get_pid();
+    page_table_entry_t* table = program_page_table[pid];
+    uint8_t* pages;
+    int32_t i;
+
+    // check if the ring is valid
+    if (ring == NULL || !user_range_ok(ring, sizeof(uint8_t*), 1)) {
+        return -1;
+    }
+    if (aio_rings[pid] == NULL) {
+        // the program itself may use these pages
+        for (i = 0; i < AIO_RING_PAGES; i++) {
+            if (table[AIO_RING_INDEX + i].present == 1) {
+                return -1;
+            }
+        }
+        if ((pages = kpage_alloc(AIO_RING_PAGES)) == NULL) {
+            return -1;
+        }
+        memset(pages, 0, AIO_RING_PAGES * PAGE_SIZE);
+        // the kernel page pool is mapped at its physical address
+        for (i = 0; i < AIO_RING_PAGES; i++) {
+            set_pte(table, AIO_RING_INDEX + i, ((uint32_t)pages + i * PAGE_SIZE) >> 12, 1);
+        }
+        flush_tlb();
+        aio_rings[pid] = (aio_ring_t*)pages;
+    }
+    *ring = (uint8_t*)(PROGRAM_VIRT_ADDR + AIO_RING_INDEX * PAGE_SIZE);
+    return 0;
+}
+
+/*
+* aio_enter
+*   DESCRIPTION: submit entries of the ring of the current process, then wait for completions
+*   INPUTS: to_submit - maximum number of submissions to take
+*           min_complete - return once this many completions are waiting in the completion queue, or earlier when a signal arrives
+*   OUTPUTS: none
+*   RETURN VALUE: number of submissions taken, -1 if the process has no ring
+*   SIDE EFFECTS: gives the processor to other processes while waiting
+*/
+int32_t aio_enter(int32_t to_submit, int32_t min_complete)
+{
+    aio_ring_t* ring = aio_rings[get_pid()];
+    aio_sqe_t sqe;
+    int32_t submitted = 0;
+
+    if (ring == NULL || to_submit < 0) {
+        return -1;
+    }
+    while (submitted < to_submit && ring->sq_head != ring->sq_tail) {
+        // the process may rewrite the entry, work on a copy
+        sqe = ring->sq[ring->sq_head % AIO_SQ_ENTRIES];
+        ring->sq_head++;
+        aio_submit(&sqe);
+        submitted++;
+    }
+    if (min_complete > AIO_CQ_ENTRIES) {
+        min_complete = AIO_CQ_ENTRIES;
+    }
+    while ((int32_t)(ring->cq_tail - ring->cq_head) < min_complete) {
+        // a signal such as ctrl-c ends the wait
+        if (signal_pending()) {
+            break;
+        }
+        yield();
+    }
+    return submitted;
+}
+
+/*
+* aio_release
+*   DESCRIPTION: drop the pending operations and the ring of process pid
+*   INPUTS: pid - the halting process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: unmaps and frees the ring pages
+*/
+void aio_release(int32_t pid)
+{
+    uint32_t flags;
+    int32_t i;
+
+    cli_and_save(flags);
+    for (i = 0; i < AIO_PENDING_MAX; i++) {
+        if (aio_pending[i].used == 1 && aio_pending[i].pid == pid) {
+            aio_pending[i].used = 0;
+        }
+    }
+    if (aio_rings[pid] != NULL) {
+        for (i = 0; i < AIO_RING_PAGES; i++) {
+            program_page_table[pid][AIO_RING_INDEX + i].val = 0;
+        }
+        kpage_free(aio_rings[pid], AIO_RING_PAGES);
+        aio_rings[pid] = NULL;
+    }
+    restore_flags(flags);
+}
+
+/*
+* aio_terminal_line
+*   DESCRIPTION: give a line entered on a terminal to the oldest asynchronous read waiting on it,
+*                called from the PIT tick when enter is typed
+*   INPUTS: term - the terminal
+*           line - the line, ending with '\n'
+*           len - length of the line
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if a read took the line, 0 if none was waiting
+*   SIDE EFFECTS: posts the completion
+*/
+int32_t aio_terminal_line(int32_t term, const uint8_t* line, int32_t len)
+{
+    aio_pending_t* op = NULL;
+    int32_t i;
+
+    for (i = 0; i < AIO_PENDING_MAX; i++) {
+        if (aio_pending[i].used == 1 && aio_pending[i].dev == AIO_DEV_TERMINAL && aio_pending[i].term == term &&
+            (op == NULL || aio_pending[i].seq < op->seq)) {
+            op = &aio_pending[i];
+        }
+    }
+    if (op == NULL) {
+        return 0;
+    }
+    if (len > op->nbytes) {
+        len = op->nbytes;
+    }
+    memcpy(op->buf, line, len);
+    op->used = 0;
+    aio_post(op->pid, op->user_data, len);
+    return 1;
+}
+
+/*
+* aio_rtc_tick
+*   DESCRIPTION: complete the RTC reads of processes on a terminal, called by the RTC handler when the
+*                virtual RTC of the terminal ticks
+*   INPUTS: term - the terminal
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: posts the completions
+*/
+void aio_rtc_tick(int32_t term)
+{
+    int32_t i;
+
+    for (i = 0; i < AIO_PENDING_MAX; i++) {
+        if (aio_pending[i].used == 1 && aio_pending[i].dev == AIO_DEV_RTC && aio_pending[i].term == term) {
+            aio_pending[i].used = 0;
+            aio_post(aio_pending[i].pid, aio_pending[i].user_data, 0);
+        }
+    }
+}
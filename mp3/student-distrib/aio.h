@@ -0,0 +1,62 @@
+/* aio.h - Defines for the asynchronous I/O rings shared between a process and the kernel
+ */
+#ifndef AIO_H
+#define AIO_H
+#include "types.h"
+#include "loader.h"
+
+#define AIO_RING_PAGES 2            // the ring and its buffer area, one 4KB page each
+// the ring is mapped below the stack of the program region, with one unmapped guard page in between
+#define AIO_RING_INDEX (1024 - USER_STACK_PAGES - 1 - AIO_RING_PAGES)
+#define AIO_SQ_ENTRIES 64           // submission queue entries, a power of 2
+#define AIO_CQ_ENTRIES 128          // completion queue entries, a power of 2
+#define AIO_DATA_SIZE 4096          // buffer area in the second page, read and write buffers must be inside it
+#define AIO_PENDING_MAX 16          // operations waiting for a device, across all processes
+
+// operations
+#define AIO_NOP 0                   // completes with 0 right away
+#define AIO_READ 1                  // read(fd, buf, nbytes), terminal and RTC reads complete from their interrupts
+#define AIO_WRITE 2                 // write(fd, buf, nbytes)
+
+// a submission, written by the process at sq_tail
+typedef struct aio_sqe_t
+{
+    uint32_t opcode;
+    int32_t fd;
+    void* buf;                      // user address inside the buffer area
+    int32_t nbytes;
+    uint32_t user_data;             // copied to the completion
+} aio_sqe_t;
+
+// a completion, written by the kernel at cq_tail
+typedef struct aio_cqe_t
+{
+    uint32_t user_data;
+    int32_t res;                    // return value of the operation
+} aio_cqe_t;
+
+// the first page of the ring. The process owns sq_tail and cq_head, the kernel sq_head and cq_tail.
+// The indices run freely and are taken modulo the queue size
+typedef struct aio_ring_t
+{
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    volatile uint32_t cq_overflow;  // completions dropped because the completion queue was full
+    aio_sqe_t sq[AIO_SQ_ENTRIES];
+    aio_cqe_t cq[AIO_CQ_ENTRIES];
+} aio_ring_t;
+
+// system call 16, map the ring of the current process and store its user address in *ring
+extern int32_t aio_setup(uint8_t** ring);
+// system call 17, submit up to to_submit entries, then wait for min_complete completions
+extern int32_t aio_enter(int32_t to_submit, int32_t min_complete);
+// free the ring of process pid and drop its pending operations, at halt
+extern void aio_release(int32_t pid);
+// a line was entered on terminal term, 1 if an asynchronous read took it
+extern int32_t aio_terminal_line(int32_t term, const uint8_t* line, int32_t len);
+// the virtual RTC of terminal term ticked
+extern void aio_rtc_tick(int32_t term);
+
+#endif
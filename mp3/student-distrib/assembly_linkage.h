@@ -8,10 +8,14 @@
 #include "idt.h"
 #include "system_calls.h"
 #include "pit.h"
+#include "ata.h"
+#include "serial.h"
 // interrupt linkage
 extern void rtc_handler_linkage();
 extern void keyboard_handler_linkage();
 extern void pit_handler_linkage();
+extern void ata_handler_linkage();
+extern void serial_handler_linkage();
 // exception linkage
 extern void divided_error_handler_linkage();
 extern void debug_handler_linkage();
@@ -36,6 +40,13 @@ extern void simd_floating_point_handler_linkage();
 
 // system call linkage
 extern void system_call_handler_linkage();
+// sysenter system call linkage
+extern void sysenter_handler_linkage();
+
+// save the kernel stack of the current process in *save_esp and resume the one at new_esp
+extern void switch_stack(uint32_t* save_esp, uint32_t new_esp);
+// first code a process started by process_start runs, returns to user space
+extern void process_start_linkage();
 
 
 #endif
@@ -0,0 +1,285 @@
+#include "ata.h"
+#include "lib.h"
+#include "i8259.h"
+#include "pit.h"
+
+// number of polls before giving up on the drive
+#define ATA_TIMEOUT 1000000
+// PIT ticks to wait for the interrupt of a sector before polling, 100 - one second
+#define ATA_IRQ_TICKS 100
+// 0x200 - interrupt enable flag in EFLAGS
+#define EFLAGS_IF 0x200
+
+static volatile uint32_t ata_irq_pending = 0;   // 1 - the drive interrupted since the waiter last looked
+static uint32_t ata_present = 0;                // 1 - filesystem drive found by ata_init
+static uint32_t ata_sectors = 0;                // addressable sectors reported by IDENTIFY
+
+/*
+* ata_delay
+*   DESCRIPTION: wait about 400ns for the drive to update its status after a command or drive select
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ata_delay(void)
+{
+    // each read of the alternate status port takes about 100ns
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+    inb(ATA_PRIMARY_CTRL);
+}
+
+/*
+* ata_read_words
+*   DESCRIPTION: read count 16-bit words from the data port
+*   INPUTS: buf - buffer to fill
+*           count - number of words to read
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: fills buf
+*/
+static void ata_read_words(uint16_t* buf, uint32_t count)
+{
+    asm volatile ("                 \n\
+            movw    %%ds, %%ax      \n\
+            movw    %%ax, %%es      \n\
+            cld                     \n\
+            rep     insw            \n\
+            "
+            : "+D"(buf), "+c"(count)
+            : "d"(ATA_PRIMARY_IO + ATA_REG_DATA)
+            : "eax", "memory", "cc"
+    );
+}
+
+/*
+* ata_interrupts_enabled
+*   DESCRIPTION: check whether interrupts are enabled, so that completion can be signalled by IRQ14
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if interrupts are enabled, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+static int32_t ata_interrupts_enabled(void)
+{
+    uint32_t flags;
+    asm volatile ("pushfl; popl %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) ? 1 : 0;
+}
+
+/*
+* ata_poll
+*   DESCRIPTION: poll the status register until the drive is no longer busy
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: the final status, or -1 on timeout
+*   SIDE EFFECTS: reading the status register acknowledges a pending drive interrupt
+*/
+static int32_t ata_poll(void)
+{
+    int32_t i;
+    uint8_t status;
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+        if (!(status & ATA_SR_BSY)) {
+            return status;
+        }
+    }
+    return -1;
+}
+
+/*
+* ata_wait_sector
+*   DESCRIPTION: wait until the next sector of the current command is ready to be transferred. With
+*                interrupts enabled the caller gives the processor away until IRQ14 comes, otherwise (at
+*                boot, or inside an interrupt gate) the status register is polled. The interrupt only
+*                wakes the caller up, the alternate status decides whether the data is there, so a late
+*                interrupt of an earlier command cannot make the caller read a sector too early
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 0 if the data is ready, -1 on error or timeout
+*   SIDE EFFECTS: none
+*/
+static int32_t ata_wait_sector(void)
+{
+    uint32_t flags;
+    uint32_t deadline;
+    int32_t status = -1;
+
+    if (ata_interrupts_enabled()) {
+        deadline = pit_ticks + ATA_IRQ_TICKS;
+        cli_and_save(flags);
+        while (status == -1 && (int32_t)(deadline - pit_ticks) > 0) {
+            if (ata_irq_pending == 0) {
+                yield();
+                // nothing else could run, wait here for the next interrupt
+                if (ata_irq_pending == 0) {
+                    asm volatile ("sti; hlt; cli");
+                }
+                continue;
+            }
+            ata_irq_pending = 0;
+            // reading the alternate status does not acknowledge an interrupt
+            ata_delay();
+            status = inb(ATA_PRIMARY_CTRL);
+            if (status & ATA_SR_BSY) {
+                status = -1;
+            }
+        }
+        restore_flags(flags);
+    }
+    // the interrupt never came (or interrupts are off), fall back to polling
+    if (status == -1) {
+        ata_delay();
+        status = ata_poll();
+        if (status == -1) {
+            return -1;
+        }
+    }
+    if ((status & (ATA_SR_ERR | ATA_SR_DF)) || !(status & ATA_SR_DRQ)) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* ata_init
+*   DESCRIPTION: identify the filesystem drive and enable its interrupt
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 0 if an ATA drive is present, -1 otherwise
+*   SIDE EFFECTS: enables IRQ14
+*/
+int32_t ata_init(void)
+{
+    uint16_t identify[ATA_SECTOR_SIZE / 2];
+    int32_t status;
+    int32_t i;
+
+    // select the drive and issue IDENTIFY with zeroed sector count and LBA
+    outb(ATA_FS_DRIVE, ATA_PRIMARY_IO + ATA_REG_DRIVE);
+    ata_delay();
+    outb(0, ATA_PRIMARY_IO + ATA_REG_SECCOUNT);
+    outb(0, ATA_PRIMARY_IO + ATA_REG_LBA_LO);
+    outb(0, ATA_PRIMARY_IO + ATA_REG_LBA_MID);
+    outb(0, ATA_PRIMARY_IO + ATA_REG_LBA_HI);
+    outb(ATA_CMD_IDENTIFY, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+
+    // 0 - no drive, 0xFF - floating bus (no controller)
+    status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    if (status == 0 || status == 0xFF) {
+        return -1;
+    }
+    if (ata_poll() == -1) {
+        return -1;
+    }
+    // ATAPI and SATA devices set the LBA mid/high registers, they do not support this command set
+    if (inb(ATA_PRIMARY_IO + ATA_REG_LBA_MID) != 0 || inb(ATA_PRIMARY_IO + ATA_REG_LBA_HI) != 0) {
+        return -1;
+    }
+    for (i = 0; i < ATA_TIMEOUT; i++) {
+        status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+        if (status & (ATA_SR_ERR | ATA_SR_DRQ)) {
+            break;
+        }
+    }
+    if (i == ATA_TIMEOUT || (status & ATA_SR_ERR)) {
+        return -1;
+    }
+    ata_read_words(identify, ATA_SECTOR_SIZE / 2);
+
+    // words 60 and 61 hold the number of LBA28 addressable sectors
+    ata_sectors = identify[60] | ((uint32_t)identify[61] << 16);
+    ata_present = 1;
+
+    // 0 - clear nIEN so the drive raises IRQ14 on completion
+    outb(0, ATA_PRIMARY_CTRL);
+    enable_irq(ATA_IRQ);
+    return 0;
+}
+
+/*
+* ata_handler
+*   DESCRIPTION: ATA interrupt handler, wakes up the caller waiting for a sector
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: acknowledges the interrupt on the drive and the PIC
+*/
+void ata_handler(void)
+{
+    // reading the status register acknowledges the interrupt on the drive
+    inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    ata_irq_pending = 1;
+    send_eoi(ATA_IRQ);
+}
+
+/*
+* ata_read_sectors
+*   DESCRIPTION: read sectors from the filesystem drive with PIO, each sector completes with an interrupt
+*                and the caller lets other processes run while it waits. Callers serialize access to the
+*                drive.
+*   INPUTS: lba - first sector to read
+*           count - number of sectors to read
+*           buf - buffer of at least count * ATA_SECTOR_SIZE bytes
+*   OUTPUTS: none
+*   RETURN VALUE: number of sectors read, or -1 on failure
+*   SIDE EFFECTS: fills buf
+*/
+int32_t ata_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf)
+{
+    uint32_t flags;
+    uint32_t chunk;
+    uint32_t i;
+    uint32_t done = 0;
+
+    if (!ata_present || buf == NULL || lba + count > ata_sectors) {
+        return -1;
+    }
+
+    while (done < count) {
+        // 255 - largest sector count of one LBA28 command (0 would mean 256)
+        chunk = (count - done > 255) ? 255 : count - done;
+        if (ata_poll() == -1) {
+            return -1;
+        }
+
+        cli_and_save(flags);
+        // 0x0F - LBA bits 24-27 go into the drive select register
+        outb(ATA_FS_DRIVE | ((lba >> 24) & 0x0F), ATA_PRIMARY_IO + ATA_REG_DRIVE);
+        ata_delay();
+        outb(chunk, ATA_PRIMARY_IO + ATA_REG_SECCOUNT);
+        outb(lba & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_LO);
+        outb((lba >> 8) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_MID);
+        outb((lba >> 16) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA_HI);
+        ata_irq_pending = 0;
+        outb(ATA_CMD_READ_SECTORS, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+        restore_flags(flags);
+
+        for (i = 0; i < chunk; i++) {
+            if (ata_wait_sector() == -1) {
+                return -1;
+            }
+            ata_read_words((uint16_t*)buf, ATA_SECTOR_SIZE / 2);
+            buf += ATA_SECTOR_SIZE;
+        }
+        lba += chunk;
+        done += chunk;
+    }
+    return done;
+}
+
+/*
+* ata_sector_count
+*   DESCRIPTION: get the size of the filesystem drive
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: number of addressable sectors, 0 if no drive is present
+*   SIDE EFFECTS: none
+*/
+uint32_t ata_sector_count(void)
+{
+    return ata_sectors;
+}
@@ -0,0 +1,50 @@
+/* ata.h - Defines used in interactions with the ATA (IDE) disk controller
+ */
+#ifndef ATA_H
+#define ATA_H
+#include "types.h"
+
+// I/O base and control ports of the primary ATA bus
+#define ATA_PRIMARY_IO      0x1F0
+#define ATA_PRIMARY_CTRL    0x3F6
+// The primary ATA bus is connected to IRQ14 (slave PIC)
+#define ATA_IRQ             14
+
+// register offsets from the I/O base port
+#define ATA_REG_DATA        0
+#define ATA_REG_SECCOUNT    2
+#define ATA_REG_LBA_LO      3
+#define ATA_REG_LBA_MID     4
+#define ATA_REG_LBA_HI      5
+#define ATA_REG_DRIVE       6
+#define ATA_REG_STATUS      7
+#define ATA_REG_COMMAND     7
+
+// bits of the status register
+#define ATA_SR_BSY          0x80    // drive busy
+#define ATA_SR_DF           0x20    // drive write fault
+#define ATA_SR_DRQ          0x08    // data request ready
+#define ATA_SR_ERR          0x01    // error
+
+// commands
+#define ATA_CMD_READ_SECTORS 0x20
+#define ATA_CMD_IDENTIFY     0xEC
+
+// drive select value (LBA mode), the low 4 bits hold LBA bits 24-27
+#define ATA_SLAVE           0xF0
+
+// the boot disk (mp3.img) is the primary master, the filesystem disk is the primary slave
+#define ATA_FS_DRIVE        ATA_SLAVE
+
+#define ATA_SECTOR_SIZE     512
+
+// probe the filesystem drive and enable its interrupt, 0 if a drive is present, -1 otherwise
+extern int32_t ata_init(void);
+// ATA interrupt handler
+extern void ata_handler(void);
+// read count sectors starting at lba from the filesystem drive into buf
+extern int32_t ata_read_sectors(uint32_t lba, uint32_t count, uint8_t* buf);
+// number of addressable sectors reported by IDENTIFY
+extern uint32_t ata_sector_count(void);
+
+#endif
@@ -7,6 +7,8 @@
 
 #include "cursor.h"
 
+static uint16_t screen_start = 0;      // cell of video memory shown at the top left corner of the screen
+
 /*
 * enable_cursor
 *   DESCRIPTION: Enabling the cursor
@@ -70,7 +72,8 @@ void update_cursor(int x, int y) {
     // 0x0E - Select the index of the cursor end register
     // 0xFF - Choose low 8 bits
 
-    uint16_t pos = y * 80 + x;                    // 80 - screen width
+    // the cursor location counts from the start of video memory, not of the screen
+    uint16_t pos = screen_start + y * 80 + x;     // 80 - screen width
  
     outb(0x0F, 0x3D4);
     outb((uint8_t) (pos & 0xFF), 0x3D5);
@@ -79,6 +82,30 @@ void update_cursor(int x, int y) {
 }
 
 
+/*
+* set_screen_start
+*   DESCRIPTION: Show the screen starting at another cell of video memory, the cursor moves with it
+*   INPUTS: start - offset of the first cell shown, in cells
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the caller moves the cursor afterwards
+*/
+void set_screen_start(uint16_t start) {
+    
+    // 0x3D4 - VGA control register (CRTC address register)
+    // 0x0C - Select the index of the start address high register
+    // 0x3D5 - VGA control register (CRTC data register)
+    // 0x0D - Select the index of the start address low register
+    // 0xFF - Choose low 8 bits
+
+    screen_start = start;
+    outb(0x0C, 0x3D4);
+    outb((uint8_t) ((start >> 8) & 0xFF), 0x3D5); // 8 - offset
+    outb(0x0D, 0x3D4);
+    outb((uint8_t) (start & 0xFF), 0x3D5);
+}
+
+
 /*
 * get_cursor_position
 *   DESCRIPTION: Get cursor position
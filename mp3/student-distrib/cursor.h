@@ -20,6 +20,9 @@ void disable_cursor();
 /* Moving the Cursor */
 void update_cursor(int x, int y);
 
+/* Showing the Screen at an Offset in Video Memory */
+void set_screen_start(uint16_t start);
+
 /* Get Cursor Position */
 uint16_t get_cursor_position(void);
 
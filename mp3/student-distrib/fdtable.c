@@ -0,0 +1,145 @@
+#include "fdtable.h"
+#include "lib.h"
+
+// descriptors that fit in one page of the kernel page pool
+#define FD_PER_PAGE (PAGE_SIZE / sizeof(file_descriptor))
+
+/*
+* fd_grow
+*   DESCRIPTION: move the table of a process to pages of the kernel page pool big enough to hold descriptor
+*                fd, doubling the pages each time so a process opening n files copies O(n) entries in total
+*   INPUTS: pcb_ptr -- the process
+*           fd -- the descriptor the table must hold, below FD_MAX
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the pool has no room
+*   SIDE EFFECTS: frees the pages of the old table
+*/
+static int32_t fd_grow(pcb* pcb_ptr, int32_t fd)
+{
+    file_descriptor* table;
+    int32_t pages = (pcb_ptr->fd_pages == 0) ? 1 : pcb_ptr->fd_pages * 2;
+    int32_t capacity;
+    int32_t i;
+
+    while (pages * FD_PER_PAGE <= (uint32_t)fd) {
+        pages *= 2;
+    }
+    if (pages > (int32_t)FD_TABLE_MAX_PAGES) {
+        pages = FD_TABLE_MAX_PAGES;
+    }
+    capacity = pages * FD_PER_PAGE;
+    if (capacity > FD_MAX) {
+        capacity = FD_MAX;
+    }
+    if ((table = kpage_alloc(pages)) == NULL) {
+        return -1;
+    }
+    memcpy(table, pcb_ptr->file_descriptor_array, pcb_ptr->fd_capacity * sizeof(file_descriptor));
+    for (i = pcb_ptr->fd_capacity; i < capacity; i++) {
+        table[i].flags = 0;
+    }
+    if (pcb_ptr->fd_pages != 0) {
+        kpage_free(pcb_ptr->file_descriptor_array, pcb_ptr->fd_pages);
+    }
+    pcb_ptr->file_descriptor_array = table;
+    pcb_ptr->fd_capacity = capacity;
+    pcb_ptr->fd_pages = pages;
+    return 0;
+}
+
+/*
+* fd_table_init
+*   DESCRIPTION: give a new process the inline table with every descriptor free
+*   INPUTS: pcb_ptr -- the process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void fd_table_init(pcb* pcb_ptr)
+{
+    int32_t i;
+
+    pcb_ptr->file_descriptor_array = pcb_ptr->fd_inline;
+    pcb_ptr->fd_capacity = FD_INLINE;
+    pcb_ptr->fd_pages = 0;
+    memset(pcb_ptr->fd_bitmap, 0, sizeof(pcb_ptr->fd_bitmap));
+    for (i = 0; i < FD_INLINE; i++) {
+        pcb_ptr->fd_inline[i].flags = 0;
+    }
+}
+
+/*
+* fd_table_release
+*   DESCRIPTION: free the pages of a grown table, called once every file is closed
+*   INPUTS: pcb_ptr -- the process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the process is left with the empty inline table
+*/
+void fd_table_release(pcb* pcb_ptr)
+{
+    if (pcb_ptr->fd_pages != 0) {
+        kpage_free(pcb_ptr->file_descriptor_array, pcb_ptr->fd_pages);
+    }
+    fd_table_init(pcb_ptr);
+}
+
+/*
+* fd_alloc
+*   DESCRIPTION: take the lowest free descriptor. The bitmap finds it with one bit scan per 32 descriptors
+*                instead of a look at every entry
+*   INPUTS: pcb_ptr -- the process
+*   OUTPUTS: none
+*   RETURN VALUE: the descriptor, -1 if FD_MAX files are open or the table cannot grow
+*   SIDE EFFECTS: the caller fills the entry and sets its flags to 1
+*/
+int32_t fd_alloc(pcb* pcb_ptr)
+{
+    int32_t word;
+    int32_t fd;
+
+    // 32 - descriptors per bitmap word
+    for (word = 0; word < FD_MAX / 32; word++) {
+        if (pcb_ptr->fd_bitmap[word] != 0xFFFFFFFF) {
+            fd = word * 32 + __builtin_ctz(~pcb_ptr->fd_bitmap[word]);
+            return (fd_claim(pcb_ptr, fd) == 0) ? fd : -1;
+        }
+    }
+    return -1;
+}
+
+/*
+* fd_claim
+*   DESCRIPTION: take a given free descriptor, for dup2
+*   INPUTS: pcb_ptr -- the process
+*           fd -- the descriptor, below FD_MAX
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the table cannot grow to hold fd
+*   SIDE EFFECTS: the caller fills the entry and sets its flags to 1
+*/
+int32_t fd_claim(pcb* pcb_ptr, int32_t fd)
+{
+    if (fd < 0 || fd >= FD_MAX) {
+        return -1;
+    }
+    if (fd >= pcb_ptr->fd_capacity && fd_grow(pcb_ptr, fd) == -1) {
+        return -1;
+    }
+    pcb_ptr->fd_bitmap[fd / 32] |= (1U << (fd % 32));
+    return 0;
+}
+
+/*
+* fd_free
+*   DESCRIPTION: give back a descriptor so fd_alloc can hand it out again
+*   INPUTS: pcb_ptr -- the process
+*           fd -- a taken descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: marks the entry closed
+*/
+void fd_free(pcb* pcb_ptr, int32_t fd)
+{
+    pcb_ptr->file_descriptor_array[fd].flags = 0;
+    pcb_ptr->fd_bitmap[fd / 32] &= ~(1U << (fd % 32));
+}
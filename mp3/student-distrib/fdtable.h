@@ -0,0 +1,23 @@
+/* fdtable.h - Defines for the growable file descriptor table of a process
+ */
+#ifndef FDTABLE_H
+#define FDTABLE_H
+#include "types.h"
+#include "system_calls.h"
+#include "page.h"
+
+// pages of the largest table, FD_MAX descriptors
+#define FD_TABLE_MAX_PAGES ((FD_MAX * sizeof(file_descriptor) + PAGE_SIZE - 1) / PAGE_SIZE)
+
+// start a process with the empty inline table
+extern void fd_table_init(pcb* pcb_ptr);
+// return the pages of a grown table and go back to the empty inline table
+extern void fd_table_release(pcb* pcb_ptr);
+// take the lowest free descriptor, -1 if FD_MAX are open or the table cannot grow
+extern int32_t fd_alloc(pcb* pcb_ptr);
+// take descriptor fd, which is free, growing the table to hold it
+extern int32_t fd_claim(pcb* pcb_ptr, int32_t fd);
+// give back a descriptor, the caller has closed the file
+extern void fd_free(pcb* pcb_ptr, int32_t fd);
+
+#endif
@@ -1,11 +1,22 @@
 #include "filesystem.h"
 #include "lib.h"
 #include "system_calls.h"
+#include "ata.h"
+#include "pit.h"
 
 static boot_block_t* boot_block_ptr;
-static inode_t* inode_ptr;
-static data_block_t* data_block_ptr;
-int32_t file_idx = 0;
+
+// 8 - number of 512B disk sectors in one 4KB filesystem block
+#define SECTORS_PER_BLOCK (BLOCK_SIZE / ATA_SECTOR_SIZE)
+
+static uint32_t fs_on_disk = 0;                     // 1 - blocks are read from the ATA disk instead of the boot module
+static uint32_t fs_disk_lba = 0;                    // first sector of the filesystem image on the disk
+static boot_block_t fs_boot_block;                  // resident copy of the boot block when the filesystem is on disk
+static data_block_t fs_cache[FS_CACHE_SIZE];        // recently used inode and data blocks read from the disk
+static uint32_t fs_cache_block[FS_CACHE_SIZE];      // block number held by each cache entry
+static uint32_t fs_cache_used[FS_CACHE_SIZE];       // last access time of each cache entry, 0 - entry empty
+static uint32_t fs_cache_clock = 0;                 // access counter used for LRU replacement
+static volatile int32_t fs_cache_busy = 0;          // 1 - a process is using the cache (or the disk)
 
 /*
 * read_dentry_by_name
@@ -19,8 +30,8 @@ int32_t file_idx = 0;
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
 {
     int i;
-    // check if the fname or the dentry is valid, and the length of the file name is less than 32
-    if (fname == NULL || dentry == NULL || strlen((int8_t*)fname) > 32)
+    // check if there is a file system, the fname or the dentry is valid, and the length of the file name is less than 32
+    if (boot_block_ptr == NULL || fname == NULL || dentry == NULL || strlen((int8_t*)fname) > 32)
     {
         // return -1 for invalid arguments
         return -1;
@@ -52,7 +63,7 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry)
 {
     // check if the index or the dentry is valid
-    if (index >= boot_block_ptr->num_dir_entries || dentry == NULL)
+    if (boot_block_ptr == NULL || index >= boot_block_ptr->num_dir_entries || dentry == NULL)
     {
         // return -1 for invalid arguments
         return -1;
@@ -61,6 +72,112 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry)
     memcpy(dentry, &(boot_block_ptr->dir_entries[index]), sizeof(dentry_t));
     return 0;
 }
+/*
+* fs_cache_lock
+*   DESCRIPTION: Take the block cache, waiting while another process holds it
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the holder may be preempted, so the disk is never shared between two commands
+*/
+static void fs_cache_lock(void)
+{
+    uint32_t flags;
+    while (1)
+    {
+        cli_and_save(flags);
+        if (fs_cache_busy == 0)
+        {
+            fs_cache_busy = 1;
+            restore_flags(flags);
+            return;
+        }
+        restore_flags(flags);
+        // the holder waits for the disk, let it run
+        yield();
+    }
+}
+
+/*
+* fs_cache_unlock
+*   DESCRIPTION: Release the block cache
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void fs_cache_unlock(void)
+{
+    fs_cache_busy = 0;
+}
+
+/*
+* fs_cache_get
+*   DESCRIPTION: Find a block in the cache, reading it from the disk into the least recently used entry on a miss.
+*                The caller holds the cache lock.
+*   INPUTS: block_num - the filesystem block number (0 is the boot block)
+*   OUTPUTS: none
+*   RETURN VALUE: pointer to the cached block, NULL if the disk read fails
+*   SIDE EFFECTS: may evict another block
+*/
+static data_block_t* fs_cache_get(uint32_t block_num)
+{
+    uint32_t i;
+    uint32_t victim = 0;
+    for (i = 0; i < FS_CACHE_SIZE; i++)
+    {
+        if (fs_cache_used[i] != 0 && fs_cache_block[i] == block_num)
+        {
+            fs_cache_used[i] = ++fs_cache_clock;
+            return &fs_cache[i];
+        }
+        // empty entries have time 0 and are picked first
+        if (fs_cache_used[i] < fs_cache_used[victim])
+        {
+            victim = i;
+        }
+    }
+    fs_cache_used[victim] = 0;
+    if (ata_read_sectors(fs_disk_lba + block_num * SECTORS_PER_BLOCK, SECTORS_PER_BLOCK, fs_cache[victim].data) == -1)
+    {
+        return NULL;
+    }
+    fs_cache_block[victim] = block_num;
+    fs_cache_used[victim] = ++fs_cache_clock;
+    return &fs_cache[victim];
+}
+
+/*
+* fs_read_block
+*   DESCRIPTION: Copy part of a filesystem block, from the boot module in memory or through the disk cache
+*   INPUTS: block_num - the filesystem block number (0 is the boot block)
+*           offset - the offset inside the block
+*           buf - the buffer to copy to
+*           length - the number of bytes to copy, offset + length must not exceed BLOCK_SIZE
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the block cannot be read
+*   SIDE EFFECTS: copy the block to the buf
+*/
+static int32_t fs_read_block(uint32_t block_num, uint32_t offset, void* buf, uint32_t length)
+{
+    data_block_t* block;
+    if (fs_on_disk == 0)
+    {
+        // the whole image is in memory, block 0 is the boot block
+        memcpy(buf, &(((data_block_t*)boot_block_ptr)[block_num].data[offset]), length);
+        return 0;
+    }
+    // the copy is done while holding the lock, so the entry cannot be evicted under us
+    fs_cache_lock();
+    block = fs_cache_get(block_num);
+    if (block != NULL)
+    {
+        memcpy(buf, &(block->data[offset]), length);
+    }
+    fs_cache_unlock();
+    return (block == NULL) ? -1 : 0;
+}
+
 /*
 * read_data
 *   DESCRIPTION: Read up to length bytes starting from position offset in the file with inode number inode
@@ -79,6 +196,8 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
     uint32_t start_offset;
     uint32_t end_data_block;
     uint32_t end_offset;
+    uint32_t file_length;
+    uint32_t data_block_num;
     uint32_t i;
     // check if the inode or the buf is valid
     if (inode >= boot_block_ptr->num_inodes || buf == NULL)
@@ -86,15 +205,20 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
         // return -1 for invalid arguments
         return -1;
     }
-    if (offset >= inode_ptr[inode].length)
+    // + 1 - inode blocks follow the boot block, the length is the first field of the inode
+    if (fs_read_block(1 + inode, 0, &file_length, sizeof(uint32_t)) == -1)
+    {
+        return -1;
+    }
+    if (offset >= file_length)
     {
         // return 0 for end of file
         return 0;
     }
-    if (offset + length > inode_ptr[inode].length)
+    if (offset + length > file_length)
     {
         // read the remaining bytes if the length is greater than the remaining bytes
-        length = inode_ptr[inode].length - offset;
+        length = file_length - offset;
     }
     start_data_block = offset / BLOCK_SIZE;
     start_offset = offset % BLOCK_SIZE;
@@ -111,8 +235,16 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
                                 (i == end_data_block) ?
                                 end_offset + 1 :
                                 BLOCK_SIZE;
-        // copy the data block to the buf
-        memcpy(buf + bytes_read, &((data_block_ptr[(inode_ptr[inode].data_block_num)[i]].data)[start_offset]), bytes_to_copy);
+        // look up the data block number in the inode, + 1 - skip the length field
+        if (fs_read_block(1 + inode, (i + 1) * sizeof(uint32_t), &data_block_num, sizeof(uint32_t)) == -1)
+        {
+            return -1;
+        }
+        // copy the data block to the buf, data blocks follow the boot block and the inodes
+        if (fs_read_block(1 + boot_block_ptr->num_inodes + data_block_num, start_offset, buf + bytes_read, bytes_to_copy) == -1)
+        {
+            return -1;
+        }
         bytes_read += bytes_to_copy;
         // reset the start offset to 0 after the first data block
         start_offset = 0;
@@ -126,15 +258,39 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 *   INPUTS: fs_start_addr - the starting address of the file system
 *   OUTPUTS: none
 *   RETURN VALUE: none
-*   SIDE EFFECTS: init the boot_block_ptr, inode_ptr, and data_block_ptr
+*   SIDE EFFECTS: init the boot_block_ptr, the inodes and data blocks follow it in memory
 */
 void file_system_init(uint32_t fs_start_addr)
 {
     boot_block_ptr = (boot_block_t*)fs_start_addr;
-    // + 1 - skip the boot block to get the index node ,move the ptr forward by the size of 1 boot block
-    inode_ptr = (inode_t*)(boot_block_ptr + 1);
-    // + boot_block_ptr->num_inodes - skip the boot block and the index nodes to get the data block
-    data_block_ptr = (data_block_t*)(inode_ptr + boot_block_ptr->num_inodes);
+    fs_on_disk = 0;
+}
+
+/*
+* file_system_init_disk
+*   DESCRIPTION: Initialize the file system from the ATA disk, inodes and data blocks are read on demand
+*   INPUTS: start_lba - the first sector of the filesystem image on the disk
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the boot block cannot be read
+*   SIDE EFFECTS: keeps a copy of the boot block in memory
+*/
+int32_t file_system_init_disk(uint32_t start_lba)
+{
+    int32_t i;
+    if (ata_read_sectors(start_lba, SECTORS_PER_BLOCK, (uint8_t*)&fs_boot_block) == -1)
+    {
+        return -1;
+    }
+    // invalidate the cache
+    for (i = 0; i < FS_CACHE_SIZE; i++)
+    {
+        fs_cache_used[i] = 0;
+    }
+    fs_disk_lba = start_lba;
+    fs_on_disk = 1;
+    // the boot block is always resident, inodes and data blocks only exist on the disk
+    boot_block_ptr = &fs_boot_block;
+    return 0;
 }
 /*
 * file_open
@@ -187,7 +343,7 @@ int32_t file_close(int32_t fd)
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes)
 {
     int32_t bytes_read;
-    if (fd < 0 || fd > 7 || buf == NULL || nbytes < 0)
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || buf == NULL || nbytes < 0)
     {
         // return -1 for invalid arguments
         return -1;
@@ -203,6 +359,58 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes)
     return bytes_read;
 }
 
+/*
+* file_readv
+*   DESCRIPTION: Read consecutive bytes of the file into a vector of buffers
+*   INPUTS: fd - file descriptor
+*           iov - buffers to fill, in order, checked by the caller
+*           iovcnt - number of buffers
+*   OUTPUTS: none
+*   RETURN VALUE: -1 for failure, Otherwise, return the total number of bytes read
+*   SIDE EFFECTS: copy the file to the buffers, the caller advances the file position
+*/
+int32_t file_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t i;
+    int32_t bytes_read;
+    int32_t total = 0;
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || iov == NULL)
+    {
+        // return -1 for invalid arguments
+        return -1;
+    }
+    // get the current pcb
+    pcb* pcb_ptr = get_cur_pcb_ptr();
+    for (i = 0; i < iovcnt; i++)
+    {
+        bytes_read = read_data(pcb_ptr->file_descriptor_array[fd].inode, pcb_ptr->file_descriptor_array[fd].file_position + total, iov[i].base, iov[i].len);
+        if (bytes_read < 0)
+        {
+            return (total > 0) ? total : -1;
+        }
+        total += bytes_read;
+        // stop at the end of the file
+        if (bytes_read < iov[i].len)
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+/*
+* file_poll
+*   DESCRIPTION: Report the poll conditions of a file or directory, reads and writes never wait
+*   INPUTS: fd - file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: POLLIN | POLLOUT
+*   SIDE EFFECTS: none
+*/
+int32_t file_poll(int32_t fd)
+{
+    return POLLIN | POLLOUT;
+}
+
 /*
 * file_write
 *   DESCRIPTION: Write to the file
@@ -257,7 +465,8 @@ int32_t dir_close(int32_t fd)
 }
 /*
 * dir_read
-*   DESCRIPTION: Read from the directory
+*   DESCRIPTION: Read from the directory, one file name per call. The file position of the
+*                descriptor advances by 32 for each name, so every open directory is read independently.
 *   INPUTS: fd - file descriptor
 *           buf - buffer to copy
 *           nbytes - number of bytes to read
@@ -267,33 +476,62 @@ int32_t dir_close(int32_t fd)
 */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes)
 {
-    dentry_t dentry;
+    uint32_t idx;
     uint8_t* buffer = (uint8_t*)buf;
-    if (fd < 0 || fd > 7 || buf == NULL || nbytes < 0)
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || buf == NULL || nbytes < 0)
     {
         // return -1 for invalid arguments
         return -1;
     }
-    // If file index does not exceed the number of directory entries
-    if (file_idx < boot_block_ptr->num_dir_entries) 
+    // 32 - length of a file name, the position counts the names already read
+    idx = get_cur_pcb_ptr()->file_descriptor_array[fd].file_position / DIR_NAME_LEN;
+    // If file index exceeds the number of directory entries, end search in current directory
+    if (idx >= boot_block_ptr->num_dir_entries) 
     {
-        
-        // Get current dentry
-        dentry = boot_block_ptr->dir_entries[file_idx];
+        return 0;
+    }
+    // Copy file name into buffer, the caller advances the position
+    memcpy(buffer, boot_block_ptr->dir_entries[idx].file_name, DIR_NAME_LEN);
+    return DIR_NAME_LEN;
+}
 
-        // Copy file name into buffer
-        memcpy(buffer, &(dentry.file_name), 32);
-        // Increase the file idx for next search
-        file_idx++;
-    } 
-    else 
+/*
+* dir_getdents
+*   DESCRIPTION: Read as many directory entries as fit in the buffer, with their type, inode and size
+*   INPUTS: fd - file descriptor of an open directory
+*           buf - buffer of dirent_t to fill
+*           nbytes - size of the buffer
+*   OUTPUTS: none
+*   RETURN VALUE: -1 for failure, 0 for end of directory, Otherwise, return the number of bytes filled
+*   SIDE EFFECTS: advances the file position of fd past the entries returned
+*/
+int32_t dir_getdents(int32_t fd, dirent_t* buf, int32_t nbytes)
+{
+    uint32_t idx;
+    int32_t count = 0;
+    dentry_t* dentry;
+    pcb* pcb_ptr;
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || buf == NULL || nbytes < (int32_t)sizeof(dirent_t))
     {
-        // If file index exceeds the number of directory entries, end search in current directory
-        file_idx = 0;       // 0 - Reset file index for next directory's search
-        return 0;           
+        // return -1 for invalid arguments
+        return -1;
+    }
+    pcb_ptr = get_cur_pcb_ptr();
+    // the position is shared with dir_read, 32 for each name
+    idx = pcb_ptr->file_descriptor_array[fd].file_position / DIR_NAME_LEN;
+    while (idx < boot_block_ptr->num_dir_entries && (count + 1) * (int32_t)sizeof(dirent_t) <= nbytes)
+    {
+        dentry = &boot_block_ptr->dir_entries[idx];
+        memcpy(buf[count].name, dentry->file_name, DIR_NAME_LEN);
+        buf[count].file_type = dentry->file_type;
+        buf[count].inode = dentry->inode_num;
+        // 2 - regular file, only regular files have data blocks
+        buf[count].length = (dentry->file_type == 2) ? get_length(dentry->inode_num) : 0;
+        count++;
+        idx++;
     }
-    // 32 - maximum length of a file name
-    return 32;
+    pcb_ptr->file_descriptor_array[fd].file_position = idx * DIR_NAME_LEN;
+    return count * sizeof(dirent_t);
 }
 
 /*
@@ -323,9 +561,15 @@ int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes)
 int32_t get_length(uint32_t inode)
 {
     // check if the inode is valid
+    uint32_t length;
     if (inode >= boot_block_ptr->num_inodes)
     {
         return -1;
     }
-    return inode_ptr[inode].length;
+    // + 1 - inode blocks follow the boot block, the length is the first field of the inode
+    if (fs_read_block(1 + inode, 0, &length, sizeof(uint32_t)) == -1)
+    {
+        return -1;
+    }
+    return length;
 }
@@ -5,6 +5,8 @@
 #include "types.h"
 
 #define BLOCK_SIZE 4096 // the file system memory is divided into 4KB blocks
+#define FS_CACHE_SIZE 16 // number of blocks cached in memory when the file system is read from the disk
+#define DIR_NAME_LEN 32 // length of a file name in a directory entry
 // the struct for directory entry
 typedef struct dentry_t 
 {
@@ -31,6 +33,15 @@ typedef struct inode_t
     uint32_t data_block_num[1023]; // data block numbers, 4096 / 4 = 1024, 1024 - 1 = 1023
 } inode_t;
 
+// one directory entry returned by getdents, same layout as the user's struct
+typedef struct dirent_t
+{
+    uint8_t name[DIR_NAME_LEN]; // file name, zero-padded, not necessarily null-terminated
+    uint32_t file_type; // file type (0 rtc, 1 directory, 2 regular file)
+    uint32_t inode; // index node number
+    uint32_t length; // length of the file in bytes, 0 if not a regular file
+} dirent_t;
+
 // the struct for the data block
 typedef struct data_block_t 
 {
@@ -52,14 +63,22 @@ int32_t file_open(const uint8_t* filename);
 int32_t file_close(int32_t fd);
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
+// read the file into a vector of buffers
+int32_t file_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+// files and directories are always ready
+int32_t file_poll(int32_t fd);
 // four functions used for directories
 int32_t dir_open(const uint8_t* filename);
 int32_t dir_close(int32_t fd);
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes);
+// read a batch of directory entries with their type, inode and size
+int32_t dir_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
 
 // init the file system
 void file_system_init(uint32_t fs_start_addr);
+// init the file system from the ATA disk, blocks are read on demand
+int32_t file_system_init_disk(uint32_t start_lba);
 
 // get the file size by inode number
 int32_t get_length(uint32_t inode_num);
@@ -24,94 +24,118 @@
 #define Alignment_Check 17
 #define Machine_Check 18
 #define SIMD_Floating_Point_Exception 19
-// helper function to handle exceptions
-void handle_exception(uint8_t vector, const char *msg)
+/*
+* handle_exception
+*   DESCRIPTION: helper function to handle exceptions. An exception in user mode raises DIV_ZERO for a
+*                divide error and SEGFAULT for the others, delivered when the linkage returns; a handler
+*                that returns runs the faulting instruction again. The process is halted when the
+*                exception happened in the kernel or the action is to kill it
+*   INPUTS: vector - the exception vector
+*           msg - name of the exception
+*           context - hw_context saved by the linkage
+*   OUTPUTS: prints the exception when the process is halted
+*   RETURN VALUE: none
+*   SIDE EFFECTS: does not return when the process is halted
+*/
+void handle_exception(uint8_t vector, const char *msg, hw_context* context)
 {
-    printf("Exception %d: %s\n", vector, msg);\
+    int32_t signum = (vector == Divided_Error) ? SIG_DIV_ZERO : SIG_SEGFAULT;
+    pcb* cur_pcb;
+
+    // 3 - privilege level of user code
+    if ((context->cs & 3) == 3) {
+        cur_pcb = get_cur_pcb_ptr();
+        // a masked signal would fault again right away
+        if (cur_pcb->signals[signum].handler != (void*)KILL && cur_pcb->signals[signum].mask == 0) {
+            signal_raise(get_pid(), signum);
+            return;
+        }
+    }
+    printf("Exception %d: %s\n", vector, msg);
     // halt the system
     // while(1);
     halt(1);
 }
 // exception handlers for each exception
-void exception_divided_error()
+void exception_divided_error(hw_context* context)
 {
-    handle_exception(Divided_Error, "Divided Error");
+    handle_exception(Divided_Error, "Divided Error", context);
 }
-void exception_debug()
+void exception_debug(hw_context* context)
 {
-    handle_exception(Debug_Exception, "Debug Exception");
+    handle_exception(Debug_Exception, "Debug Exception", context);
 }
-void exception_nmi_interrupt()
+void exception_nmi_interrupt(hw_context* context)
 {
-    handle_exception(NMI_Interrupt, "NMI Interrupt");
+    handle_exception(NMI_Interrupt, "NMI Interrupt", context);
 }
-void exception_breakpoint()
+void exception_breakpoint(hw_context* context)
 {
-    handle_exception(Breakpoint, "Breakpoint");
+    handle_exception(Breakpoint, "Breakpoint", context);
 }
-void exception_overflow()
+void exception_overflow(hw_context* context)
 {
-    handle_exception(Overflow, "Overflow");
+    handle_exception(Overflow, "Overflow", context);
 }
-void exception_bound_range_exceeded()
+void exception_bound_range_exceeded(hw_context* context)
 {
-    handle_exception(Bound_Range_Exceeded, "Bound Range Exceeded");
+    handle_exception(Bound_Range_Exceeded, "Bound Range Exceeded", context);
 }
-void exception_invalid_opcode()
+void exception_invalid_opcode(hw_context* context)
 {
-    handle_exception(Invalid_Opcode, "Invalid Opcode");
+    handle_exception(Invalid_Opcode, "Invalid Opcode", context);
 }
-void exception_device_not_available()
+void exception_device_not_available(hw_context* context)
 {
-    handle_exception(Device_Not_Available, "Device Not Available");
+    handle_exception(Device_Not_Available, "Device Not Available", context);
 }
-void exception_double_fault()
+void exception_double_fault(hw_context* context)
 {
-    handle_exception(Double_Fault, "Double Fault");
+    handle_exception(Double_Fault, "Double Fault", context);
 }
-void exception_coprocessor_segment_overrun()
+void exception_coprocessor_segment_overrun(hw_context* context)
 {
-    handle_exception(Coprocessor_Segment_Overrun, "Coprocessor Segment Overrun");
+    handle_exception(Coprocessor_Segment_Overrun, "Coprocessor Segment Overrun", context);
 }
-void exception_invalid_tss()
+void exception_invalid_tss(hw_context* context)
 {
-    handle_exception(Invalid_TSS, "Invalid TSS");
+    handle_exception(Invalid_TSS, "Invalid TSS", context);
 }
-void exception_segment_not_present()
+void exception_segment_not_present(hw_context* context)
 {
-    handle_exception(Segment_Not_Present, "Segment Not Present");
+    handle_exception(Segment_Not_Present, "Segment Not Present", context);
 }
-void exception_stack_segment_fault()
+void exception_stack_segment_fault(hw_context* context)
 {
-    handle_exception(Stack_Segment_Fault, "Stack Segment Fault");
+    handle_exception(Stack_Segment_Fault, "Stack Segment Fault", context);
 }
-void exception_general_protection()
+void exception_general_protection(hw_context* context)
 {
-    handle_exception(General_Protection, "General Protection");
+    handle_exception(General_Protection, "General Protection", context);
 }
-void exception_page_fault()
+void exception_page_fault(hw_context* context)
 {
-    handle_exception(Page_Fault, "Page Fault");
+    handle_exception(Page_Fault, "Page Fault", context);
 }
-void exception_reserved()
+void exception_reserved(hw_context* context)
 {
-    handle_exception(Reserved, "Reserved");
+    handle_exception(Reserved, "Reserved", context);
 }
-void exception_x87_floating_point_exception()
+void exception_x87_floating_point_exception(hw_context* context)
 {
-    handle_exception(x87_Floating_Point_Exception, "x87 Floating Point Exception");
+    handle_exception(x87_Floating_Point_Exception, "x87 Floating Point Exception", context);
 }
-void exception_alignment_check()
+void exception_alignment_check(hw_context* context)
 {
-    handle_exception(Alignment_Check, "Alignment Check");
+    handle_exception(Alignment_Check, "Alignment Check", context);
 }
-void exception_machine_check()
+void exception_machine_check(hw_context* context)
 {
-    handle_exception(Machine_Check, "Machine Check");
+    handle_exception(Machine_Check, "Machine Check", context);
 }
-void exception_simd_floating_point_exception()
+void exception_simd_floating_point_exception(hw_context* context)
 {
-    handle_exception(SIMD_Floating_Point_Exception, "SIMD Floating Point Exception");
+    handle_exception(SIMD_Floating_Point_Exception, "SIMD Floating Point Exception", context);
 }
 
 // system call handler
@@ -189,8 +213,12 @@ void idt_init()
     SET_IDT_ENTRY(idt[0x20], pit_handler_linkage);
     // keyboard is connected to IRQ1 (0x21)
     SET_IDT_ENTRY(idt[0x21], keyboard_handler_linkage);
+    // COM1 is connected to IRQ4 (0x24)
+    SET_IDT_ENTRY(idt[0x24], serial_handler_linkage);
     // RTC is connected to IRQ8 (0x28)
     SET_IDT_ENTRY(idt[0x28], rtc_handler_linkage);
+    // primary ATA bus is connected to IRQ14 (0x2E)
+    SET_IDT_ENTRY(idt[0x2E], ata_handler_linkage);
     // system call is connected to 0x80
     SET_IDT_ENTRY(idt[0x80], system_call_handler_linkage);
     lidt(idt_desc_ptr);
@@ -2,28 +2,29 @@
 */
 #ifndef IDT_H
 #define IDT_H
+#include "system_calls.h"
 
 extern void idt_init();
 
-extern void exception_divided_error();
-extern void exception_debug();
-extern void exception_nmi_interrupt();
-extern void exception_breakpoint();
-extern void exception_overflow();
-extern void exception_bound_range_exceeded();
-extern void exception_invalid_opcode();
-extern void exception_device_not_available();
-extern void exception_double_fault();
-extern void exception_coprocessor_segment_overrun();
-extern void exception_invalid_tss();
-extern void exception_segment_not_present();
-extern void exception_stack_segment_fault();
-extern void exception_general_protection();
-extern void exception_page_fault();
-extern void exception_x87_floating_point_exception();
-extern void exception_alignment_check();
-extern void exception_machine_check();
-extern void exception_simd_floating_point_exception();
+extern void exception_divided_error(hw_context* context);
+extern void exception_debug(hw_context* context);
+extern void exception_nmi_interrupt(hw_context* context);
+extern void exception_breakpoint(hw_context* context);
+extern void exception_overflow(hw_context* context);
+extern void exception_bound_range_exceeded(hw_context* context);
+extern void exception_invalid_opcode(hw_context* context);
+extern void exception_device_not_available(hw_context* context);
+extern void exception_double_fault(hw_context* context);
+extern void exception_coprocessor_segment_overrun(hw_context* context);
+extern void exception_invalid_tss(hw_context* context);
+extern void exception_segment_not_present(hw_context* context);
+extern void exception_stack_segment_fault(hw_context* context);
+extern void exception_general_protection(hw_context* context);
+extern void exception_page_fault(hw_context* context);
+extern void exception_x87_floating_point_exception(hw_context* context);
+extern void exception_alignment_check(hw_context* context);
+extern void exception_machine_check(hw_context* context);
+extern void exception_simd_floating_point_exception(hw_context* context);
 extern void system_call_handler();
 
 #endif
@@ -16,6 +16,8 @@
 #include "filesystem.h"
 #include "system_calls.h"
 #include "pit.h"
+#include "ata.h"
+#include "serial.h"
 #define RUN_TESTS
 
 /* Macros. */
@@ -27,8 +29,21 @@
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    int fs_loaded = 0;
 
-    /* Clear the screen. */
+    /* Set up the terminals, as many as the boot command line asks for, and clear the screen. */
+    mbi = (multiboot_info_t *) addr;
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && CHECK_FLAG(mbi->flags, 2)) {
+        terminal_set_count((int8_t *)mbi->cmdline);
+    }
+    if (terminal_init() == -1) {
+        // the terminals are the console, try again with one before giving up
+        num_terminals = 1;
+        if (terminal_init() == -1) {
+            // nothing to print the error on
+            asm volatile ("cli; 1: hlt; jmp 1b");
+        }
+    }
     clear();
 
     /* Am I booted by a Multiboot-compliant boot loader? */
@@ -37,9 +52,6 @@ void entry(unsigned long magic, unsigned long addr) {
         return;
     }
 
-    /* Set MBI to the address of the Multiboot information structure. */
-    mbi = (multiboot_info_t *) addr;
-
     /* Print out the flags. */
     printf("flags = 0x%#x\n", (unsigned)mbi->flags);
 
@@ -61,7 +73,10 @@ void entry(unsigned long magic, unsigned long addr) {
         module_t* mod = (module_t*)mbi->mods_addr;
         // since only module 0 is loaded, this module must be the file system
         // initialize the file system
-        file_system_init(mod->mod_start);
+        if (mbi->mods_count > 0) {
+            file_system_init(mod->mod_start);
+            fs_loaded = 1;
+        }
         while (mod_count < mbi->mods_count) {
             printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
             printf("Module %d ends at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_end);
@@ -156,8 +171,23 @@ void entry(unsigned long magic, unsigned long addr) {
     keyboard_init();
     rtc_init();
     page_init();
-    terminal_init();
     pit_init();
+    /* Put a terminal on the serial console for "serial=N" */
+    if (serial_init() == 0 && CHECK_FLAG(mbi->flags, 2)) {
+        terminal_set_serial((int8_t *)mbi->cmdline);
+    }
+    /* Set up the fast system call entry, int 0x80 stays available */
+    if (sysenter_init() == -1) {
+        printf("SYSENTER not supported, programs built with SYSENTER=1 will not run\n");
+    }
+    /* Without a filesystem module from GRUB, serve the filesystem from the ATA disk */
+    if (fs_loaded == 0) {
+        if (ata_init() == 0 && file_system_init_disk(0) == 0) {
+            printf("File system read from ATA disk (%u sectors)\n", ata_sector_count());
+        } else {
+            printf("No file system found\n");
+        }
+    }
     /* Enable interrupts */
 
     /* Do not enable the following until after you have set up your
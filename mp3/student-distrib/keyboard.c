@@ -4,55 +4,138 @@
 #include "terminal.h"
 #include "system_calls.h"
 #include "cursor.h"
-
-
-
-uint8_t ctrl_pressed = 0;           // ctrl key pressed down
-uint8_t shift_pressed = 0;          // shift key pressed down
-uint8_t capital = 0;                // capital status on
-uint8_t caps_lock_pressed = 0;      // cap lock key pressed down
-uint8_t alt_pressed = 0;            // alt key pressed down
-
-// matching scan code for each key, 58 scan codes in total
-// using PS/2 scan code set 1 (for a "US QWERTY" keyboard only) from 0x00 to 0x39
-// currently only support lower case letters and numbers
-char scan_code_match[58] = 
+#include "aio.h"
+#include "ldisc.h"
+
+// times the status port is read while waiting for the controller to take a byte
+#define KEYBOARD_WAIT 10000
+// F1 - F12 - 12 function keys
+#define FUNCTION_KEYS 12
+
+uint8_t key_modifiers = 0;          // MOD_* of the modifier keys held down
+uint8_t key_locks = 0;              // LOCK_* of the lock keys that are on
+static uint8_t locks_held = 0;      // LOCK_* of the lock keys held down, a held key repeats its press
+static uint8_t extended = 0;        // the last scan code was EXTENDED_PREFIX
+static int32_t pause_left = 0;      // scan codes of the pause key still to skip
+
+// scan codes taken by the interrupt handler and not yet decoded. The handler only moves scan_tail and
+// keyboard_drain only scan_head, so neither needs the other to disable interrupts. The indices run
+// freely and are taken modulo the ring size
+static uint8_t scan_ring[SCAN_RING_SIZE];
+static volatile uint32_t scan_head = 0;
+static volatile uint32_t scan_tail = 0;
+static uint32_t scan_dropped = 0;   // scan codes lost because the ring was full
+
+// keys of PS/2 scan code set 1 (for a "US QWERTY" keyboard), by the scan code of the press.
+// Scan codes without an entry are KMAP_NONE
+static const key_map_t key_map[KMAP_SIZE] =
 {
-	'\0', '\0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=',
-	'\b', '\t', 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p',
-	'[', ']', '\n', '\0',
-	'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l' ,
-	';', '\'', '`', '\0', '\\',
-	'z', 'x', 'c', 'v', 'b', 'n', 'm',
-	',', '.', '/', '\0', '\0', '\0', ' ',
+    [0x01] = {KMAP_CHAR, 0x1B, 0x1B},       // escape, 0x1B - ASCII ESC
+    [0x02] = {KMAP_CHAR, '1', '!'},
+    [0x03] = {KMAP_CHAR, '2', '@'},
+    [0x04] = {KMAP_CHAR, '3', '#'},
+    [0x05] = {KMAP_CHAR, '4', '$'},
+    [0x06] = {KMAP_CHAR, '5', '%'},
+    [0x07] = {KMAP_CHAR, '6', '^'},
+    [0x08] = {KMAP_CHAR, '7', '&'},
+    [0x09] = {KMAP_CHAR, '8', '*'},
+    [0x0A] = {KMAP_CHAR, '9', '('},
+    [0x0B] = {KMAP_CHAR, '0', ')'},
+    [0x0C] = {KMAP_CHAR, '-', '_'},
+    [0x0D] = {KMAP_CHAR, '=', '+'},
+    [0x0E] = {KMAP_CHAR, 8, 8},             // backspace, 8 - ASCII BS
+    [0x0F] = {KMAP_CHAR, '\t', '\t'},
+    [0x10] = {KMAP_LETTER, 'q', 'Q'},
+    [0x11] = {KMAP_LETTER, 'w', 'W'},
+    [0x12] = {KMAP_LETTER, 'e', 'E'},
+    [0x13] = {KMAP_LETTER, 'r', 'R'},
+    [0x14] = {KMAP_LETTER, 't', 'T'},
+    [0x15] = {KMAP_LETTER, 'y', 'Y'},
+    [0x16] = {KMAP_LETTER, 'u', 'U'},
+    [0x17] = {KMAP_LETTER, 'i', 'I'},
+    [0x18] = {KMAP_LETTER, 'o', 'O'},
+    [0x19] = {KMAP_LETTER, 'p', 'P'},
+    [0x1A] = {KMAP_CHAR, '[', '{'},
+    [0x1B] = {KMAP_CHAR, ']', '}'},
+    [0x1C] = {KMAP_CHAR, '\n', '\n'},
+    [0x1D] = {KMAP_MODIFIER, MOD_LCTRL, 0},
+    [0x1E] = {KMAP_LETTER, 'a', 'A'},
+    [0x1F] = {KMAP_LETTER, 's', 'S'},
+    [0x20] = {KMAP_LETTER, 'd', 'D'},
+    [0x21] = {KMAP_LETTER, 'f', 'F'},
+    [0x22] = {KMAP_LETTER, 'g', 'G'},
+    [0x23] = {KMAP_LETTER, 'h', 'H'},
+    [0x24] = {KMAP_LETTER, 'j', 'J'},
+    [0x25] = {KMAP_LETTER, 'k', 'K'},
+    [0x26] = {KMAP_LETTER, 'l', 'L'},
+    [0x27] = {KMAP_CHAR, ';', ':'},
+    [0x28] = {KMAP_CHAR, '\'', '\"'},
+    [0x29] = {KMAP_CHAR, '`', '~'},
+    [0x2A] = {KMAP_MODIFIER, MOD_LSHIFT, 0},
+    [0x2B] = {KMAP_CHAR, '\\', '|'},
+    [0x2C] = {KMAP_LETTER, 'z', 'Z'},
+    [0x2D] = {KMAP_LETTER, 'x', 'X'},
+    [0x2E] = {KMAP_LETTER, 'c', 'C'},
+    [0x2F] = {KMAP_LETTER, 'v', 'V'},
+    [0x30] = {KMAP_LETTER, 'b', 'B'},
+    [0x31] = {KMAP_LETTER, 'n', 'N'},
+    [0x32] = {KMAP_LETTER, 'm', 'M'},
+    [0x33] = {KMAP_CHAR, ',', '<'},
+    [0x34] = {KMAP_CHAR, '.', '>'},
+    [0x35] = {KMAP_CHAR, '/', '?'},
+    [0x36] = {KMAP_MODIFIER, MOD_RSHIFT, 0},
+    [0x37] = {KMAP_CHAR, '*', '*'},         // keypad
+    [0x38] = {KMAP_MODIFIER, MOD_LALT, 0},
+    [0x39] = {KMAP_CHAR, ' ', ' '},
+    [0x3A] = {KMAP_LOCK, LOCK_CAPS, 0},
+    [0x3B] = {KMAP_CHAR, KEY_F1, KEY_F1},
+    [0x3C] = {KMAP_CHAR, KEY_F1 + 1, KEY_F1 + 1},
+    [0x3D] = {KMAP_CHAR, KEY_F1 + 2, KEY_F1 + 2},
+    [0x3E] = {KMAP_CHAR, KEY_F1 + 3, KEY_F1 + 3},
+    [0x3F] = {KMAP_CHAR, KEY_F1 + 4, KEY_F1 + 4},
+    [0x40] = {KMAP_CHAR, KEY_F1 + 5, KEY_F1 + 5},
+    [0x41] = {KMAP_CHAR, KEY_F1 + 6, KEY_F1 + 6},
+    [0x42] = {KMAP_CHAR, KEY_F1 + 7, KEY_F1 + 7},
+    [0x43] = {KMAP_CHAR, KEY_F1 + 8, KEY_F1 + 8},
+    [0x44] = {KMAP_CHAR, KEY_F1 + 9, KEY_F1 + 9},
+    [0x45] = {KMAP_LOCK, LOCK_NUM, 0},
+    [0x46] = {KMAP_LOCK, LOCK_SCROLL, 0},
+    // keypad, the digits with num lock
+    [0x47] = {KMAP_PAD, KEY_HOME, '7'},
+    [0x48] = {KMAP_PAD, KEY_UP, '8'},
+    [0x49] = {KMAP_PAD, KEY_PAGE_UP, '9'},
+    [0x4A] = {KMAP_CHAR, '-', '-'},
+    [0x4B] = {KMAP_PAD, KEY_LEFT, '4'},
+    [0x4C] = {KMAP_PAD, 0, '5'},
+    [0x4D] = {KMAP_PAD, KEY_RIGHT, '6'},
+    [0x4E] = {KMAP_CHAR, '+', '+'},
+    [0x4F] = {KMAP_PAD, KEY_END, '1'},
+    [0x50] = {KMAP_PAD, KEY_DOWN, '2'},
+    [0x51] = {KMAP_PAD, KEY_PAGE_DOWN, '3'},
+    [0x52] = {KMAP_PAD, KEY_INSERT, '0'},
+    [0x53] = {KMAP_PAD, KEY_DELETE, '.'},
+    [0x57] = {KMAP_CHAR, KEY_F1 + 10, KEY_F1 + 10},
+    [0x58] = {KMAP_CHAR, KEY_F1 + 11, KEY_F1 + 11},
 };
 
-// matching scan code for each key, 58 scan codes in total
-// currently support both upper and lower case letters, numbers and special characters
-// when shift key pressed
-char scan_code_shift[58] = 
+// keys after EXTENDED_PREFIX, the gray keys and the right ctrl and alt. The shifts sent around a gray
+// key pressed with shift or num lock have no entry, so they leave the state of the real shifts alone
+static const key_map_t extended_map[KMAP_SIZE] =
 {
-	'\0', '\0', '!', '@', '#', '$', '%', '^', '&', '*', '(', ')', '_', '+',
-	'\b', '\t', 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P',
-	'{', '}', '\n', '\0',
-	'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L' ,
-	':', '\"', '`', '\0', '\\',
-	'Z', 'X', 'C', 'V', 'B', 'N', 'M',
-	'<', '>', '?', '\0', '\0', '\0', ' ',
-};
-
-// matching scan code for each key, 58 scan codes in total
-// currently support both upper and lower case letters, numbers and special characters
-// when caps lock key on
-char scan_code_capital[58] = 
-{
-	'\0', '\0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=',
-	'\b', '\t', 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P',
-	'{', '}', '\n', '\0',
-	'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L' ,
-	':', '\"', '`', '\0', '\\',
-	'Z', 'X', 'C', 'V', 'B', 'N', 'M',
-	'<', '>', '?', '\0', '\0', '\0', ' ',
+    [0x1C] = {KMAP_CHAR, '\n', '\n'},       // keypad enter
+    [0x1D] = {KMAP_MODIFIER, MOD_RCTRL, 0},
+    [0x35] = {KMAP_CHAR, '/', '/'},         // keypad
+    [0x38] = {KMAP_MODIFIER, MOD_RALT, 0},
+    [0x47] = {KMAP_CHAR, KEY_HOME, KEY_HOME},
+    [0x48] = {KMAP_CHAR, KEY_UP, KEY_UP},
+    [0x49] = {KMAP_CHAR, KEY_PAGE_UP, KEY_PAGE_UP},
+    [0x4B] = {KMAP_CHAR, KEY_LEFT, KEY_LEFT},
+    [0x4D] = {KMAP_CHAR, KEY_RIGHT, KEY_RIGHT},
+    [0x4F] = {KMAP_CHAR, KEY_END, KEY_END},
+    [0x50] = {KMAP_CHAR, KEY_DOWN, KEY_DOWN},
+    [0x51] = {KMAP_CHAR, KEY_PAGE_DOWN, KEY_PAGE_DOWN},
+    [0x52] = {KMAP_CHAR, KEY_INSERT, KEY_INSERT},
+    [0x53] = {KMAP_CHAR, KEY_DELETE, KEY_DELETE},
 };
 
 /*
@@ -70,286 +153,214 @@ void keyboard_init()
 }
 
 /*
-* keyboard_handler
-*   DESCRIPTION: handler for keyboard interrupt
-*   INPUTS: none
+* keyboard_write
+*   DESCRIPTION: send a byte to the keyboard once the controller has taken the last one. The wait is
+*                bounded, a controller that never takes it must not hang the PIT tick
+*   INPUTS: data - the byte
 *   OUTPUTS: none
 *   RETURN VALUE: none
-*   SIDE EFFECTS: print the corresponding character for the pressed key
+*   SIDE EFFECTS: the keyboard answers with a scan code 0xFA, which has no key
 */
-void keyboard_handler()
+static void keyboard_write(uint8_t data)
 {
-    // cli();
-    send_eoi(1);        // keyboard interrupt is IRQ1
-    uint8_t scan_code;
-    scan_code = inb(KEYBOARD_DATA_PORT);
-
-    if (scan_code == L_SHIFT_PRESS || scan_code == R_SHIFT_PRESS) {
+    int32_t i;
 
-        // 1 - shift key is pressed down
-        shift_pressed = 1;
-        return;
-    }
-
-    if (scan_code == L_SHIFT_RELEASE || scan_code == R_SHIFT_RELEASE) {
+    for (i = 0; i < KEYBOARD_WAIT && (inb(KEYBOARD_STATUS_PORT) & KEYBOARD_STATUS_FULL); i++);
+    outb(data, KEYBOARD_DATA_PORT);
+}
 
-        // 0 - shift key is released
-        shift_pressed = 0;
-        return;
+/*
+* keyboard_translate
+*   DESCRIPTION: look a scan code up in the key maps. Prefixes, releases and the modifier and lock keys
+*                only change the state of the keyboard, other presses become the key they type with
+*                the modifiers and locks applied
+*   INPUTS: scan_code - the scan code
+*   OUTPUTS: none
+*   RETURN VALUE: an ASCII character or a KEY_*, 0 if the scan code types nothing
+*   SIDE EFFECTS: sets the lock lights when a lock key is pressed
+*/
+static uint8_t keyboard_translate(uint8_t scan_code)
+{
+    const key_map_t* entry;
+    uint8_t code = scan_code & ~SCAN_RELEASE;
+    uint8_t released = scan_code & SCAN_RELEASE;
+    uint8_t shifted;
+
+    // E1 1D 45 E1 9D C5 - the pause key, the only key with this prefix
+    if (pause_left > 0) {
+        pause_left--;
+        return 0;
     }
-
-    if (scan_code == CTRL_PRESS) {
-
-        // 1 - ctrl key is pressed down
-        ctrl_pressed = 1;
-        return;
+    if (scan_code == PAUSE_PREFIX) {
+        // 2 - the scan codes after each prefix
+        pause_left = 2;
+        return 0;
     }
-
-    if (scan_code == CTRL_RELEASE) {
-
-        // 0 - ctrl key is released
-        ctrl_pressed = 0;
-        return;
+    if (scan_code == EXTENDED_PREFIX) {
+        extended = 1;
+        return 0;
     }
-
-    if (scan_code == CAPS_LOCK_PRESS) {
-        if (caps_lock_pressed == 0) {
-
-            // 1 - caps lock key is pressed down
-            // switch the status of caps lock by 1 - capital
-            capital = 1 - capital;
-            caps_lock_pressed = 1;
-        }
-        return;
+    entry = (extended == 1) ? extended_map : key_map;
+    extended = 0;
+    // answers of the keyboard to commands are past the end of the maps
+    if (code >= KMAP_SIZE) {
+        return 0;
     }
+    entry += code;
 
-    if (scan_code == CAPS_LOCK_RELEASE) {
-
-        // 0 - caps lock key is released
-        caps_lock_pressed = 0;
-        return;
-    }
-    
-    if (scan_code == ALT_PRESS) {
-        alt_pressed = 1;
-        return;
-    }
-    
-    if (scan_code == ALT_RELEASE) {
-        alt_pressed = 0;
-        return;
-    }
-    
-    if (scan_code == F1 && alt_pressed == 1) {
-        if (cur_terminal == 0) {
-            return;
+    switch (entry->type) {
+    case KMAP_MODIFIER:
+        if (released) {
+            key_modifiers &= ~entry->key;
         } else {
-
-            // 0 - press F1 then switch to terminal 0
-            memory_switch(cur_terminal);
-
-            // 2 - offset from VIDEO to VIDEO backup buffer
-            // 4096 - size of VIDEO as well as its buffers
-            memcpy((void*)(VIDEO + (cur_terminal + 2) * 4096), (void*)VIDEO, 4096);
-            memcpy((void*)VIDEO, (void*)(VIDEO + 2 * 4096), 4096);
-
-            // 0 - press F1 then switch to terminal 0
-            update_cursor(terminal[0].cursor_x, terminal[0].cursor_y); 
-            cur_terminal = 0; 
-            memory_switch(run_terminal);
-
-            return;
+            key_modifiers |= entry->key;
         }
-    }
-    
-    if (scan_code == F2 && alt_pressed == 1) {
-        if (cur_terminal == 1) {
-            return;
-        } else {
-
-            // 1 - press F2 then switch to terminal 1
-            memory_switch(cur_terminal);
-
-            // 2 - offset from VIDEO to VIDEO backup buffer
-            // 4096 - size of VIDEO as well as its buffers
-            memcpy((void*)(VIDEO + (cur_terminal + 2) * 4096), (void*)VIDEO, 4096);
-            memcpy((void*)VIDEO, (void*)(VIDEO + 3 * 4096), 4096);
-
-            // 1 - press F2 then switch to terminal 1
-            update_cursor(terminal[1].cursor_x, terminal[1].cursor_y);
-            cur_terminal = 1;  
-            memory_switch(run_terminal);
-
-            return;
+        return 0;
+    case KMAP_LOCK:
+        if (released) {
+            locks_held &= ~entry->key;
+        } else if (!(locks_held & entry->key)) {
+            locks_held |= entry->key;
+            key_locks ^= entry->key;
+            keyboard_write(KEYBOARD_SET_LEDS);
+            keyboard_write(key_locks);
         }
+        return 0;
+    case KMAP_CHAR:
+        shifted = (key_modifiers & MOD_SHIFT) != 0;
+        break;
+    case KMAP_LETTER:
+        shifted = ((key_modifiers & MOD_SHIFT) != 0) != ((key_locks & LOCK_CAPS) != 0);
+        break;
+    case KMAP_PAD:
+        shifted = (key_locks & LOCK_NUM) && !(key_modifiers & MOD_SHIFT);
+        break;
+    default:
+        return 0;
     }
-    
-    if (scan_code == F3 && alt_pressed == 1) {
-        if (cur_terminal == 2) {
-            return;
-        } else {
-
-            // 2 - press F3 then switch to terminal 2
-            memory_switch(cur_terminal);
-
-            // 2 - offset from VIDEO to VIDEO backup buffer
-            // 4096 - size of VIDEO as well as its buffers
-            memcpy((void*)(VIDEO + (cur_terminal + 2) * 4096), (void*)VIDEO, 4096);
-            memcpy((void*)VIDEO, (void*)(VIDEO + 4 * 4096), 4096);
-
-            // 2 - press F3 then switch to terminal 2
-            update_cursor(terminal[2].cursor_x, terminal[2].cursor_y);  
-            cur_terminal = 2;
-            memory_switch(run_terminal);
-
-            return;
-        }
+    if (released) {
+        return 0;
     }
+    return shifted ? entry->shift_key : entry->key;
+}
 
-    if (scan_code == BACKSPACE) {
+/*
+* keyboard_decode
+*   DESCRIPTION: act on one scan code. Shift + PgUp / PgDn, alt + F1 - F12, ctrl + l and ctrl + c are
+*                handled here, other keys go to the line discipline of the terminal on the screen, with
+*                ctrl + a letter as its control character
+*   INPUTS: scan_code - the scan code
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: print the corresponding character for the pressed key
+*/
+static void keyboard_decode(uint8_t scan_code)
+{
+    uint8_t key = keyboard_translate(scan_code);
+    int32_t tid;
 
-        // 0 - the start of keyboard buffer
-        if (terminal[cur_terminal].index != 0) {
-            putc(8, 1);                                // 8 - ASCII code for backspace
-            // terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index - 1] = '\0';
-            terminal[cur_terminal].index--;            // Delete one location
-        }
+    if (key == 0) {
         return;
     }
 
-    // Not used function keys, return without printing on the screen
-    if (scan_code == TAB_PRESS || scan_code == ESC) {
+    // shift + PgUp / PgDn - page through the scrollback, NUM_ROWS - 1 keeps one row of the last page
+    if ((key == KEY_PAGE_UP || key == KEY_PAGE_DOWN) && (key_modifiers & MOD_SHIFT)) {
+        terminal_scroll_view(cur_terminal, (key == KEY_PAGE_UP) ? NUM_ROWS - 1 : -(NUM_ROWS - 1));
         return;
     }
 
-    // 58 - number of keys supported
-    if (scan_code < 58) {
-
-        // If ctrl key pressed
-        if (ctrl_pressed == 1) {
-            
-            // ctrl + l / ctrl + L
-            if (scan_code_match[scan_code] == 'l'){
-                
-                // Clearing the screen without resetting the buffer
-                clear();
-                
-                // Return without printing on the screen
-                return;
-            }
+    // alt + F1 - F12 - switch to terminal 0 - 11, the keys past the last terminal do nothing
+    if (key >= KEY_F1 && key < KEY_F1 + FUNCTION_KEYS && (key_modifiers & MOD_ALT)) {
+        tid = key - KEY_F1;
+        if (tid < num_terminals && tid != cur_terminal) {
+            terminal_switch(tid);
         }
+        return;
+    }
 
-        if (shift_pressed == 1 && shift_pressed == capital) {
-
-            // Handling buffer overflow
-            // 127 - maximum char number excluding new line
-            if ((terminal[cur_terminal].index >= 127) && scan_code_match[scan_code] != '\n') {
-                return;
-            }
-
-            if (scan_code_match[scan_code] == '\n') {
-
-                // 1 - display the character on current terminal instead of running terminal
-                putc(scan_code_match[scan_code], 1);
-                terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index++] = '\n';
-                
-                // 1 - enter key is pressed 
-                terminal[cur_terminal].enter_pressed = 1;	
-                return;						
-            } 
-
-            if (scan_code_match[scan_code] >= 'a' && scan_code_match[scan_code] <= 'z') {
-
-                // 1 - display the character on current terminal instead of running terminal
-                putc(scan_code_match[scan_code], 1);
-				terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index] = scan_code_match[scan_code];
-                terminal[cur_terminal].index++;
-                return;
-            } else {
+    if (key_modifiers & MOD_CTRL) {
 
-                // 1 - display the character on current terminal instead of running terminal
-                putc(scan_code_shift[scan_code], 1);
-				terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index] = scan_code_match[scan_code];
-                terminal[cur_terminal].index++;
-                return;
-            }
+        // ctrl + l - clear the screen without resetting the buffer
+        if (key == 'l' || key == 'L') {
+            clear();
+            return;
         }
 
-        if (shift_pressed == 1 && shift_pressed != capital) {
-
-            // Handling buffer overflow
-            // 127 - maximum char number excluding new line
-            if ((terminal[cur_terminal].index >= 127) && scan_code_match[scan_code] != '\n') {
-                return;
+        // ctrl + c - interrupt the foreground program, the base shells (pid 0 - num_terminals - 1) are kept
+        if (key == 'c' || key == 'C') {
+            if (schedule[cur_terminal] >= num_terminals) {
+                signal_raise(schedule[cur_terminal], SIG_INTERRUPT);
             }
-
-            if (scan_code_match[scan_code] == '\n') {
-
-                // 1 - display the character on current terminal instead of running terminal
-                putc(scan_code_match[scan_code], 1);
-                terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index++] = '\n';
-                
-                // 1 - enter key is pressed 
-                terminal[cur_terminal].enter_pressed = 1;	
-                return;						
-            } 
-            
-            // 1 - display the character on current terminal instead of running terminal
-            putc(scan_code_shift[scan_code], 1);
-			terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index] = scan_code_match[scan_code];
-            terminal[cur_terminal].index++;
             return;
         }
 
-        if (shift_pressed != 1 && shift_pressed != capital) {
-
-            // Handling buffer overflow
-            // 127 - maximum char number excluding new line
-            if ((terminal[cur_terminal].index >= 127) && scan_code_match[scan_code] != '\n') {
-                return;
-            }
-
-            if (scan_code_match[scan_code] == '\n') {
-
-                // 1 - display the character on current terminal instead of running terminal
-                putc(scan_code_match[scan_code], 1);
-                terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index++] = '\n';
-                
-                // 1 - enter key is pressed 
-                terminal[cur_terminal].enter_pressed = 1;	
-                return;						
-            } 
-            
-            // 1 - display the character on current terminal instead of running terminal
-            putc(scan_code_capital[scan_code], 1);
-			terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index] = scan_code_match[scan_code];
-            terminal[cur_terminal].index++;
-
-            return;
+        // 0x1F - the low 5 bits, ctrl + a - ctrl + z are 1 - 26
+        if ((key >= 'a' && key <= 'z') || (key >= 'A' && key <= 'Z')) {
+            key &= 0x1F;
         }
+    }
 
-		if (scan_code_match[scan_code] == '\n') {
+    ldisc_input(cur_terminal, key);
+}
 
-            // 1 - display the character on current terminal instead of running terminal
-			putc(scan_code_match[scan_code], 1);
-			terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index++] = '\n';
+/*
+* keyboard_put
+*   DESCRIPTION: queue a scan code for keyboard_drain. The slot is written before scan_tail moves past
+*                it, so the reader never sees a slot that is not filled yet
+*   INPUTS: scan_code - the scan code
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the ring is full and the scan code is dropped
+*   SIDE EFFECTS: none
+*/
+int32_t keyboard_put(uint8_t scan_code)
+{
+    uint32_t tail = scan_tail;
 
-            // 1 - enter key is pressed 
-			terminal[cur_terminal].enter_pressed = 1;		
+    if (tail - scan_head >= SCAN_RING_SIZE) {
+        scan_dropped++;
+        return -1;
+    }
+    scan_ring[tail % SCAN_RING_SIZE] = scan_code;
+    // keep the compiler from moving the store of the slot after the store of the index
+    asm volatile ("" : : : "memory");
+    scan_tail = tail + 1;
+    return 0;
+}
 
-            return;					
-		} 
-        
-        if (scan_code_match[scan_code] != '\0') {
+/*
+* keyboard_handler
+*   DESCRIPTION: handler for keyboard interrupt, only takes the scan code from the controller. Decoding
+*                and echo are left to keyboard_drain, so the handler takes the same short time however
+*                busy the terminal is
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void keyboard_handler()
+{
+    keyboard_put(inb(KEYBOARD_DATA_PORT));
+    send_eoi(1);        // keyboard interrupt is IRQ1
+}
 
-            // 127 - maximum char number excluding new line
-			if (terminal[cur_terminal].index < 127) {
+/*
+* keyboard_drain
+*   DESCRIPTION: decode the scan codes the interrupt handler queued, in order, from the PIT tick with
+*                interrupts on
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void keyboard_drain(void)
+{
+    uint8_t scan_code;
 
-                // 1 - display the character on current terminal instead of running terminal
-				putc(scan_code_match[scan_code], 1);
-				terminal[cur_terminal].keyboard_buffer[terminal[cur_terminal].index++] = scan_code_match[scan_code];
-			}
-		}
+    while (scan_head != scan_tail) {
+        scan_code = scan_ring[scan_head % SCAN_RING_SIZE];
+        // the slot is read before it is handed back to the handler
+        asm volatile ("" : : : "memory");
+        scan_head++;
+        keyboard_decode(scan_code);
     }
-    // sti();
 }
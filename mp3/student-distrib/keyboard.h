@@ -4,28 +4,53 @@
 #define KEYBOARD_DATA_PORT 0x60
 #define KEYBOARD_STATUS_PORT 0x64
 
-#define L_SHIFT_PRESS       0x2A
-#define L_SHIFT_RELEASE     0xAA
-#define R_SHIFT_PRESS       0x36
-#define R_SHIFT_RELEASE     0xB6
-#define CTRL_PRESS          0x1D
-#define CTRL_RELEASE        0x9D
-#define CAPS_LOCK_PRESS     0x3A
-#define CAPS_LOCK_RELEASE   0xBA
-#define ALT_PRESS           0x38
-#define ALT_RELEASE         0xB8
-#define BACKSPACE           0x0E
-#define TAB_PRESS           0x0F 
-#define ESC                 0x01
-#define F1                  0x3B
-#define F2                  0x3C
-#define F3                  0x3D
+#define KEYBOARD_STATUS_FULL 0x02   // status bit, the controller has not taken the last byte written yet
+#define KEYBOARD_SET_LEDS   0xED    // command, the next byte sets the lock lights
+#define SCAN_RELEASE        0x80    // bit of a scan code set when the key is released
+#define EXTENDED_PREFIX     0xE0    // the next scan code is a key of the extended (gray) set
+#define PAUSE_PREFIX        0xE1    // the next two scan codes are half of the pause key
+#define SCAN_RING_SIZE      128     // scan codes the interrupt handler keeps for keyboard_drain
+#define KMAP_SIZE           0x59    // scan codes of set 1 in the key maps, up to F12 at 0x58
+
+// what a scan code is, the meaning of key and shift_key of its entry in a key map
+#define KMAP_NONE           0       // a key the terminal does not use
+#define KMAP_CHAR           1       // key, shift_key with shift held
+#define KMAP_LETTER         2       // key, shift_key when exactly one of shift and caps lock is on
+#define KMAP_PAD            3       // a keypad key: key, shift_key (the digit) when num lock is on without shift
+#define KMAP_MODIFIER       4       // key is its MOD_* bit while it is held
+#define KMAP_LOCK           5       // key is its LOCK_* bit, toggled when it is pressed
+
+// modifier keys held down, the left and right keys are kept apart
+#define MOD_LSHIFT          0x01
+#define MOD_RSHIFT          0x02
+#define MOD_LCTRL           0x04
+#define MOD_RCTRL           0x08
+#define MOD_LALT            0x10
+#define MOD_RALT            0x20
+#define MOD_SHIFT           (MOD_LSHIFT | MOD_RSHIFT)
+#define MOD_CTRL            (MOD_LCTRL | MOD_RCTRL)
+#define MOD_ALT             (MOD_LALT | MOD_RALT)
+
+// lock keys that are on, the same bits as the lights of the set lights command
+#define LOCK_SCROLL         0x01
+#define LOCK_NUM            0x02
+#define LOCK_CAPS           0x04
+
+// one scan code in a key map
+typedef struct key_map_t
+{
+    uint8_t type;           // KMAP_*
+    uint8_t key;
+    uint8_t shift_key;
+} key_map_t;
 
 extern void keyboard_init();
 extern void keyboard_handler();
+// queue a scan code for keyboard_drain, -1 if the ring is full
+extern int32_t keyboard_put(uint8_t scan_code);
+// decode the queued scan codes, from the PIT tick
+extern void keyboard_drain(void);
 
-extern char scan_code_match[58];
-extern char scan_code_shift[58];
-extern char scan_code_capital[58];
+extern uint8_t key_modifiers;
+extern uint8_t key_locks;
 #endif
-
@@ -0,0 +1,388 @@
+#include "ldisc.h"
+#include "lib.h"
+#include "terminal.h"
+#include "filesystem.h"
+#include "system_calls.h"
+
+// slot of the history ring holding the line b entries back, 0 for the line being typed
+#define HISTORY_SLOT(t, b) (((t)->cmd_count - (b) + (LDISC_HISTORY + 1)) % (LDISC_HISTORY + 1))
+
+/*
+* ldisc_echo
+*   DESCRIPTION: show characters of the line on a terminal
+*   INPUTS: tid - terminal id
+*           buf - the characters
+*           n - number of characters
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_echo(int32_t tid, const char* buf, int32_t n)
+{
+    if (n > 0) {
+        putbuf_terminal((const uint8_t*)buf, n, tid, 1);
+    }
+}
+
+/*
+* ldisc_redraw
+*   DESCRIPTION: show the line again from position from, after an edit that changed it there. The
+*                cursor on the screen is at from, and is left at the cursor of the line
+*   INPUTS: tid - terminal id
+*           from - first position that changed
+*           old_len - length of the line before the edit, the rest of a longer line is blanked
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_redraw(int32_t tid, int32_t from, int32_t old_len)
+{
+    terminal_t* t = &terminal[tid];
+    int32_t end = t->index;
+
+    ldisc_echo(tid, t->keyboard_buffer + from, t->index - from);
+    for (; end < old_len; end++) {
+        ldisc_echo(tid, " ", 1);
+    }
+    putbuf_back(tid, end - t->line_cursor);
+}
+
+/*
+* ldisc_insert
+*   DESCRIPTION: put characters into the line at its cursor
+*   INPUTS: tid - terminal id
+*           buf - the characters
+*           n - number of characters, cut to the room left for the '\n'
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_insert(int32_t tid, const char* buf, int32_t n)
+{
+    terminal_t* t = &terminal[tid];
+    int32_t from = t->line_cursor;
+    int32_t i;
+
+    if (n > LDISC_LINE - 1 - t->index) {
+        n = LDISC_LINE - 1 - t->index;
+    }
+    if (n <= 0) {
+        return;
+    }
+    for (i = t->index - 1; i >= from; i--) {
+        t->keyboard_buffer[i + n] = t->keyboard_buffer[i];
+    }
+    memcpy(t->keyboard_buffer + from, buf, n);
+    t->index += n;
+    t->line_cursor += n;
+    ldisc_redraw(tid, from, t->index - n);
+}
+
+/*
+* ldisc_erase
+*   DESCRIPTION: take the character at a position out of the line
+*   INPUTS: tid - terminal id
+*           pos - the position, the cursor on the screen is there
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_erase(int32_t tid, int32_t pos)
+{
+    terminal_t* t = &terminal[tid];
+
+    memmove(t->keyboard_buffer + pos, t->keyboard_buffer + pos + 1, t->index - pos - 1);
+    t->index--;
+    t->line_cursor = pos;
+    ldisc_redraw(tid, pos, t->index + 1);
+}
+
+/*
+* ldisc_replace
+*   DESCRIPTION: show another line in place of the one being typed, with the cursor at its end
+*   INPUTS: tid - terminal id
+*           line - the new line, null-terminated
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_replace(int32_t tid, const char* line)
+{
+    terminal_t* t = &terminal[tid];
+    int32_t old_len = t->index;
+
+    putbuf_back(tid, t->line_cursor);
+    t->index = strlen((const int8_t*)line);
+    memcpy(t->keyboard_buffer, line, t->index);
+    t->line_cursor = t->index;
+    ldisc_redraw(tid, 0, old_len);
+}
+
+/*
+* ldisc_browse
+*   DESCRIPTION: go back (up) or forward (down) in the history. The line being typed is kept in the
+*                spare slot of the ring, so going forward past the newest line brings it back
+*   INPUTS: tid - terminal id
+*           step - 1 to go back, -1 to go forward
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_browse(int32_t tid, int32_t step)
+{
+    terminal_t* t = &terminal[tid];
+    int32_t kept = (t->cmd_count < LDISC_HISTORY) ? t->cmd_count : LDISC_HISTORY;
+    char* slot = t->cmd_history[HISTORY_SLOT(t, t->cmd_browse)];
+
+    if (t->cmd_browse + step < 0 || t->cmd_browse + step > kept) {
+        return;
+    }
+    // edits of a line of the history are dropped, the line being typed is kept
+    if (t->cmd_browse == 0) {
+        memcpy(slot, t->keyboard_buffer, t->index);
+        slot[t->index] = '\0';
+    }
+    t->cmd_browse += step;
+    ldisc_replace(tid, t->cmd_history[HISTORY_SLOT(t, t->cmd_browse)]);
+}
+
+/*
+* ldisc_complete
+*   DESCRIPTION: complete the word before the cursor with the names of the files in the directory. A
+*                unique name is finished with a space, several names are completed as far as they
+*                agree, and listed below the line if they already do
+*   INPUTS: tid - terminal id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_complete(int32_t tid)
+{
+    terminal_t* t = &terminal[tid];
+    char match[DIR_NAME_LEN + 1];
+    dentry_t dentry;
+    int32_t start = t->line_cursor;
+    int32_t len;
+    int32_t common = 0;
+    int32_t count = 0;
+    int32_t i, j;
+
+    while (start > 0 && t->keyboard_buffer[start - 1] != ' ') {
+        start--;
+    }
+    len = t->line_cursor - start;
+    // the longest start all the names with the word agree on
+    for (i = 0; read_dentry_by_index(i, &dentry) == 0; i++) {
+        if (strncmp((const int8_t*)dentry.file_name, (const int8_t*)t->keyboard_buffer + start, len) != 0) {
+            continue;
+        }
+        if (count++ == 0) {
+            memcpy(match, dentry.file_name, DIR_NAME_LEN);
+            match[DIR_NAME_LEN] = '\0';
+            common = strlen((const int8_t*)match);
+        }
+        for (j = len; j < common && dentry.file_name[j] == match[j]; j++);
+        common = j;
+    }
+    if (count == 0) {
+        return;
+    }
+    if (common > len) {
+        ldisc_insert(tid, match + len, common - len);
+    }
+    if (count == 1) {
+        ldisc_insert(tid, " ", 1);
+        return;
+    }
+    if (common > len) {
+        return;
+    }
+    // list the names on the rows below, then show the line again
+    ldisc_echo(tid, t->keyboard_buffer + t->line_cursor, t->index - t->line_cursor);
+    ldisc_echo(tid, "\n", 1);
+    for (i = 0; read_dentry_by_index(i, &dentry) == 0; i++) {
+        if (strncmp((const int8_t*)dentry.file_name, (const int8_t*)t->keyboard_buffer + start, len) == 0) {
+            memcpy(match, dentry.file_name, DIR_NAME_LEN);
+            match[DIR_NAME_LEN] = '\0';
+            ldisc_echo(tid, match, strlen((const int8_t*)match));
+            ldisc_echo(tid, "  ", 2);
+        }
+    }
+    ldisc_echo(tid, "\n", 1);
+    ldisc_echo(tid, t->keyboard_buffer, t->index);
+    putbuf_back(tid, t->index - t->line_cursor);
+}
+
+/*
+* ldisc_enter
+*   DESCRIPTION: end the line and hand it to a reader, keeping it in the history unless it is empty or
+*                the same as the last one
+*   INPUTS: tid - terminal id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void ldisc_enter(int32_t tid)
+{
+    terminal_t* t = &terminal[tid];
+    char* last = t->cmd_history[HISTORY_SLOT(t, 1)];
+
+    ldisc_echo(tid, t->keyboard_buffer + t->line_cursor, t->index - t->line_cursor);
+    ldisc_echo(tid, "\n", 1);
+    if (t->index != 0 && (t->cmd_count == 0 || (int32_t)strlen((const int8_t*)last) != t->index ||
+        strncmp((const int8_t*)last, (const int8_t*)t->keyboard_buffer, t->index) != 0)) {
+        memcpy(t->cmd_history[HISTORY_SLOT(t, 0)], t->keyboard_buffer, t->index);
+        t->cmd_history[HISTORY_SLOT(t, 0)][t->index] = '\0';
+        t->cmd_count++;
+    }
+    t->cmd_history[HISTORY_SLOT(t, 0)][0] = '\0';
+    t->cmd_browse = 0;
+    t->line_cursor = 0;
+    t->keyboard_buffer[t->index++] = '\n';
+    terminal_line_entered(tid);
+}
+
+/*
+* ldisc_input
+*   DESCRIPTION: line discipline of a terminal, for the keyboard and the serial console. In cooked mode
+*                the line is edited with backspace, delete and the arrow, home and end keys, up and down
+*                go through the history, tab completes file names, and enter hands the line to a reader.
+*                In raw mode each key is queued for read as it is, without echo
+*   INPUTS: tid - terminal id
+*           c - a character, '\n' for enter, 8 for backspace, or a KEY_*
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: called with interrupts off, from the PIT tick
+*/
+void ldisc_input(int32_t tid, uint8_t c)
+{
+    terminal_t* t = &terminal[tid];
+
+    if (t->raw_pid != -1) {
+        if (t->index < LDISC_LINE) {
+            t->keyboard_buffer[t->index++] = c;
+        }
+        return;
+    }
+    // a line is waiting for terminal_read, typing waits for the next one
+    if (t->enter_pressed) {
+        return;
+    }
+    switch (c) {
+    case '\n':
+        ldisc_enter(tid);
+        break;
+    case 8:
+        if (t->line_cursor > 0) {
+            putbuf_back(tid, 1);
+            ldisc_erase(tid, t->line_cursor - 1);
+        }
+        break;
+    case KEY_DELETE:
+        if (t->line_cursor < t->index) {
+            ldisc_erase(tid, t->line_cursor);
+        }
+        break;
+    case KEY_LEFT:
+        if (t->line_cursor > 0) {
+            putbuf_back(tid, 1);
+            t->line_cursor--;
+        }
+        break;
+    case KEY_RIGHT:
+        if (t->line_cursor < t->index) {
+            ldisc_echo(tid, t->keyboard_buffer + t->line_cursor, 1);
+            t->line_cursor++;
+        }
+        break;
+    case KEY_HOME:
+        putbuf_back(tid, t->line_cursor);
+        t->line_cursor = 0;
+        break;
+    case KEY_END:
+        ldisc_echo(tid, t->keyboard_buffer + t->line_cursor, t->index - t->line_cursor);
+        t->line_cursor = t->index;
+        break;
+    case KEY_UP:
+        ldisc_browse(tid, 1);
+        break;
+    case KEY_DOWN:
+        ldisc_browse(tid, -1);
+        break;
+    case '\t':
+        ldisc_complete(tid);
+        break;
+    default:
+        // ' ' - '~' - printable
+        if (c >= ' ' && c <= '~') {
+            ldisc_insert(tid, (const char*)&c, 1);
+        }
+        break;
+    }
+}
+
+/*
+* ldisc_set_mode
+*   DESCRIPTION: switch a terminal between cooked and raw mode for the running process. A line being
+*                typed is dropped. The terminal goes back to cooked mode when the process halts
+*   INPUTS: tid - terminal id
+*           mode - TERM_COOKED or TERM_RAW
+*   OUTPUTS: none
+*   RETURN VALUE: the mode before, -1 for a bad mode
+*   SIDE EFFECTS: none
+*/
+int32_t ldisc_set_mode(int32_t tid, int32_t mode)
+{
+    terminal_t* t = &terminal[tid];
+    int32_t old = (t->raw_pid == -1) ? TERM_COOKED : TERM_RAW;
+    uint32_t flags;
+
+    if (mode != TERM_COOKED && mode != TERM_RAW) {
+        return -1;
+    }
+    cli_and_save(flags);
+    if (mode != old) {
+        t->raw_pid = (mode == TERM_RAW) ? get_pid() : -1;
+        t->index = 0;
+        t->line_cursor = 0;
+        t->enter_pressed = 0;
+    }
+    restore_flags(flags);
+    return old;
+}
+
+/*
+* ldisc_halt
+*   DESCRIPTION: put a terminal back in cooked mode if the halting process left it raw, so its shell
+*                reads lines again
+*   INPUTS: tid - terminal id of the process
+*           pid - the process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void ldisc_halt(int32_t tid, int32_t pid)
+{
+    if (terminal[tid].raw_pid == pid) {
+        terminal[tid].raw_pid = -1;
+        terminal[tid].index = 0;
+        terminal[tid].line_cursor = 0;
+    }
+}
+
+/*
+* ioctl
+*   DESCRIPTION: control the terminal a file descriptor reads from
+*   INPUTS: fd -- a file descriptor of the terminal
+*           cmd -- TERM_COOKED or TERM_RAW
+*           arg -- unused
+*   OUTPUTS: none
+*   RETURN VALUE: the mode before, -1 if fd is not the terminal or cmd is not a command
+*/
+int32_t ioctl(int32_t fd, int32_t cmd, int32_t arg)
+{
+    if (isatty(fd) != 1) {
+        return -1;
+    }
+    return ldisc_set_mode(run_terminal, cmd);
+}
@@ -0,0 +1,36 @@
+/* ldisc.h - Defines for the line discipline between the keys typed on a terminal and its readers
+ */
+#ifndef LDISC_H
+#define LDISC_H
+#include "types.h"
+
+#define LDISC_LINE 128              // characters of a line with its '\n', the size of the keyboard buffer
+#define LDISC_HISTORY 16            // lines kept in the history of a terminal
+
+// keys that edit the line, outside of ASCII. In raw mode read returns them as they are
+#define KEY_UP 0x80
+#define KEY_DOWN 0x81
+#define KEY_LEFT 0x82
+#define KEY_RIGHT 0x83
+#define KEY_HOME 0x84
+#define KEY_END 0x85
+#define KEY_DELETE 0x86
+#define KEY_PAGE_UP 0x87
+#define KEY_PAGE_DOWN 0x88
+#define KEY_INSERT 0x89
+#define KEY_F1 0x90                 // F1 - F12 are KEY_F1 - KEY_F1 + 11
+
+// commands of the ioctl system call on a terminal
+#define TERM_COOKED 0               // lines are edited and echoed, read returns one line (the default)
+#define TERM_RAW 1                  // read returns the keys as they are typed, without echo or editing
+
+// hand a typed character or KEY_* to the line discipline of terminal tid
+extern void ldisc_input(int32_t tid, uint8_t c);
+// switch terminal tid between TERM_COOKED and TERM_RAW
+extern int32_t ldisc_set_mode(int32_t tid, int32_t mode);
+// put terminal tid back in cooked mode if process pid left it raw
+extern void ldisc_halt(int32_t tid, int32_t pid);
+// system call 25, control the terminal fd reads from
+extern int32_t ioctl(int32_t fd, int32_t cmd, int32_t arg);
+
+#endif
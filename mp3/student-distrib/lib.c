@@ -5,25 +5,30 @@
 #include "cursor.h"
 #include "terminal.h"
 #include "system_calls.h"
+#include "serial.h"
 
 static char* video_mem = (char *)VIDEO;
 
 /* void clear(void);
  * Inputs: void
  * Return Value: none
- * Function: Clears video memory */
+ * Function: Clears the visible terminal, its scrollback is kept */
 void clear(void) {
     int32_t i;
-	memory_switch(cur_terminal);
+	int32_t y;
+	uint32_t flags;
+	cli_and_save(flags);
 	terminal[cur_terminal].cursor_x = 0;
 	terminal[cur_terminal].cursor_y = 0;
-	memory_switch(cur_terminal);
-	for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-		*(uint8_t *)(video_mem + (i << 1)) = ' ';
-		*(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
+	terminal[cur_terminal].view = 0;
+	for (y = 0; y < NUM_ROWS; y++) {
+		for (i = 0; i < NUM_COLS; i++) {
+			SHADOW_ROW(&terminal[cur_terminal], y)[i] = CELL_ATTR(' ', terminal[cur_terminal].attrib);
+		}
 	}
-	memory_switch(run_terminal);
-	update_cursor(terminal[cur_terminal].cursor_x, terminal[cur_terminal].cursor_y);
+	terminal[cur_terminal].dirty = (1U << NUM_ROWS) - 1;
+	terminal_flush(cur_terminal);
+	restore_flags(flags);
 }
 
 /* Standard printf().
@@ -157,32 +162,87 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index], 0);
-        index++;
-    }
-    return index;
+    return putbuf((const uint8_t*)s, strlen(s), 0);
 }
 
-/* void putc(uint8_t c);
- * Inputs: uint_8* c = character to print
+/* static void scroll_up(int tid);
+ * Inputs: int tid = terminal to scroll
  * Return Value: void
- *  Function: Output a character to the console */
-void putc(uint8_t c, uint8_t user) {
-    int tid;
+ *  Function: Move the shadow screen of a terminal up one line and blank the last line. The top row
+ *            stays in the ring as the newest line of the scrollback, so no row is copied */
+static void scroll_up(int tid) {
 	int i;
+	// the row below the screen, the oldest line of the scrollback once it is full
+	uint16_t* row = SHADOW_ROW(&terminal[tid], NUM_ROWS);
+	for (i = 0; i < NUM_COLS; i++) {
+		row[i] = CELL_ATTR(' ', terminal[tid].attrib);
+	}
+	terminal[tid].top = (terminal[tid].top + 1) % SHADOW_ROWS;
+	if (terminal[tid].history < SCROLLBACK_ROWS) {
+		terminal[tid].history++;
+	}
+	// a view back in the scrollback stays on the same lines while it can
+	if (terminal[tid].view != 0 && terminal[tid].view < terminal[tid].history) {
+		terminal[tid].view++;
+	}
+	// every row of the screen shows a different line now
+	terminal[tid].dirty = (1U << NUM_ROWS) - 1;
+}
 
-	if (user == 0) {
-		tid = run_terminal;
-	} else {
-		tid = cur_terminal;
+/* static void mark_dirty(int tid, int y);
+ * Inputs: int tid = terminal
+ *         int y = row of the output that changed
+ * Return Value: void
+ *  Function: Mark the screen row showing a row of the output, unless the view is far enough back in
+ *            the scrollback that it is not on the screen */
+static void mark_dirty(int tid, int y) {
+	if (y + terminal[tid].view < NUM_ROWS) {
+		terminal[tid].dirty |= 1U << (y + terminal[tid].view);
 	}
+}
 
-	if (user == 1) {
-		memory_switch(cur_terminal);
+/* static void put_cell(uint8_t c, int tid);
+ * Inputs: uint_8* c = character to store
+ *         int tid = terminal
+ * Return Value: void
+ *  Function: Store a character at the cursor of a terminal and mark its row dirty */
+static void put_cell(uint8_t c, int tid) {
+	SHADOW_ROW(&terminal[tid], terminal[tid].cursor_y)[terminal[tid].cursor_x] = CELL_ATTR(c, terminal[tid].attrib);
+	mark_dirty(tid, terminal[tid].cursor_y);
+}
+
+/* static void erase_cells(int tid, int y, int from, int to);
+ * Inputs: int tid = terminal
+ *         int y = row of the output
+ *         int from, to = first and one past the last column to blank
+ * Return Value: void
+ *  Function: Blank part of a row with the current attribute */
+static void erase_cells(int tid, int y, int from, int to) {
+	uint16_t* row = SHADOW_ROW(&terminal[tid], y);
+	for (; from < to; from++) {
+		row[from] = CELL_ATTR(' ', terminal[tid].attrib);
 	}
+	mark_dirty(tid, y);
+}
 
+/* static void new_line(int tid);
+ * Inputs: int tid = terminal
+ * Return Value: void
+ *  Function: Move the cursor to the start of the next row, scrolling at the bottom of the screen */
+static void new_line(int tid) {
+	terminal[tid].cursor_x = 0;
+	if (++terminal[tid].cursor_y >= NUM_ROWS) {
+		scroll_up(tid);
+		terminal[tid].cursor_y = NUM_ROWS - 1;
+	}
+}
+
+/* static void put_char(uint8_t c, int tid);
+ * Inputs: uint_8* c = character to print
+ *         int tid = terminal whose cursor is advanced
+ * Return Value: void
+ *  Function: Render a character into the shadow screen of a terminal */
+static void put_char(uint8_t c, int tid) {
 	if (c == 8) {
 		if (terminal[tid].cursor_x == 0) {
             if (terminal[tid].cursor_y == 0) {
@@ -192,67 +252,365 @@ void putc(uint8_t c, uint8_t user) {
 			(terminal[tid].cursor_y)--;
         }
 		terminal[tid].cursor_x--;
-		if (terminal[tid].cursor_x == 255) {
-			terminal[tid].cursor_y--;
-			terminal[tid].cursor_x = NUM_COLS - 1;
-		}
-		*(uint8_t *)(video_mem + ((NUM_COLS * terminal[tid].cursor_y + terminal[tid].cursor_x) << 1)) = ' ';
-		*(uint8_t *)(video_mem + ((NUM_COLS * terminal[tid].cursor_y + terminal[tid].cursor_x) << 1) + 1) = ATTRIB;
-		update_cursor(terminal[cur_terminal].cursor_x, terminal[cur_terminal].cursor_y);
-		if (user == 1) {
-			memory_switch(run_terminal);
-		}
+		put_cell(' ', tid);
 		return;
 	}
 
 	if (c == '\n' || c == '\r') {
-		(terminal[tid].cursor_y)++;
-        terminal[tid].cursor_x = 0;
-		if (terminal[tid].cursor_y >= NUM_ROWS) {
-			for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-                if (i < NUM_COLS * (NUM_ROWS - 1)) {
-                    video_mem[i << 1] = video_mem[(i + NUM_COLS) << 1];
-                } else {
-                    *(uint8_t *)(video_mem + (i << 1)) = ' ';
-                    *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-                }
-            }
-			if (--terminal[tid].cursor_y == 255) {
-				++terminal[tid].cursor_y;
-			}
-		}
-		update_cursor(terminal[cur_terminal].cursor_x, terminal[cur_terminal].cursor_y);
-		if (user == 1) {
-			memory_switch(run_terminal);
-		}
+		new_line(tid);
 		return;
 	}
 	
+	// a character in the last column leaves the cursor past it, the next one wraps
 	if (terminal[tid].cursor_x >= NUM_COLS) {
-		terminal[tid].cursor_x = 0;
-		terminal[tid].cursor_y++;
-		if (terminal[tid].cursor_y >= NUM_ROWS) {
-			for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-				if (i < NUM_COLS * (NUM_ROWS - 1)) {
-					video_mem[i << 1] = video_mem[(i + NUM_COLS) << 1];
-				} else {
-					*(uint8_t *)(video_mem + (i << 1)) = ' ';
-					*(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
-				}
+		new_line(tid);
+	}
+	put_cell(c, tid);
+	terminal[tid].cursor_x++;
+}
+
+/* static int32_t put_run(const uint8_t* buf, int32_t n, int tid);
+ * Inputs: const uint8_t* buf = characters to print
+ *         int32_t n = number of characters
+ *         int tid = terminal
+ * Return Value: number of characters printed, at least 1
+ *  Function: Copy the ordinary characters at the start of buf into the row of the cursor in one go,
+ *            stopping at a control character or the end of the row */
+static int32_t put_run(const uint8_t* buf, int32_t n, int tid) {
+	uint16_t* row;
+	uint16_t attrib;
+	int32_t i;
+
+	if (terminal[tid].cursor_x >= NUM_COLS) {
+		new_line(tid);
+	}
+	row = SHADOW_ROW(&terminal[tid], terminal[tid].cursor_y) + terminal[tid].cursor_x;
+	attrib = (uint16_t)terminal[tid].attrib << 8;
+	// 8, '\n', '\r' and ESC are handled one at a time
+	for (i = 0; i < n && i < NUM_COLS - terminal[tid].cursor_x; i++) {
+		if (buf[i] == 8 || buf[i] == '\n' || buf[i] == '\r' || buf[i] == ESC_CHAR) {
+			break;
+		}
+		row[i] = buf[i] | attrib;
+	}
+	mark_dirty(tid, terminal[tid].cursor_y);
+	terminal[tid].cursor_x += i;
+	return i;
+}
+
+/* static void ansi_sgr(int tid);
+ * Inputs: int tid = terminal
+ * Return Value: void
+ *  Function: Apply ESC [ ... m, select graphic rendition, to the attribute of the next cells */
+static void ansi_sgr(int tid) {
+	// ANSI color order (black, red, green, yellow, blue, magenta, cyan, white) to VGA color numbers
+	static const uint8_t vga_color[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+	uint8_t attrib = terminal[tid].attrib;
+	int p;
+	int i;
+
+	for (i = 0; i <= terminal[tid].esc_count; i++) {
+		p = terminal[tid].esc_params[i];
+		if (p == 0) {
+			attrib = ATTRIB;
+		} else if (p == 1) {
+			// 0x08 - the bright bit of the foreground
+			attrib |= 0x08;
+		} else if (p == 22) {
+			attrib &= ~0x08;
+		} else if (p == 7) {
+			// 4 - the background is the high nibble
+			attrib = (attrib << 4) | (attrib >> 4);
+		} else if (p >= 30 && p <= 37) {
+			attrib = (attrib & 0xF8) | vga_color[p - 30];
+		} else if (p == 39) {
+			attrib = (attrib & 0xF8) | (ATTRIB & 0x07);
+		} else if (p >= 40 && p <= 47) {
+			attrib = (attrib & 0x0F) | (vga_color[p - 40] << 4);
+		} else if (p == 49) {
+			attrib = (attrib & 0x0F) | (ATTRIB & 0xF0);
+		} else if (p >= 90 && p <= 97) {
+			attrib = (attrib & 0xF0) | 0x08 | vga_color[p - 90];
+		}
+	}
+	terminal[tid].attrib = attrib;
+}
+
+/* static void ansi_csi(uint8_t c, int tid);
+ * Inputs: uint8_t c = final byte of the sequence
+ *         int tid = terminal
+ * Return Value: void
+ *  Function: Run an ESC [ ... sequence: cursor movement (A B C D H f), erasing (J K), attributes (m)
+ *            and saving the cursor (s u). Others are ignored */
+static void ansi_csi(uint8_t c, int tid) {
+	terminal_t* t = &terminal[tid];
+	int n = (t->esc_params[0] == 0) ? 1 : t->esc_params[0];
+	// a cursor left past the last column by a full row counts as in the last column
+	int x = (t->cursor_x < NUM_COLS) ? t->cursor_x : NUM_COLS - 1;
+	int y;
+
+	switch (c) {
+	case 'A':
+		t->cursor_y = (t->cursor_y > n) ? t->cursor_y - n : 0;
+		break;
+	case 'B':
+		t->cursor_y = (t->cursor_y + n < NUM_ROWS) ? t->cursor_y + n : NUM_ROWS - 1;
+		break;
+	case 'C':
+		t->cursor_x = (x + n < NUM_COLS) ? x + n : NUM_COLS - 1;
+		break;
+	case 'D':
+		t->cursor_x = (x > n) ? x - n : 0;
+		break;
+	case 'H':
+	case 'f':
+		// row and column count from 1
+		t->cursor_y = (n <= NUM_ROWS) ? n - 1 : NUM_ROWS - 1;
+		n = (t->esc_params[1] == 0) ? 1 : t->esc_params[1];
+		t->cursor_x = (n <= NUM_COLS) ? n - 1 : NUM_COLS - 1;
+		break;
+	case 'J':
+		// 0 - to the end of the screen, 1 - from its start, 2 - all of it
+		if (t->esc_params[0] == 0) {
+			erase_cells(tid, t->cursor_y, x, NUM_COLS);
+			for (y = t->cursor_y + 1; y < NUM_ROWS; y++) {
+				erase_cells(tid, y, 0, NUM_COLS);
+			}
+		} else if (t->esc_params[0] == 1) {
+			for (y = 0; y < t->cursor_y; y++) {
+				erase_cells(tid, y, 0, NUM_COLS);
 			}
-			if (--terminal[tid].cursor_y == 255) {
-				++terminal[tid].cursor_y;
+			erase_cells(tid, t->cursor_y, 0, x + 1);
+		} else if (t->esc_params[0] == 2) {
+			for (y = 0; y < NUM_ROWS; y++) {
+				erase_cells(tid, y, 0, NUM_COLS);
 			}
 		}
-		update_cursor(terminal[cur_terminal].cursor_x, terminal[cur_terminal].cursor_y);
+		break;
+	case 'K':
+		// 0 - to the end of the row, 1 - from its start, 2 - all of it
+		if (t->esc_params[0] == 0) {
+			erase_cells(tid, t->cursor_y, x, NUM_COLS);
+		} else if (t->esc_params[0] == 1) {
+			erase_cells(tid, t->cursor_y, 0, x + 1);
+		} else if (t->esc_params[0] == 2) {
+			erase_cells(tid, t->cursor_y, 0, NUM_COLS);
+		}
+		break;
+	case 'm':
+		ansi_sgr(tid);
+		break;
+	case 's':
+		t->saved_x = t->cursor_x;
+		t->saved_y = t->cursor_y;
+		break;
+	case 'u':
+		t->cursor_x = t->saved_x;
+		t->cursor_y = t->saved_y;
+		break;
+	default:
+		break;
+	}
+}
+
+/* static void put_ansi(uint8_t c, int tid);
+ * Inputs: uint8_t c = character to print
+ *         int tid = terminal
+ * Return Value: void
+ *  Function: Feed a character that is not part of a run of text to the escape sequence parser of a
+ *            terminal. Sequences may be split across writes */
+static void put_ansi(uint8_t c, int tid) {
+	terminal_t* t = &terminal[tid];
+	int i;
+
+	switch (t->esc_state) {
+	case ESC_NONE:
+		if (c == ESC_CHAR) {
+			t->esc_state = ESC_START;
+		} else {
+			put_char(c, tid);
+		}
+		break;
+	case ESC_START:
+		t->esc_state = ESC_NONE;
+		if (c == '[') {
+			t->esc_state = ESC_CSI;
+			t->esc_count = 0;
+			for (i = 0; i < ESC_PARAMS_MAX; i++) {
+				t->esc_params[i] = 0;
+			}
+		} else if (c == 'c') {
+			// ESC c - reset the attribute and clear the screen
+			t->attrib = ATTRIB;
+			for (i = 0; i < NUM_ROWS; i++) {
+				erase_cells(tid, i, 0, NUM_COLS);
+			}
+			t->cursor_x = 0;
+			t->cursor_y = 0;
+		}
+		break;
+	case ESC_CSI:
+		if (c >= '0' && c <= '9') {
+			// 10000 - keeps a run of digits from overflowing
+			if (t->esc_params[t->esc_count] < 10000) {
+				t->esc_params[t->esc_count] = t->esc_params[t->esc_count] * 10 + (c - '0');
+			}
+		} else if (c == ';') {
+			if (t->esc_count < ESC_PARAMS_MAX - 1) {
+				t->esc_count++;
+			}
+		} else if (c == '?' && t->esc_count == 0 && t->esc_params[0] == 0) {
+			t->esc_state = ESC_IGNORE;
+		} else if (c >= 0x40 && c <= 0x7E) {
+			// 0x40 - 0x7E - final bytes
+			t->esc_state = ESC_NONE;
+			ansi_csi(c, tid);
+		}
+		break;
+	case ESC_IGNORE:
+		if (c >= 0x40 && c <= 0x7E) {
+			t->esc_state = ESC_NONE;
+		}
+		break;
+	default:
+		t->esc_state = ESC_NONE;
+		break;
+	}
+}
+
+/* void putc(uint8_t c);
+ * Inputs: uint_8* c = character to print
+ * Return Value: void
+ *  Function: Output a character to the console */
+void putc(uint8_t c, uint8_t user) {
+	putbuf(&c, 1, user);
+}
+
+/* int32_t putbuf(const uint8_t* buf, int32_t n, uint8_t user);
+ * Inputs: const uint8_t* buf = characters to print
+ *         int32_t n = number of characters
+ *         uint8_t user = 1 to echo to the visible terminal, 0 to write to the running terminal
+ * Return Value: number of characters written
+ *  Function: Write a run of characters to a terminal, see putbuf_terminal */
+int32_t putbuf(const uint8_t* buf, int32_t n, uint8_t user) {
+	return putbuf_terminal(buf, n, (user == 0) ? run_terminal : cur_terminal, user);
+}
+
+/* static void putbuf_chunk(const uint8_t* buf, int32_t n, int32_t tid, uint8_t user);
+ * Inputs: const uint8_t* buf = characters to print
+ *         int32_t n = number of characters, at most NUM_COLS
+ *         int32_t tid = terminal to write to
+ *         uint8_t user = 1 for the echo of typed characters, 0 for output
+ * Return Value: void
+ *  Function: Write one chunk of putbuf_terminal. Only the rendering runs with interrupts off */
+static void putbuf_chunk(const uint8_t* buf, int32_t n, int32_t tid, uint8_t user) {
+	int32_t i;
+	uint32_t flags;
+
+	if ((terminal[tid].backend & TERMINAL_SERIAL) && user == 0) {
+		serial_write(buf, n);
+	} else if (terminal[tid].backend & TERMINAL_SERIAL) {
+		for (i = 0; i < n; i++) {
+			// 8 - the echo of backspace erases the character on the other end too
+			if (buf[i] == 8) {
+				serial_write((const uint8_t*)"\b \b", 3);
+			} else {
+				serial_write(buf + i, 1);
+			}
+		}
+	}
+	if (!(terminal[tid].backend & TERMINAL_VGA)) {
+		return;
+	}
+
+	// the keyboard echo and the PIT flush must not see a half-scrolled screen
+	cli_and_save(flags);
+	// typing returns from the scrollback to the output
+	if (user == 1 && terminal[tid].view != 0) {
+		terminal_scroll_view(tid, -terminal[tid].view);
 	}
-	*(uint8_t *)(video_mem + ((NUM_COLS * terminal[tid].cursor_y + terminal[tid].cursor_x) << 1)) = c;
-	*(uint8_t *)(video_mem + ((NUM_COLS * terminal[tid].cursor_y + terminal[tid].cursor_x) << 1) + 1) = ATTRIB;
-	terminal[tid].cursor_x++;
-	update_cursor(terminal[cur_terminal].cursor_x, terminal[cur_terminal].cursor_y);
 	if (user == 1) {
-		memory_switch(run_terminal);
+		// the keyboard echo is plain text, it must not end up inside an escape sequence of the output
+		for (i = 0; i < n; i++) {
+			put_char(buf[i], tid);
+		}
+	} else {
+		for (i = 0; i < n; ) {
+			if (terminal[tid].esc_state == ESC_NONE && buf[i] != 8 && buf[i] != '\n' && buf[i] != '\r' && buf[i] != ESC_CHAR) {
+				i += put_run(buf + i, n - i, tid);
+			} else {
+				put_ansi(buf[i++], tid);
+			}
+		}
+	}
+	// the echo shows at once, output is copied to video memory once per write by putbuf_terminal
+	if (user == 1 && tid == cur_terminal) {
+		terminal_flush(tid);
+	}
+	restore_flags(flags);
+}
+
+/* int32_t putbuf_terminal(const uint8_t* buf, int32_t n, int32_t tid, uint8_t user);
+ * Inputs: const uint8_t* buf = characters to print
+ *         int32_t n = number of characters
+ *         int32_t tid = terminal to write to
+ *         uint8_t user = 1 for the echo of typed characters, 0 for output
+ * Return Value: number of characters written
+ *  Function: Send a run of characters to the serial console if the terminal is on it, and render it
+ *            into the shadow screen, then copy the changed rows to video memory once. A terminal that
+ *            is not visible is flushed by the PIT tick instead. Output other than the echo may hold
+ *            ANSI escape sequences, which may span chunks. The buffer goes a row's worth at a time
+ *            so interrupts are only held off for one chunk */
+int32_t putbuf_terminal(const uint8_t* buf, int32_t n, int32_t tid, uint8_t user) {
+	int32_t done;
+	int32_t len;
+	uint32_t flags;
+
+	for (done = 0; done < n; done += len) {
+		len = (n - done < NUM_COLS) ? n - done : NUM_COLS;
+		putbuf_chunk(buf + done, len, tid, user);
+	}
+	// rows scrolled by several chunks are copied once
+	cli_and_save(flags);
+	if (user == 0 && tid == cur_terminal && (terminal[tid].backend & TERMINAL_VGA)) {
+		terminal_flush(tid);
+	}
+	restore_flags(flags);
+	return n;
+}
+
+/* void putbuf_back(int32_t tid, int32_t n);
+ * Inputs: int32_t tid = terminal
+ *         int32_t n = number of cells
+ * Return Value: void
+ *  Function: Move the cursor of a terminal back over n cells without erasing them, up a row at the
+ *            start of one, for the line editor. The serial console is sent n backspaces */
+void putbuf_back(int32_t tid, int32_t n) {
+	int32_t i;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if (terminal[tid].backend & TERMINAL_SERIAL) {
+		for (i = 0; i < n; i++) {
+			serial_write((const uint8_t*)"\b", 1);
+		}
+	}
+	if (terminal[tid].backend & TERMINAL_VGA) {
+		for (i = 0; i < n; i++) {
+			if (terminal[tid].cursor_x == 0) {
+				if (terminal[tid].cursor_y == 0) {
+					break;
+				}
+				terminal[tid].cursor_x = NUM_COLS;
+				terminal[tid].cursor_y--;
+			}
+			terminal[tid].cursor_x--;
+		}
+		if (tid == cur_terminal) {
+			terminal_flush(tid);
+		}
 	}
+	restore_flags(flags);
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
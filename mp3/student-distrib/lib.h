@@ -13,6 +13,9 @@
 
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c, uint8_t user);
+int32_t putbuf(const uint8_t* buf, int32_t n, uint8_t user);
+int32_t putbuf_terminal(const uint8_t* buf, int32_t n, int32_t tid, uint8_t user);
+void putbuf_back(int32_t tid, int32_t n);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
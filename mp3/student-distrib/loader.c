@@ -0,0 +1,445 @@
+#include "loader.h"
+#include "lib.h"
+#include "page.h"
+#include "filesystem.h"
+#include "system_calls.h"
+
+static program_image_t image_cache[IMAGE_CACHE_SIZE];  // executable images, keyed by inode
+static uint32_t image_clock = 0;                        // access counter used for LRU replacement
+
+/*
+* image_evict
+*   DESCRIPTION: free the least recently used image that no process is using. Called with interrupts disabled.
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 0 if an image was evicted, -1 if every cached image is in use
+*   SIDE EFFECTS: returns the pages of the evicted image to the kernel page pool
+*/
+static int32_t image_evict(void)
+{
+    int32_t i;
+    int32_t victim = -1;
+    for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+    {
+        if (image_cache[i].valid == 1 && image_cache[i].refcount == 0 &&
+            (victim == -1 || image_cache[i].last_used < image_cache[victim].last_used))
+        {
+            victim = i;
+        }
+    }
+    if (victim == -1)
+    {
+        return -1;
+    }
+    kpage_free(image_cache[victim].image, image_cache[victim].num_pages);
+    image_cache[victim].valid = 0;
+    return 0;
+}
+
+/*
+* image_release
+*   DESCRIPTION: give back a cache slot whose image could not be loaded
+*   INPUTS: image -- the slot reserved by image_get
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void image_release(program_image_t* image)
+{
+    image->valid = 0;
+    image->refcount = 0;
+}
+
+/*
+* image_parse
+*   DESCRIPTION: collect the PT_LOAD segments of an image read into memory and check that they
+*                lie inside the file and inside the program region below the stack
+*   INPUTS: image -- the image, holding the whole file
+*           header -- the ELF header of the file
+*   OUTPUTS: none
+*   RETURN VALUE: 0 on success, -1 if the program headers are malformed
+*   SIDE EFFECTS: fills the segments of the image
+*/
+static int32_t image_parse(program_image_t* image, elf32_header_t* header)
+{
+    uint32_t i;
+    uint32_t entry_ok = 0;
+    elf32_phdr_t* phdr;
+    // the program region is 128MB - 132MB, the top USER_STACK_PAGES pages of it hold the stack
+    uint32_t region_end = PROGRAM_VIRT_ADDR + KERNEL_ADDR - USER_STACK_PAGES * PAGE_SIZE;
+
+    if (header->phentsize != ELF_PHDR_SIZE || header->phnum == 0 || header->phoff > image->length ||
+        header->phnum > (image->length - header->phoff) / ELF_PHDR_SIZE)
+    {
+        return -1;
+    }
+    image->num_segments = 0;
+    for (i = 0; i < header->phnum; i++)
+    {
+        phdr = (elf32_phdr_t*)(image->image + header->phoff + i * ELF_PHDR_SIZE);
+        if (phdr->type != PT_LOAD || phdr->memsz == 0)
+        {
+            continue;
+        }
+        // the file bytes must be in the file, and the whole segment in the program region
+        if (image->num_segments == MAX_SEGMENTS || phdr->filesz > phdr->memsz ||
+            phdr->offset > image->length || phdr->filesz > image->length - phdr->offset ||
+            phdr->vaddr < PROGRAM_VIRT_ADDR || phdr->vaddr >= region_end || phdr->memsz > region_end - phdr->vaddr)
+        {
+            return -1;
+        }
+        if (image->entry_point >= phdr->vaddr && image->entry_point < phdr->vaddr + phdr->memsz)
+        {
+            entry_ok = 1;
+        }
+        image->segments[image->num_segments++] = *phdr;
+    }
+    if (image->num_segments == 0 || entry_ok == 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+* image_shared_page
+*   DESCRIPTION: find the page of the pristine copy that can back the program page at vaddr directly.
+*                This is only possible if a single read-only segment covers the page, with only file
+*                bytes (no bss) and with the file offset having the same page offset as the address.
+*   INPUTS: image -- the image
+*           vaddr -- the page-aligned virtual address of the program page
+*   OUTPUTS: none
+*   RETURN VALUE: the address of the page in the kernel page pool, NULL if the page must be private
+*   SIDE EFFECTS: none
+*/
+static uint8_t* image_shared_page(program_image_t* image, uint32_t vaddr)
+{
+    uint32_t i;
+    uint32_t end;
+    elf32_phdr_t* seg;
+    elf32_phdr_t* owner = NULL;
+
+    for (i = 0; i < image->num_segments; i++)
+    {
+        seg = &image->segments[i];
+        if (seg->vaddr >= vaddr + PAGE_SIZE || seg->vaddr + seg->memsz <= vaddr)
+        {
+            continue;
+        }
+        if (owner != NULL || (seg->flags & PF_W) || (seg->vaddr - seg->offset) % PAGE_SIZE != 0)
+        {
+            return NULL;
+        }
+        // the part of the page covered by the segment must come from the file
+        end = (seg->vaddr + seg->memsz < vaddr + PAGE_SIZE) ? seg->vaddr + seg->memsz : vaddr + PAGE_SIZE;
+        if (end > seg->vaddr + seg->filesz)
+        {
+            return NULL;
+        }
+        owner = seg;
+    }
+    if (owner == NULL)
+    {
+        return NULL;
+    }
+    // the file page is inside the pristine copy since the file bytes of the segment are
+    return image->image + ((owner->offset + (vaddr - owner->vaddr)) & ~(PAGE_SIZE - 1));
+}
+
+/*
+* image_page_writable
+*   DESCRIPTION: check whether a writable segment covers part of the program page at vaddr
+*   INPUTS: image -- the image
+*           vaddr -- the page-aligned virtual address of the program page
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if the page must be writable, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+static int32_t image_page_writable(program_image_t* image, uint32_t vaddr)
+{
+    uint32_t i;
+    elf32_phdr_t* seg;
+    for (i = 0; i < image->num_segments; i++)
+    {
+        seg = &image->segments[i];
+        if ((seg->flags & PF_W) && seg->vaddr < vaddr + PAGE_SIZE && seg->vaddr + seg->memsz > vaddr)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* image_get
+*   DESCRIPTION: find the prepared image of an executable, reading and checking the file on a miss
+*   INPUTS: inode -- the index node of the file to execute
+*   OUTPUTS: none
+*   RETURN VALUE: the referenced image, NULL if the file is not an executable or cannot be cached
+*   SIDE EFFECTS: may evict unused images, the caller must call image_put when done
+*/
+program_image_t* image_get(uint32_t inode)
+{
+    uint32_t flags;
+    int32_t i;
+    int32_t length;
+    program_image_t* image = NULL;
+    // in executable file, the ELF header that occupies the first 52 bytes gives information for loading and starting the program
+    elf32_header_t header;
+
+    cli_and_save(flags);
+    for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+    {
+        if (image_cache[i].valid == 1 && image_cache[i].inode == inode)
+        {
+            image_cache[i].refcount++;
+            image_cache[i].last_used = ++image_clock;
+            restore_flags(flags);
+            return &image_cache[i];
+        }
+    }
+    // reserve a free slot, making one if needed
+    for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+    {
+        if (image_cache[i].valid == 0 && image_cache[i].refcount == 0)
+        {
+            break;
+        }
+    }
+    if (i == IMAGE_CACHE_SIZE && image_evict() == 0)
+    {
+        for (i = 0; i < IMAGE_CACHE_SIZE; i++)
+        {
+            if (image_cache[i].valid == 0 && image_cache[i].refcount == 0)
+            {
+                break;
+            }
+        }
+    }
+    if (i == IMAGE_CACHE_SIZE)
+    {
+        restore_flags(flags);
+        return NULL;
+    }
+    image = &image_cache[i];
+    image->inode = inode;
+    image->refcount = 1;
+    restore_flags(flags);
+
+    // read the header of the file (the first 52 bytes), fail if the read fails
+    length = get_length(inode);
+    if (length < ELF_HEADER_SIZE || read_data(inode, 0, (uint8_t*)&header, ELF_HEADER_SIZE) != ELF_HEADER_SIZE)
+    {
+        image_release(image);
+        return NULL;
+    }
+    // check if the file is an executable
+    // The first 4 bytes (0: 0x7f; 1: 0x45; 2: 0x4c; 3: 0x46) of the file represent a "magic number" that identifies the file as an executable.
+    if ((header.ident[0] != 0x7f) || (header.ident[1] != 0x45) || (header.ident[2] != 0x4c) || (header.ident[3] != 0x46))
+    {
+        image_release(image);
+        return NULL;
+    }
+
+    // keep a pristine copy of the whole file in the kernel page pool
+    image->num_pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+    cli_and_save(flags);
+    while ((image->image = kpage_alloc(image->num_pages)) == NULL)
+    {
+        if (image_evict() == -1)
+        {
+            break;
+        }
+    }
+    restore_flags(flags);
+    if (image->image == NULL)
+    {
+        image_release(image);
+        return NULL;
+    }
+    if (read_data(inode, 0, image->image, length) != length)
+    {
+        kpage_free(image->image, image->num_pages);
+        image_release(image);
+        return NULL;
+    }
+    image->length = length;
+    // the entry point of the program (the virtual address of the first instruction that should be executed)
+    image->entry_point = header.entry;
+    if (image_parse(image, &header) == -1)
+    {
+        kpage_free(image->image, image->num_pages);
+        image_release(image);
+        return NULL;
+    }
+
+    cli_and_save(flags);
+    image->last_used = ++image_clock;
+    image->valid = 1;
+    restore_flags(flags);
+    return image;
+}
+
+/*
+* image_put
+*   DESCRIPTION: drop a reference taken by image_get, the image stays cached until evicted
+*   INPUTS: image -- the image
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void image_put(program_image_t* image)
+{
+    uint32_t flags;
+    if (image == NULL)
+    {
+        return;
+    }
+    cli_and_save(flags);
+    if (image->refcount > 0)
+    {
+        image->refcount--;
+    }
+    restore_flags(flags);
+}
+
+/*
+* image_map
+*   DESCRIPTION: build the program page table of process pid from the segments of the image and switch the
+*                program region to it. Pages that only hold read-only file bytes map the pristine copy
+*                read-only, so every instance of a program shares its text. The other pages of the segments
+*                and the stack are private pages of the process, writable only if a writable segment or the
+*                stack covers them, and are zeroed with only the file bytes copied in, so bss is never read.
+*                x86 paging has no execute permission, PF_X is not enforced.
+*                The private pages come from the user page pool one at a time, so a process only holds the
+*                memory its program and stack use.
+*   INPUTS: image -- the image, referenced by the process until it halts
+*           pid -- the new process, the caller already claimed its pid
+*   OUTPUTS: none
+*   RETURN VALUE: 0 on success, -1 if the user page pool ran out (nothing stays mapped)
+*   SIDE EFFECTS: switches the program region to process pid and flushes the TLB
+*/
+int32_t image_map(program_image_t* image, int32_t pid)
+{
+    uint32_t flags;
+    uint32_t i;
+    uint32_t idx;
+    uint32_t vaddr;
+    uint32_t start;
+    uint32_t end;
+    uint32_t page;
+    uint8_t* shared;
+    elf32_phdr_t* seg;
+    page_table_entry_t* table = program_page_table[pid];
+
+    // 1024 - number of entries of a page table
+    for (idx = 0; idx < 1024; idx++)
+    {
+        table[idx].val = 0;
+    }
+    for (i = 0; i < image->num_segments; i++)
+    {
+        seg = &image->segments[i];
+        for (vaddr = seg->vaddr & ~(PAGE_SIZE - 1); vaddr < seg->vaddr + seg->memsz; vaddr += PAGE_SIZE)
+        {
+            idx = (vaddr - PROGRAM_VIRT_ADDR) / PAGE_SIZE;
+            if (table[idx].present == 1 && table[idx].available == 0)
+            {
+                // already mapped to the shared copy by this segment, nothing to decide again
+                continue;
+            }
+            if (table[idx].present == 0 && (shared = image_shared_page(image, vaddr)) != NULL)
+            {
+                set_pte(table, idx, ((uint32_t)shared) >> 12, 1);
+                table[idx].read_write = 0;
+                continue;
+            }
+            if (table[idx].present == 0)
+            {
+                if ((page = upage_alloc()) == 0)
+                {
+                    image_unmap(pid);
+                    return -1;
+                }
+                set_pte(table, idx, page >> 12, 1);
+                table[idx].available = PTE_PRIVATE;
+            }
+        }
+    }
+    // the stack, at the top of the program region
+    for (idx = 1024 - USER_STACK_PAGES; idx < 1024; idx++)
+    {
+        if ((page = upage_alloc()) == 0)
+        {
+            image_unmap(pid);
+            return -1;
+        }
+        set_pte(table, idx, page >> 12, 1);
+        table[idx].available = PTE_PRIVATE;
+    }
+
+    // a process switch would map the program region back to the running process while it is filled
+    cli_and_save(flags);
+    set_program_pde(pid);
+    flush_tlb();
+
+    // fill the private pages through the program region, they are all writable until filled
+    for (idx = 0; idx < 1024 - USER_STACK_PAGES; idx++)
+    {
+        if (table[idx].present == 1 && table[idx].available == PTE_PRIVATE)
+        {
+            memset((uint8_t*)(PROGRAM_VIRT_ADDR + idx * PAGE_SIZE), 0, PAGE_SIZE);
+        }
+    }
+    for (i = 0; i < image->num_segments; i++)
+    {
+        seg = &image->segments[i];
+        for (vaddr = seg->vaddr & ~(PAGE_SIZE - 1); vaddr < seg->vaddr + seg->filesz; vaddr += PAGE_SIZE)
+        {
+            idx = (vaddr - PROGRAM_VIRT_ADDR) / PAGE_SIZE;
+            if (table[idx].available != PTE_PRIVATE)
+            {
+                continue;
+            }
+            start = (seg->vaddr > vaddr) ? seg->vaddr : vaddr;
+            end = (seg->vaddr + seg->filesz < vaddr + PAGE_SIZE) ? seg->vaddr + seg->filesz : vaddr + PAGE_SIZE;
+            memcpy((uint8_t*)start, image->image + seg->offset + (start - seg->vaddr), end - start);
+        }
+    }
+    // private pages of read-only segments (the last page of text shared with bss, for example) become read-only
+    for (idx = 0; idx < 1024 - USER_STACK_PAGES; idx++)
+    {
+        if (table[idx].available == PTE_PRIVATE && image_page_writable(image, PROGRAM_VIRT_ADDR + idx * PAGE_SIZE) == 0)
+        {
+            table[idx].read_write = 0;
+        }
+    }
+    flush_tlb();
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+* image_unmap
+*   DESCRIPTION: return the private pages of process pid to the user page pool and empty its program page
+*                table. The shared pages belong to the image, the aio ring pages are freed by aio_release
+*   INPUTS: pid -- the process, halting or never started
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the program region of pid must not be used by its program again
+*/
+void image_unmap(int32_t pid)
+{
+    uint32_t idx;
+    page_table_entry_t* table = program_page_table[pid];
+
+    // 1024 - number of entries of a page table
+    for (idx = 0; idx < 1024; idx++)
+    {
+        if (table[idx].present == 1 && table[idx].available == PTE_PRIVATE)
+        {
+            upage_free(table[idx].page_base_address << 12);
+        }
+        table[idx].val = 0;
+    }
+}
@@ -0,0 +1,75 @@
+/* loader.h - Defines for the cache of executable images used by execute
+ */
+#ifndef LOADER_H
+#define LOADER_H
+#include "types.h"
+
+#define IMAGE_CACHE_SIZE 8      // number of executable images kept in memory
+#define ELF_HEADER_SIZE 52      // size of the ELF32 file header
+#define ELF_PHDR_SIZE 32        // size of one ELF32 program header
+#define MAX_SEGMENTS 4          // PT_LOAD segments kept per image, user programs have text and data
+#define USER_STACK_PAGES 16     // 64KB of stack mapped below the top of the program region
+
+// program header types and segment permission flags
+#define PT_LOAD 1
+#define PF_X 1
+#define PF_W 2
+#define PF_R 4
+
+// ELF32 file header
+typedef struct elf32_header_t
+{
+    uint8_t ident[16];          // magic number 0x7f 'E' 'L' 'F', class, byte order, version
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;             // virtual address of the first instruction
+    uint32_t phoff;             // file offset of the program header table
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;         // size of one program header
+    uint16_t phnum;             // number of program headers
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_header_t;
+
+// ELF32 program header, describes one segment
+typedef struct elf32_phdr_t
+{
+    uint32_t type;              // PT_LOAD for segments that are mapped
+    uint32_t offset;            // file offset of the segment
+    uint32_t vaddr;             // virtual address of the segment
+    uint32_t paddr;
+    uint32_t filesz;            // bytes of the segment stored in the file
+    uint32_t memsz;             // bytes of the segment in memory, the rest (bss) is zero
+    uint32_t flags;             // PF_X / PF_W / PF_R
+    uint32_t align;
+} __attribute__((packed)) elf32_phdr_t;
+
+// a prepared executable, keyed by its inode
+typedef struct program_image_t
+{
+    uint32_t valid;             // 1 - the image has been read and checked
+    uint32_t inode;             // index node of the executable
+    uint32_t length;            // length of the executable in bytes
+    uint32_t entry_point;       // virtual address of the first instruction
+    uint32_t num_segments;      // number of PT_LOAD segments
+    elf32_phdr_t segments[MAX_SEGMENTS]; // the PT_LOAD segments, checked against the file and the program region
+    uint8_t* image;             // pristine copy of the file in the kernel page pool
+    uint32_t num_pages;         // number of 4KB pages holding the copy
+    uint32_t refcount;          // number of users of the image, only unreferenced images are evicted
+    uint32_t last_used;         // access time used for LRU replacement
+} program_image_t;
+
+// find or load the executable image of inode, NULL if the file is not an executable
+extern program_image_t* image_get(uint32_t inode);
+// release an image returned by image_get
+extern void image_put(program_image_t* image);
+// map the segments of the image and a stack into the program region of process pid, -1 if out of memory
+extern int32_t image_map(program_image_t* image, int32_t pid);
+// free the private pages of process pid
+extern void image_unmap(int32_t pid);
+
+#endif
@@ -10,6 +10,12 @@ page_table_entry_t page_table[1024]__attribute__((aligned(4096)));
 // the page table with 1024 entries, page-aligned addresses being a multiple of 4096 (4KB) 
 // for the video memory in the user space
 page_table_entry_t user_video_page_table[1024]__attribute__((aligned(4096)));
+// one page table per process for the 4MB program region, filled by the loader at execute
+page_table_entry_t program_page_table[MAX_PROGRAMS][1024]__attribute__((aligned(4096)));
+// one bit per page of the kernel page pool, 1: allocated, 32 pages per word
+static uint32_t kpool_bitmap[KPOOL_PAGES / 32];
+// one bit per page of the user page pool, 1: allocated, 32 pages per word
+static uint32_t upool_bitmap[UPOOL_PAGES / 32];
 /* page_init
  *   DESCRIPTION: initialize the page directory table and page table
  *   INPUTS: none
@@ -29,12 +35,15 @@ void page_init()
     // for page directory, set the first entry to be 4kB video memory mapping
     set_pde(page_directory, 0, ((uint32_t) &page_table) >> 12, 0,0,0);
     // for the first page table, set the first entry to be 4kB video memory mapping
-    set_pte(page_table, VIDEO >> 12, VIDEO >> 12,0);
-    set_pte(page_table, (VIDEO >> 12) + 2, (VIDEO >> 12) + 2, 0);                   // 2 - offset of 1st terminal video backup buffer
-    set_pte(page_table, (VIDEO >> 12) + 3, (VIDEO >> 12) + 3, 0);                   // 3 - offset of 2nd terminal video backup buffer
-    set_pte(page_table, (VIDEO >> 12) + 4, (VIDEO >> 12) + 4, 0);                   // 4 - offset of 3rd terminal video backup buffer
+    // all of VGA text memory, each terminal renders into its own page of it
+    for (i = 0; i < VGA_TEXT_PAGES; i++)
+    {
+        set_pte(page_table, (VIDEO >> 12) + i, (VIDEO >> 12) + i, 0);
+    }
     // for pdt, set the second entry to be the 4MB kernel mapping, enable global page and page size
     set_pde(page_directory, 1, KERNEL_ADDR >> 12, 1,1,0);
+    // map the 4MB kernel page pool at the same virtual address, supervisor only
+    set_pde(page_directory, KPOOL_ADDR >> 22, KPOOL_ADDR >> 12, 1,1,0);
     // set the cr0, cr3, cr4 to enable paging and load Page Directory
     set_crs();
 }
@@ -92,7 +101,8 @@ void set_pte(page_table_entry_t* table,uint32_t index, uint32_t address,uint8_t
 }
 
 // put the address of page directory table into cr3
-// set the highest bit of cr0 to be 1, the paging bit.
+// set the highest bit of cr0 to be 1, the paging bit, and bit 16, the write protect bit,
+// so the kernel cannot write through a user pointer into a read-only (shared) program page.
 // set the bit 4 and bit 7 of cr4 to be 1, the page size bit and the enable global page bit.
 /*
 * set_crs
@@ -111,7 +121,7 @@ void set_crs()
         orl   $0x00000090, %%eax;  \
         movl  %%eax, %%cr4;        \
         movl  %%cr0, %%eax;        \
-        orl   $0x80000000, %%eax;  \
+        orl   $0x80010000, %%eax;  \
         movl  %%eax, %%cr0;"
         : /*no output*/
         : "r" (page_directory)
@@ -119,3 +129,175 @@ void set_crs()
     );
 }
 
+/*
+* set_program_pde
+*   DESCRIPTION: map the 4MB program region of the current process to the page table of process pid
+*   INPUTS: pid -- the process id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the caller flushes the TLB
+*/
+void set_program_pde(int32_t pid)
+{
+    set_pde(page_directory, PROGRAM_VIRT_ADDR >> 22, ((uint32_t)program_page_table[pid]) >> 12, 0, 0, 1);
+}
+
+/*
+* kpage_alloc
+*   DESCRIPTION: allocate contiguous pages from the kernel page pool (first fit)
+*   INPUTS: count -- the number of 4KB pages
+*   OUTPUTS: none
+*   RETURN VALUE: the kernel virtual address of the first page, NULL if no run of count free pages exists
+*   SIDE EFFECTS: marks the pages as allocated
+*/
+void* kpage_alloc(uint32_t count)
+{
+    uint32_t flags;
+    uint32_t start;
+    uint32_t run = 0;
+    uint32_t i;
+    if (count == 0 || count > KPOOL_PAGES)
+    {
+        return NULL;
+    }
+    cli_and_save(flags);
+    for (i = 0; i < KPOOL_PAGES; i++)
+    {
+        // 32 - pages per bitmap word
+        if (kpool_bitmap[i / 32] & (1 << (i % 32)))
+        {
+            run = 0;
+            continue;
+        }
+        if (++run == count)
+        {
+            start = i + 1 - count;
+            for (i = start; i < start + count; i++)
+            {
+                kpool_bitmap[i / 32] |= (1 << (i % 32));
+            }
+            restore_flags(flags);
+            return (void*)(KPOOL_ADDR + start * PAGE_SIZE);
+        }
+    }
+    restore_flags(flags);
+    return NULL;
+}
+
+/*
+* kpage_free
+*   DESCRIPTION: return pages allocated by kpage_alloc to the kernel page pool
+*   INPUTS: addr -- the address returned by kpage_alloc
+*           count -- the number of 4KB pages
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: marks the pages as free
+*/
+void kpage_free(void* addr, uint32_t count)
+{
+    uint32_t flags;
+    uint32_t start = ((uint32_t)addr - KPOOL_ADDR) / PAGE_SIZE;
+    uint32_t i;
+    if (addr == NULL || (uint32_t)addr < KPOOL_ADDR || start + count > KPOOL_PAGES)
+    {
+        return;
+    }
+    cli_and_save(flags);
+    for (i = start; i < start + count; i++)
+    {
+        kpool_bitmap[i / 32] &= ~(1 << (i % 32));
+    }
+    restore_flags(flags);
+}
+
+/*
+* upage_alloc
+*   DESCRIPTION: allocate one page from the user page pool for the private pages of a program. The pool is
+*                not mapped in the kernel, the page is filled through the program region
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: the physical address of the page, 0 if every page is allocated
+*   SIDE EFFECTS: marks the page as allocated
+*/
+uint32_t upage_alloc(void)
+{
+    uint32_t flags;
+    uint32_t i;
+    uint32_t bit;
+    cli_and_save(flags);
+    // 32 - pages per bitmap word
+    for (i = 0; i < UPOOL_PAGES / 32; i++)
+    {
+        // 0xFFFFFFFF - all 32 pages of the word are allocated
+        if (upool_bitmap[i] == 0xFFFFFFFF)
+        {
+            continue;
+        }
+        for (bit = 0; upool_bitmap[i] & (1 << bit); bit++);
+        upool_bitmap[i] |= (1 << bit);
+        restore_flags(flags);
+        return UPOOL_ADDR + (i * 32 + bit) * PAGE_SIZE;
+    }
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+* upage_free
+*   DESCRIPTION: return a page allocated by upage_alloc to the user page pool
+*   INPUTS: addr -- the physical address returned by upage_alloc
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: marks the page as free
+*/
+void upage_free(uint32_t addr)
+{
+    uint32_t flags;
+    uint32_t page = (addr - UPOOL_ADDR) / PAGE_SIZE;
+    if (addr < UPOOL_ADDR || page >= UPOOL_PAGES)
+    {
+        return;
+    }
+    cli_and_save(flags);
+    upool_bitmap[page / 32] &= ~(1 << (page % 32));
+    restore_flags(flags);
+}
+
+/*
+* user_range_ok
+*   DESCRIPTION: check a buffer a process passed to a system call before the kernel copies to or from it. The
+*                program region has unmapped holes between the segments, the stack and the aio ring, so every
+*                page of the buffer must be present in the program page table that is mapped now, and
+*                writable if the kernel writes to it (CR0.WP makes read-only pages hold against the kernel)
+*   INPUTS: addr -- the start of the buffer
+*           len -- its length in bytes
+*           write -- 1 if the kernel writes to the buffer
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if the buffer can be used, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+int32_t user_range_ok(const void* addr, uint32_t len, int32_t write)
+{
+    uint32_t start = (uint32_t)addr;
+    uint32_t page;
+    page_table_entry_t* table;
+    page_table_entry_t pte;
+    page_directory_entry_t pde = page_directory[PROGRAM_VIRT_ADDR >> 22];
+
+    // the program region is 4MB (KERNEL_ADDR) from PROGRAM_VIRT_ADDR
+    if (start < PROGRAM_VIRT_ADDR || len > PROGRAM_VIRT_ADDR + KERNEL_ADDR - start || pde.present == 0)
+    {
+        return 0;
+    }
+    // the program page tables are in the kernel page, mapped at their physical address
+    table = (page_table_entry_t*)(pde.page_table_base_address << 12);
+    for (page = start & ~(PAGE_SIZE - 1); page < start + len; page += PAGE_SIZE)
+    {
+        pte = table[(page - PROGRAM_VIRT_ADDR) / PAGE_SIZE];
+        if (pte.present == 0 || pte.user_supervisor == 0 || (write == 1 && pte.read_write == 0))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
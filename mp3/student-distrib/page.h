@@ -4,6 +4,15 @@
 #define PAGE_H
 #include "types.h"
 #define KERNEL_ADDR 4194304 // 4MB in physical memory
+#define KPOOL_ADDR 0x2000000 // 32MB in physical memory, the 4MB kernel page pool after the user page pool
+#define KPOOL_PAGES 1024 // number of 4KB pages in the kernel page pool
+#define PAGE_SIZE 4096 // 4KB page
+#define VGA_TEXT_PAGES 8 // 4KB pages of VGA text memory from VIDEO, terminal i is shown from page i
+#define UPOOL_ADDR 0x800000 // 8MB in physical memory, the pool of the private pages of programs
+#define UPOOL_PAGES ((KPOOL_ADDR - UPOOL_ADDR) / PAGE_SIZE) // number of 4KB pages in the user page pool, up to the kernel page pool
+#define PROGRAM_VIRT_ADDR 0x8000000 // 128MB virtual, the 4MB program region of the current process
+#define MAX_PROGRAMS 6 // one program page table per process
+#define PTE_PRIVATE 1 // available bits of a program PTE: the page belongs to the process (not a shared image page)
 // #define KERNEL_BOTTOM_ADDR 0x800000 // 8MB in physical memory
 // Page Directory Entry
 typedef union page_directory_entry_t{
@@ -48,6 +57,9 @@ extern page_table_entry_t page_table[1024]__attribute__((aligned(4096)));
 // the page table with 1024 entries, page-aligned addresses being a multiple of 4096 (4KB) for the video memory in the user space
 extern page_table_entry_t user_video_page_table[1024]__attribute__((aligned(4096))); 
 
+// one page table per process for the 4MB program region at 128MB, page-aligned
+extern page_table_entry_t program_page_table[MAX_PROGRAMS][1024]__attribute__((aligned(4096)));
+
 // init the page directory and page table
 extern void page_init();
 // set the page directory entry
@@ -56,4 +68,16 @@ extern void set_pde(page_directory_entry_t* directory, uint32_t index,uint32_t a
 extern void set_pte(page_table_entry_t* table, uint32_t index, uint32_t address,uint8_t u_s);
 // set the cr0, cr3, cr4 to enable paging and load Page Directory
 extern void set_crs();
+// map the program region at 128MB to the page table of process pid
+extern void set_program_pde(int32_t pid);
+// allocate count contiguous 4KB pages from the kernel page pool
+extern void* kpage_alloc(uint32_t count);
+// return count contiguous 4KB pages to the kernel page pool
+extern void kpage_free(void* addr, uint32_t count);
+// allocate a 4KB page from the user page pool, its physical address, 0 if the pool is empty
+extern uint32_t upage_alloc(void);
+// return a page allocated by upage_alloc to the user page pool
+extern void upage_free(uint32_t addr);
+// 1 if len bytes at addr are mapped in the program region of the running process (and writable for write)
+extern int32_t user_range_ok(const void* addr, uint32_t len, int32_t write);
 #endif
@@ -0,0 +1,320 @@
+#include "pipe.h"
+#include "lib.h"
+#include "pit.h"
+
+static pipe_t pipes[PIPE_MAX];  // every pipe in the system, a file descriptor keeps the index in its inode
+
+/*
+* pipe_create
+*   DESCRIPTION: allocate an empty pipe
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: the index of the pipe, -1 if every pipe is in use
+*   SIDE EFFECTS: the pipe stays allocated until both ends are closed, or pipe_release if none was opened
+*/
+int32_t pipe_create(void)
+{
+    uint32_t flags;
+    int32_t i;
+    cli_and_save(flags);
+    for (i = 0; i < PIPE_MAX; i++)
+    {
+        if (pipes[i].used == 0)
+        {
+            pipes[i].used = 1;
+            pipes[i].head = 0;
+            pipes[i].count = 0;
+            pipes[i].readers = 0;
+            pipes[i].writers = 0;
+            restore_flags(flags);
+            return i;
+        }
+    }
+    restore_flags(flags);
+    return -1;
+}
+
+/*
+* pipe_release
+*   DESCRIPTION: free a pipe if none of its ends is open, used when setting up a pipeline fails
+*   INPUTS: id -- the pipe
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void pipe_release(int32_t id)
+{
+    uint32_t flags;
+    if (id < 0 || id >= PIPE_MAX)
+    {
+        return;
+    }
+    cli_and_save(flags);
+    if (pipes[id].readers == 0 && pipes[id].writers == 0)
+    {
+        pipes[id].used = 0;
+    }
+    restore_flags(flags);
+}
+
+/*
+* pipe_attach
+*   DESCRIPTION: open one end of a pipe in a file descriptor
+*   INPUTS: file -- the file descriptor to fill
+*           id -- the pipe
+*           end -- PIPE_READ_END or PIPE_WRITE_END
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: counts the new end of the pipe
+*/
+void pipe_attach(file_descriptor* file, int32_t id, int32_t end)
+{
+    uint32_t flags;
+    file->file_operations_table_ptr.open = pipe_open;
+    file->file_operations_table_ptr.close = pipe_close;
+    file->file_operations_table_ptr.readv = NULL;
+    file->file_operations_table_ptr.writev = NULL;
+    file->file_operations_table_ptr.poll = pipe_poll;
+    if (end == PIPE_READ_END)
+    {
+        file->file_operations_table_ptr.read = pipe_read;
+        file->file_operations_table_ptr.write = invalid_write;
+    }
+    else
+    {
+        file->file_operations_table_ptr.read = invalid_read;
+        file->file_operations_table_ptr.write = pipe_write;
+    }
+    // the inode of a pipe end holds the index of the pipe
+    file->inode = id;
+    file->file_position = 0;
+    file->flags = 1;
+
+    cli_and_save(flags);
+    if (end == PIPE_READ_END)
+    {
+        pipes[id].readers++;
+    }
+    else
+    {
+        pipes[id].writers++;
+    }
+    restore_flags(flags);
+}
+
+/*
+* pipe_dup
+*   DESCRIPTION: count one more open end for a file descriptor copied from a pipe end by dup or dup2
+*   INPUTS: file -- the copy
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the pipe stays open until the copy is closed too
+*/
+void pipe_dup(file_descriptor* file)
+{
+    uint32_t flags;
+    cli_and_save(flags);
+    if (file->file_operations_table_ptr.read == pipe_read)
+    {
+        pipes[file->inode].readers++;
+    }
+    else
+    {
+        pipes[file->inode].writers++;
+    }
+    restore_flags(flags);
+}
+
+/*
+* pipe_read
+*   DESCRIPTION: read the bytes available in the pipe, waiting for a writer if it is empty
+*   INPUTS: fd -- file descriptor of a read end
+*           buf -- the buffer to fill
+*           nbytes -- the maximum number of bytes to read
+*   OUTPUTS: none
+*   RETURN VALUE: the number of bytes read, 0 at end of file (empty and no writer left), -1 for failure or when a signal arrives while waiting
+*   SIDE EFFECTS: gives the processor to other processes while the pipe is empty
+*/
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    uint32_t flags;
+    uint32_t i;
+    uint32_t n;
+    pipe_t* pipe;
+    uint8_t* buffer = (uint8_t*)buf;
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || buf == NULL || nbytes < 0)
+    {
+        return -1;
+    }
+    pipe = &pipes[get_cur_pcb_ptr()->file_descriptor_array[fd].inode];
+
+    cli_and_save(flags);
+    while (pipe->count == 0)
+    {
+        if (pipe->writers == 0)
+        {
+            restore_flags(flags);
+            return 0;
+        }
+        restore_flags(flags);
+        // a signal such as ctrl-c ends the wait
+        if (signal_pending())
+        {
+            return -1;
+        }
+        yield();
+        cli_and_save(flags);
+    }
+    n = ((uint32_t)nbytes < pipe->count) ? (uint32_t)nbytes : pipe->count;
+    for (i = 0; i < n; i++)
+    {
+        buffer[i] = pipe->data[(pipe->head + i) % PIPE_SIZE];
+    }
+    pipe->head = (pipe->head + n) % PIPE_SIZE;
+    pipe->count -= n;
+    restore_flags(flags);
+    return n;
+}
+
+/*
+* pipe_poll
+*   DESCRIPTION: report whether a read or write on a pipe end would wait
+*   INPUTS: fd -- the file descriptor of the current process
+*   OUTPUTS: none
+*   RETURN VALUE: POLLIN when the read end has data, POLLOUT when the write end has room,
+*                 POLLHUP when the other end is closed
+*   SIDE EFFECTS: none
+*/
+int32_t pipe_poll(int32_t fd)
+{
+    file_descriptor* file = &get_cur_pcb_ptr()->file_descriptor_array[fd];
+    pipe_t* pipe = &pipes[file->inode];
+    if (file->file_operations_table_ptr.read == pipe_read)
+    {
+        // end of file does not wait either
+        if (pipe->writers == 0)
+        {
+            return POLLIN | POLLHUP;
+        }
+        return (pipe->count > 0) ? POLLIN : 0;
+    }
+    // writes fail at once without readers
+    if (pipe->readers == 0)
+    {
+        return POLLOUT | POLLHUP;
+    }
+    return (pipe->count < PIPE_SIZE) ? POLLOUT : 0;
+}
+
+/*
+* pipe_write
+*   DESCRIPTION: write all bytes into the pipe, waiting for the reader whenever it is full
+*   INPUTS: fd -- file descriptor of a write end
+*           buf -- the bytes to write
+*           nbytes -- the number of bytes to write
+*   OUTPUTS: none
+*   RETURN VALUE: the number of bytes written, -1 if no reader is left or a signal arrives before anything was written
+*   SIDE EFFECTS: gives the processor to other processes while the pipe is full
+*/
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    uint32_t flags;
+    uint32_t written = 0;
+    pipe_t* pipe;
+    const uint8_t* buffer = (const uint8_t*)buf;
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity || buf == NULL || nbytes < 0)
+    {
+        return -1;
+    }
+    pipe = &pipes[get_cur_pcb_ptr()->file_descriptor_array[fd].inode];
+
+    cli_and_save(flags);
+    while (written < (uint32_t)nbytes)
+    {
+        // nobody will ever read the rest
+        if (pipe->readers == 0)
+        {
+            restore_flags(flags);
+            return (written > 0) ? (int32_t)written : -1;
+        }
+        if (pipe->count == PIPE_SIZE)
+        {
+            restore_flags(flags);
+            if (signal_pending())
+            {
+                return (written > 0) ? (int32_t)written : -1;
+            }
+            yield();
+            cli_and_save(flags);
+            continue;
+        }
+        while (written < (uint32_t)nbytes && pipe->count < PIPE_SIZE)
+        {
+            pipe->data[(pipe->head + pipe->count) % PIPE_SIZE] = buffer[written];
+            pipe->count++;
+            written++;
+        }
+    }
+    restore_flags(flags);
+    return written;
+}
+
+/*
+* pipe_open
+*   DESCRIPTION: pipes have no name, their ends are opened by pipe_attach
+*   INPUTS: filename -- ignored
+*   OUTPUTS: none
+*   RETURN VALUE: -1
+*   SIDE EFFECTS: none
+*/
+int32_t pipe_open(const uint8_t* filename)
+{
+    return -1;
+}
+
+/*
+* pipe_detach
+*   DESCRIPTION: close the pipe end held by a file descriptor, the pipe is freed when both sides are closed
+*   INPUTS: file -- the file descriptor, of any process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: a waiting reader sees end of file once the last writer is gone
+*/
+void pipe_detach(file_descriptor* file)
+{
+    uint32_t flags;
+    pipe_t* pipe = &pipes[file->inode];
+
+    cli_and_save(flags);
+    if (file->file_operations_table_ptr.read == pipe_read)
+    {
+        pipe->readers--;
+    }
+    else
+    {
+        pipe->writers--;
+    }
+    if (pipe->readers == 0 && pipe->writers == 0)
+    {
+        pipe->used = 0;
+    }
+    restore_flags(flags);
+}
+
+/*
+* pipe_close
+*   DESCRIPTION: close one end of a pipe
+*   INPUTS: fd -- file descriptor of a pipe end
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 for failure
+*   SIDE EFFECTS: see pipe_detach
+*/
+int32_t pipe_close(int32_t fd)
+{
+    if (fd < 0 || fd >= get_cur_pcb_ptr()->fd_capacity)
+    {
+        return -1;
+    }
+    pipe_detach(&get_cur_pcb_ptr()->file_descriptor_array[fd]);
+    return 0;
+}
@@ -0,0 +1,41 @@
+/* pipe.h - Defines for the pipes that connect the stages of a pipeline
+ */
+#ifndef PIPE_H
+#define PIPE_H
+#include "types.h"
+#include "system_calls.h"
+
+#define PIPE_MAX 8          // number of pipes that can be open at once
+#define PIPE_SIZE 4096      // bytes buffered in one pipe
+#define PIPE_READ_END 0     // file descriptor reads from the pipe
+#define PIPE_WRITE_END 1    // file descriptor writes to the pipe
+
+// a one-way byte stream between processes, held in a ring buffer
+typedef struct pipe_t
+{
+    uint32_t used;              // 1 - the pipe is allocated
+    uint32_t head;              // index of the oldest byte in data
+    uint32_t count;             // number of bytes in data
+    int32_t readers;            // open read ends, the writers see an error when it drops to 0
+    int32_t writers;            // open write ends, the readers see end of file when it drops to 0
+    uint8_t data[PIPE_SIZE];
+} pipe_t;
+
+// allocate a pipe with no ends open, -1 if every pipe is in use
+extern int32_t pipe_create(void);
+// free a pipe whose ends were never opened
+extern void pipe_release(int32_t id);
+// open one end of pipe id in a file descriptor
+extern void pipe_attach(file_descriptor* file, int32_t id, int32_t end);
+// count the copy of a pipe end made by dup
+extern void pipe_dup(file_descriptor* file);
+// close the pipe end held by a file descriptor of any process
+extern void pipe_detach(file_descriptor* file);
+// file operations of the two ends
+extern int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t pipe_open(const uint8_t* filename);
+extern int32_t pipe_close(int32_t fd);
+extern int32_t pipe_poll(int32_t fd);
+
+#endif
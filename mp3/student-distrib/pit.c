@@ -11,6 +11,13 @@
 #include "page.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "assembly_linkage.h"
+#include "timer.h"
+#include "terminal.h"
+#include "keyboard.h"
+
+volatile uint32_t pit_ticks = 0;       // timer interrupts since boot, PIT_HZ per second
+static volatile uint32_t pit_input = 0; // 1 - a tick is decoding input with interrupts on, nothing is scheduled
 
 /*
 * pit_init
@@ -29,7 +36,10 @@ void pit_init()
 
 /*
 * pit_handler
-*   DESCRIPTION: handle pit interrupts
+*   DESCRIPTION: handle pit interrupts, start the shell of terminals that have none and
+*                give the processor to the next process that can run. The typed input is decoded
+*                and echoed with interrupts on, so a burst of keys does not hold off the other
+*                interrupts; a tick that comes in meanwhile only keeps time
 *   INPUTS: none
 *   OUTPUTS: none
 *   RETURN VALUE: none
@@ -38,36 +48,107 @@ void pit_handler(void)
 {
     // 0 - irq number of pit
     send_eoi(0);
+    pit_ticks++;
+    timer_tick(pit_ticks);
+    // output of processes on the terminals in the background
+    terminal_flush_all();
+    if (pit_input == 1) {
+        return;
+    }
+    pit_input = 1;
+    sti();
+    // keys queued by the keyboard interrupt
+    keyboard_drain();
+    // characters typed on the serial console
+    terminal_serial_input();
+    cli();
+    pit_input = 0;
 
     // Next running process id number
     int32_t new_pid;
-    pcb* cur_pcb;
-    
-    // Get current process structure
-    cur_pcb = get_cur_pcb_ptr();
+    int32_t t;
 
-    // Get current running process's base pointer 
-    asm volatile ("movl %%ebp, %0" : "=r"(cur_pcb->run_ebp));
-
-    // Update running terminal id and process id number to next one
-    // 1 - move on to next terminal
-    // 3 - total number of terminal
-    run_terminal =(run_terminal + 1) % 3;
-    new_pid = schedule[(int32_t)run_terminal];
-    
-    // If next process id number is invalid
-    // -1 - next process id number is invalid
-    if (new_pid == -1) {
+    for (t = 0; t < num_terminals; t++) {
         
-        // Switch back to current running terminal
-        memory_switch(run_terminal);
+        // -1 - terminal has no shell yet
+        if (schedule[t] == -1) {
+            new_pid = process_start((uint8_t*)"shell", t);
+            if (new_pid != -1) {
+                schedule[t] = new_pid;
+            }
+        }
+    }
 
-        // Restart shell
-        execute((uint8_t*)"shell");
+    new_pid = next_runnable(get_pid());
+    if (new_pid != -1 && new_pid != get_pid()) {
+        context_switch(new_pid);
     }
+}
+
+/*
+* next_runnable
+*   DESCRIPTION: find the next process after pid, round robin, that can be given the processor
+*   INPUTS: pid - the current process
+*   OUTPUTS: none
+*   RETURN VALUE: the process id, pid itself if no other process can run, -1 if none can
+*/
+int32_t next_runnable(int32_t pid)
+{
+    int32_t i;
+    int32_t next;
+    for (i = 1; i <= PROCESS_MAX; i++) {
+        next = (pid + i) % PROCESS_MAX;
+        if (pid_bitmap[next] == 1 && get_pcb_ptr(next)->state == PROC_RUNNING) {
+            return next;
+        }
+    }
+    return -1;
+}
+
+/*
+* yield
+*   DESCRIPTION: give the processor to the next process that can run, the caller is resumed on a later
+*                turn. Kernel code waiting for another process (a pipe, a child) calls it in its wait loop.
+*                Returns at once while a PIT tick decodes input
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*/
+void yield(void)
+{
+    uint32_t flags;
+    int32_t new_pid;
+
+    // the input is decoded on top of the interrupted process, which must not be switched out under it
+    if (pit_input == 1) {
+        return;
+    }
+    cli_and_save(flags);
+    new_pid = next_runnable(get_pid());
+    if (new_pid != -1 && new_pid != get_pid()) {
+        context_switch(new_pid);
+    }
+    restore_flags(flags);
+}
+
+/*
+* context_switch
+*   DESCRIPTION: switch the paging, terminal and kernel stack to process new_pid. Called with interrupts
+*                disabled, returns when the current process is switched back in.
+*   INPUTS: new_pid - the process to run, either switched out by context_switch or set up by process_start
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*/
+void context_switch(int32_t new_pid)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    pcb* new_pcb = get_pcb_ptr(new_pid);
+
+    // the process writes to its own terminal
+    run_terminal = new_pcb->terminal;
 
-    // set up the 4MB program paging
-    set_pde(page_directory, USER_ADDR >> 22, (KERNEL_BOTTOM_ADDR + new_pid * KERNEL_ADDR) >> 12, 1, 0, 1);
+    // switch the program region to the next process
+    set_program_pde(new_pid);
     
     // flush the TLB
     flush_tlb(); 
@@ -82,14 +163,7 @@ void pit_handler(void)
     // ESP0 gets the value the stack-pointer shall get at a system call
     tss.ss0 = KERNEL_DS;
     // each kernal stack starts at the bottom (larger addr) of an 8KB (0x2000) block inside the kernel
-    tss.esp0 = (uint32_t)get_pcb_ptr(new_pid - 1) - 4; 
+    tss.esp0 = KERNEL_BOTTOM_ADDR - new_pid * 0x2000 - 4;
 
-    // Update running process's base pointer for next running terminal
-    asm volatile(
-        "movl %0, %%ebp \n\
-        leave          \n\
-        ret            \n"
-        :  
-        :  "r" ((get_pcb_ptr(new_pid))->run_ebp) \
-        :  "ebp");
+    switch_stack(&cur_pcb->run_esp, new_pcb->run_esp);
 }
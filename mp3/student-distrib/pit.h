@@ -14,8 +14,17 @@
 
 #define PIT_CMD   0x43          // Command port for pit
 #define PIT_DATA  0x40          // Data port for pit
+#define PIT_HZ    100           // timer interrupts per second
+
+extern volatile uint32_t pit_ticks;
 
 void pit_init(void);
 void pit_handler(void);
+// give the processor to the next process that can run, used while waiting in the kernel
+void yield(void);
+// save the current process and resume process new_pid where it was switched out
+void context_switch(int32_t new_pid);
+// the next process after pid that can run, -1 if none
+int32_t next_runnable(int32_t pid);
 
 #endif /* pit_h */
@@ -2,6 +2,7 @@
 #include "lib.h"
 #include "i8259.h"
 #include "system_calls.h"
+#include "aio.h"
 
 // the default frequency is 1024 Hz
 #define FREQ 1024
@@ -13,9 +14,9 @@ static int32_t rtc_flag = 0;
 volatile uint32_t rtc_counter;
 // virtualization not implemented yet
 
-// 3 - total number of terminal
-int32_t freq[3] = {2, 2, 2};            // 2 - default frequency
-int32_t intr[3] = {0, 0, 0};            // 0 - interrupt not happen yet
+// one virtual rtc per terminal
+int32_t freq[TERMINAL_MAX] = {[0 ... TERMINAL_MAX - 1] = 2};   // 2 - default frequency
+int32_t intr[TERMINAL_MAX];                                     // 0 - interrupt not happen yet
 
 /*
 * rtc_init
@@ -66,10 +67,10 @@ void rtc_handler(void)
     // For checkpoint 1, OS must execute the test interrupts handler when an RTC interrupt occurs.
     // test_interrupts();
 
-    // 3 - total number of terminal
-    for (i = 0; i < 3; i++) {
+    for (i = 0; i < num_terminals; i++) {
         if (rtc_counter % (1024 / freq[i]) == 0) {
             intr[i] = 1;
+            aio_rtc_tick(i);
         }
     }
 
@@ -171,7 +172,12 @@ int32_t RTC_open(const uint8_t * filename)
 int32_t RTC_read(int32_t fd, void * buf, int32_t nbytes)
 {
     rtc_flag = 0;
-    while(intr[run_terminal] == 0) {/* stay here */}
+    while(intr[run_terminal] == 0) {
+        // a signal such as ctrl-c ends the wait
+        if (signal_pending()) {
+            return -1;
+        }
+    }
 	intr[run_terminal] = 0;
     return 0;
 }
@@ -220,3 +226,17 @@ int32_t RTC_close(int32_t fd)
 {
     return 0;
 }
+
+/*
+*  RTC_poll
+*   DESCRIPTION: RTC_poll
+*   INPUTS: 
+*        fd: file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: POLLOUT, with POLLIN if the virtual RTC ticked since the last read
+*   SIDE EFFECTS: none
+*/
+int32_t RTC_poll(int32_t fd)
+{
+    return (intr[run_terminal] == 1) ? (POLLIN | POLLOUT) : POLLOUT;
+}
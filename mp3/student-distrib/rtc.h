@@ -28,10 +28,11 @@ extern int32_t RTC_open(const uint8_t * filename);
 extern int32_t RTC_read(int32_t fd, void * buf, int32_t nbytes);
 extern int32_t RTC_write(int32_t fd, const void * buf, int32_t nbytes);
 extern int32_t RTC_close(int32_t fd);
+extern int32_t RTC_poll(int32_t fd);
 extern void RTC_set_freq(int32_t rate);
 extern int32_t freq_to_rate(int32_t freq);
 
-extern int32_t freq[3];
-extern int32_t intr[3];
+extern int32_t freq[];
+extern int32_t intr[];
 
 #endif
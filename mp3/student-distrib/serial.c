@@ -0,0 +1,189 @@
+#include "serial.h"
+#include "lib.h"
+#include "i8259.h"
+#include "pit.h"
+
+#define SERIAL_TX_MASK (SERIAL_TX_SIZE - 1)
+#define SERIAL_RX_MASK (SERIAL_RX_SIZE - 1)
+// 0xAE - any byte, sent to itself by the probe
+#define SERIAL_PROBE 0xAE
+// 0x200 - interrupt enable flag in EFLAGS
+#define EFLAGS_IF 0x200
+
+static uint32_t serial_found = 0;               // 1 - UART found by serial_init
+static uint8_t tx_ring[SERIAL_TX_SIZE];         // output, sent by the interrupt handler a FIFO at a time
+static uint32_t tx_head = 0;                    // next byte to send, the counters only grow
+static uint32_t tx_tail = 0;                    // next free byte
+static uint8_t rx_ring[SERIAL_RX_SIZE];         // input, filled by the interrupt handler
+static uint32_t rx_head = 0;                    // next byte to take
+static uint32_t rx_tail = 0;                    // next free byte
+
+/*
+* serial_fill_fifo
+*   DESCRIPTION: move queued output into the empty transmit FIFO, and leave the transmit interrupt
+*                enabled only while there is more, called with interrupts off
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void serial_fill_fifo(void)
+{
+    int32_t i;
+
+    if (!(inb(SERIAL_COM1 + SERIAL_REG_LSR) & SERIAL_LSR_THRE)) {
+        return;
+    }
+    for (i = 0; i < SERIAL_FIFO_SIZE && tx_head != tx_tail; i++) {
+        outb(tx_ring[tx_head++ & SERIAL_TX_MASK], SERIAL_COM1 + SERIAL_REG_DATA);
+    }
+    outb((tx_head != tx_tail) ? (SERIAL_IER_RX | SERIAL_IER_TX) : SERIAL_IER_RX, SERIAL_COM1 + SERIAL_REG_IER);
+}
+
+/*
+* serial_queue
+*   DESCRIPTION: put one byte of output into the ring, called with interrupts off. When the ring is
+*                full and the caller had interrupts on, it gives the processor away until serial_handler
+*                has sent some of it. Otherwise (at boot, or inside an interrupt gate) the UART is polled.
+*                Output is slowed down rather than lost
+*   INPUTS: c - the byte
+*           flags - EFLAGS of the caller before it disabled interrupts
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void serial_queue(uint8_t c, uint32_t flags)
+{
+    while (tx_tail - tx_head == SERIAL_TX_SIZE) {
+        serial_fill_fifo();
+        if ((flags & EFLAGS_IF) && tx_tail - tx_head == SERIAL_TX_SIZE) {
+            yield();
+            // nothing else could run, wait here for the transmit interrupt
+            if (tx_tail - tx_head == SERIAL_TX_SIZE) {
+                asm volatile ("sti; hlt; cli");
+            }
+        }
+    }
+    tx_ring[tx_tail++ & SERIAL_TX_MASK] = c;
+}
+
+/*
+* serial_init
+*   DESCRIPTION: check that COM1 has a UART by sending a byte to itself, then set it to 115200 8N1
+*                with its FIFOs on and enable the receive interrupt
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 0 if a UART is present, -1 otherwise
+*   SIDE EFFECTS: enables IRQ4
+*/
+int32_t serial_init(void)
+{
+    // 0 - no interrupts while it is set up
+    outb(0, SERIAL_COM1 + SERIAL_REG_IER);
+    outb(SERIAL_LCR_DLAB, SERIAL_COM1 + SERIAL_REG_LCR);
+    outb(SERIAL_DIVISOR & 0xFF, SERIAL_COM1 + SERIAL_REG_DATA);
+    outb((SERIAL_DIVISOR >> 8) & 0xFF, SERIAL_COM1 + SERIAL_REG_IER);      // 8 - offset
+    outb(SERIAL_LCR_8N1, SERIAL_COM1 + SERIAL_REG_LCR);
+    outb(SERIAL_FCR_ON, SERIAL_COM1 + SERIAL_REG_FCR);
+
+    outb(SERIAL_MCR_LOOP, SERIAL_COM1 + SERIAL_REG_MCR);
+    outb(SERIAL_PROBE, SERIAL_COM1 + SERIAL_REG_DATA);
+    if (inb(SERIAL_COM1 + SERIAL_REG_DATA) != SERIAL_PROBE) {
+        return -1;
+    }
+    outb(SERIAL_MCR_ON, SERIAL_COM1 + SERIAL_REG_MCR);
+    outb(SERIAL_IER_RX, SERIAL_COM1 + SERIAL_REG_IER);
+    serial_found = 1;
+    enable_irq(SERIAL_IRQ);
+    return 0;
+}
+
+/*
+* serial_present
+*   DESCRIPTION: check whether serial_init found a UART
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if present, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+int32_t serial_present(void)
+{
+    return serial_found;
+}
+
+/*
+* serial_handler
+*   DESCRIPTION: COM1 interrupt handler, moves received bytes into the receive ring and refills the
+*                transmit FIFO from the transmit ring. The terminal takes the input on the PIT tick
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: acknowledges the interrupt on the UART and the PIC
+*/
+void serial_handler(void)
+{
+    uint8_t c;
+
+    // reading the interrupt identification register acknowledges a transmit interrupt
+    inb(SERIAL_COM1 + SERIAL_REG_IIR);
+    while (inb(SERIAL_COM1 + SERIAL_REG_LSR) & SERIAL_LSR_DR) {
+        c = inb(SERIAL_COM1 + SERIAL_REG_DATA);
+        // a full ring drops the input, like a keyboard buffer
+        if (rx_tail - rx_head < SERIAL_RX_SIZE) {
+            rx_ring[rx_tail++ & SERIAL_RX_MASK] = c;
+        }
+    }
+    serial_fill_fifo();
+    send_eoi(SERIAL_IRQ);
+}
+
+/*
+* serial_write
+*   DESCRIPTION: queue bytes for the UART and start sending them, the interrupt handler sends the rest.
+*                '\n' is sent as "\r\n" for the terminal on the other end
+*   INPUTS: buf - the bytes
+*           n - number of bytes
+*   OUTPUTS: none
+*   RETURN VALUE: n, 0 if there is no UART
+*   SIDE EFFECTS: waits for the UART when more than SERIAL_TX_SIZE bytes are queued, see serial_queue
+*/
+int32_t serial_write(const uint8_t* buf, int32_t n)
+{
+    uint32_t flags;
+    int32_t i;
+
+    if (serial_found == 0 || buf == NULL || n <= 0) {
+        return 0;
+    }
+    cli_and_save(flags);
+    for (i = 0; i < n; i++) {
+        if (buf[i] == '\n') {
+            serial_queue('\r', flags);
+        }
+        serial_queue(buf[i], flags);
+    }
+    serial_fill_fifo();
+    restore_flags(flags);
+    return n;
+}
+
+/*
+* serial_getc
+*   DESCRIPTION: take the next byte the interrupt handler received
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: the byte, -1 if there is none
+*   SIDE EFFECTS: none
+*/
+int32_t serial_getc(void)
+{
+    uint32_t flags;
+    int32_t c = -1;
+
+    cli_and_save(flags);
+    if (rx_head != rx_tail) {
+        c = rx_ring[rx_head++ & SERIAL_RX_MASK];
+    }
+    restore_flags(flags);
+    return c;
+}
@@ -0,0 +1,48 @@
+/* serial.h - Defines used in interactions with the 16550 UART of COM1
+ */
+#ifndef SERIAL_H
+#define SERIAL_H
+#include "types.h"
+
+// I/O base port of COM1
+#define SERIAL_COM1         0x3F8
+// COM1 is connected to IRQ4
+#define SERIAL_IRQ          4
+
+// register offsets from the I/O base port
+#define SERIAL_REG_DATA     0       // receive / transmit holding register, divisor low byte while DLAB is set
+#define SERIAL_REG_IER      1       // interrupt enable, divisor high byte while DLAB is set
+#define SERIAL_REG_IIR      2       // interrupt identification (read)
+#define SERIAL_REG_FCR      2       // FIFO control (write)
+#define SERIAL_REG_LCR      3       // line control
+#define SERIAL_REG_MCR      4       // modem control
+#define SERIAL_REG_LSR      5       // line status
+
+// bits of the registers
+#define SERIAL_IER_RX       0x01    // interrupt when a byte is received
+#define SERIAL_IER_TX       0x02    // interrupt when the transmit holding register is empty
+#define SERIAL_LCR_DLAB     0x80    // the first two registers hold the baud rate divisor
+#define SERIAL_LCR_8N1      0x03    // 8 data bits, no parity, 1 stop bit
+#define SERIAL_FCR_ON       0xC7    // enable and clear both FIFOs, receive interrupt at 14 bytes
+#define SERIAL_MCR_ON       0x0B    // DTR, RTS and OUT2, which connects the interrupt to the PIC
+#define SERIAL_MCR_LOOP     0x1E    // loopback, for the probe
+#define SERIAL_LSR_DR       0x01    // a received byte is ready
+#define SERIAL_LSR_THRE     0x20    // the transmit holding register (and its FIFO) is empty
+
+#define SERIAL_DIVISOR      1       // 115200 / 1 - 115200 baud
+#define SERIAL_FIFO_SIZE    16      // bytes the transmit FIFO takes once it is empty
+#define SERIAL_TX_SIZE      4096    // bytes of output waiting for the UART, a power of 2
+#define SERIAL_RX_SIZE      256     // bytes received and not yet handed to a terminal, a power of 2
+
+// probe COM1, set it to 115200 8N1 and enable its interrupt, 0 if a UART is present, -1 otherwise
+extern int32_t serial_init(void);
+// 1 if serial_init found a UART
+extern int32_t serial_present(void);
+// COM1 interrupt handler
+extern void serial_handler(void);
+// queue n bytes for the UART, '\n' is sent as "\r\n"
+extern int32_t serial_write(const uint8_t* buf, int32_t n);
+// take the next received byte, -1 if there is none
+extern int32_t serial_getc(void);
+
+#endif
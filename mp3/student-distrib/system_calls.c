@@ -5,11 +5,24 @@
 #include "terminal.h"
 #include "rtc.h"
 #include "filesystem.h"
+#include "loader.h"
+#include "pipe.h"
+#include "fdtable.h"
+#include "aio.h"
+#include "pit.h"
+#include "assembly_linkage.h"
+#include "ldisc.h"
 // 6 is the maximum number of processes
 uint8_t pid_bitmap[6] = {0,0,0,0,0,0};  // the bitmap for process id, 0: available, 1: not available
-int32_t schedule[3] = {-1, -1, -1};     // -1 - terminal not running
+int32_t schedule[TERMINAL_MAX] = {[0 ... TERMINAL_MAX - 1] = -1};  // -1 - terminal not running
 int32_t run_terminal = 0;               // current running terminal id
 
+// timer functions of the sleep and alarm timers every pcb has
+static void sleep_wake(uint32_t pid);
+static void alarm_fire(uint32_t pid);
+// free a process made by process_create that never ran
+static void process_destroy(int32_t pid);
+
 /*
 * halt
 *   DESCRIPTION: halt the current process, returning the specified value to its parent process
@@ -19,12 +32,11 @@ int32_t run_terminal = 0;               // current running terminal id
 */
 int32_t halt(uint8_t status)
 {
-    putc('\n', 0);
-
     int32_t i;
     int32_t ret;
     pcb* pcb_parent;
     pcb* pcb_now;
+    pcb* pcb_child;
 
     // 1 - represents exception
     if (status == 1) {
@@ -42,21 +54,47 @@ int32_t halt(uint8_t status)
     // Get current pcb structure
     pcb_now = get_cur_pcb_ptr();
 
-    // 0 - set the process to be halted as available
-    pid_bitmap[pcb_now->pid] = 0;
+    // the output of a pipeline stage goes to the next program, not the screen
+    if (pcb_now->detached == 0) {
+        putc('\n', 0);
+    }
 
-    // Restart shell by calling execute
-    // 0 / 1 / 2 - currently running shell
-    if (pcb_now->pid == 0 || pcb_now->pid == 1 || pcb_now->pid == 2) { 
-        printf("----------------------------------------------------\n");
-        printf("|               Cannot exit base shell             |\n");
-        printf("----------------------------------------------------\n");
-        execute((uint8_t*)"shell"); 
+    // the process must not be switched out half torn down once its pid can be reused
+    cli();
+
+    if (pcb_now->waitable == 1) {
+        // the parent collects the status with waitpid, which frees the process id
+        pcb_now->exit_status = ret;
+        pcb_now->state = PROC_ZOMBIE;
+    } else {
+        // 0 - set the process to be halted as available
+        pid_bitmap[pcb_now->pid] = 0;
+    }
+    // nobody will wait for the children started by spawn any more
+    for (i = 0; i < PROCESS_MAX; i++) {
+        pcb_child = get_pcb_ptr(i);
+        if (pid_bitmap[i] == 1 && pcb_child->waitable == 1 && pcb_child->parent_pid == pcb_now->pid) {
+            pcb_child->waitable = 0;
+            if (pcb_child->state == PROC_ZOMBIE) {
+                pid_bitmap[i] = 0;
+            }
+        }
     }
+    // the program region no longer uses the image
+    image_put(pcb_now->image);
+    pcb_now->image = NULL;
+    // pending asynchronous operations complete into a ring that is gone
+    aio_release(pcb_now->pid);
+    // the private pages of the program go back to the pool, nothing runs in its program region again
+    image_unmap(pcb_now->pid);
+    // a program that read single keys gives the terminal back to its shell in cooked mode
+    ldisc_halt(pcb_now->terminal, pcb_now->pid);
+    // the timers are inside the pcb
+    timer_del(&pcb_now->sleep_timer);
+    timer_del(&pcb_now->alarm_timer);
 
     // Close all file descriptors
-    // 8 - maximum value of open files
-    for (i = 0; i < 8; i++) 
+    for (i = 0; i < pcb_now->fd_capacity; i++) 
     {
         if (pcb_now->file_descriptor_array[i].flags == 1) 
         {
@@ -66,9 +104,28 @@ int32_t halt(uint8_t status)
             pcb_now->file_descriptor_array[i].file_operations_table_ptr.close(i);
         }
     }
+    fd_table_release(pcb_now);
+
+    // Restart shell by calling execute
+    // the base shells are started first, one per terminal
+    if (pcb_now->pid < num_terminals) { 
+        printf("----------------------------------------------------\n");
+        printf("|               Cannot exit base shell             |\n");
+        printf("----------------------------------------------------\n");
+        execute((uint8_t*)"shell"); 
+    }
+
+    // nobody waits in execute for a pipeline stage or a spawned program, give the processor to the next
+    // process for good.
+    if (pcb_now->detached == 1) {
+        // every other process may be asleep or waiting on one, wait here for an interrupt to wake one
+        while ((i = next_runnable(pcb_now->pid)) == -1) {
+            asm volatile ("sti; hlt; cli");
+        }
+        context_switch(i);
+    }
 
-    // 3 - total number of terminal
-    for (i = 0; i < 3; i++) {
+    for (i = 0; i < num_terminals; i++) {
 
         // Go back to parent process
         if (schedule[i] == pcb_now->pid) {
@@ -78,10 +135,11 @@ int32_t halt(uint8_t status)
 
     // Return to parent task
     pcb_parent = get_pcb_ptr(pcb_now->parent_pid);
+    pcb_parent->state = PROC_RUNNING;
     i = pcb_now->parent_pid;
 
-    // set up the 4MB program paging
-    set_pde(page_directory, USER_ADDR >> 22, (KERNEL_BOTTOM_ADDR + i * KERNEL_ADDR) >> 12, 1, 0, 1);
+    // switch the program region back to the parent
+    set_program_pde(i);
     
     // flush the TLB
     flush_tlb(); 
@@ -109,15 +167,105 @@ int32_t halt(uint8_t status)
 }
 
 /*
-* execute
-*   DESCRIPTION: execute a new program, handing off the processor to the new program until it terminates
-*   INPUTS: command -- the command to be executed
+* restore_program_region
+*   DESCRIPTION: map the program region back to the current process after setting up another one
+*   INPUTS: none
 *   OUTPUTS: none
-*   RETURN VALUE: -1 on failure, for example, the command cannot be executed,the program does not exist or the filename specified is not an executable
-*                 256 if the program dies by an exception
-*                 a value in the range 0 to 255 if the program executes a halt system call, in which case the value returned is that given by the program’s call to halt
+*   RETURN VALUE: none
+*   SIDE EFFECTS: flushes the TLB, does nothing before the first process runs
 */
-int32_t execute(const uint8_t* command)
+static void restore_program_region(void)
+{
+    int32_t pid = get_pid();
+    if (pid >= 0 && pid < PROCESS_MAX && pid_bitmap[pid] == 1)
+    {
+        set_program_pde(pid);
+        flush_tlb();
+    }
+}
+
+/*
+* process_stack_setup
+*   DESCRIPTION: put the strings of argv and envp at the top of the user stack of a new process, then the
+*                NULL terminated argv and envp arrays and, where main finds its arguments after the call
+*                from _start, argc, argv and envp
+*   INPUTS: pid -- the new process, its program region is already set up
+*           name -- the program name, argv[0]
+*           args -- the arguments separated by single spaces
+*           env -- the environment strings, each null-terminated, ended by an empty string
+*   OUTPUTS: none
+*   RETURN VALUE: the user stack pointer to start the process with, pointing at argc
+*   SIDE EFFECTS: the program region is mapped to the new process
+*/
+static uint32_t process_stack_setup(int32_t pid, const uint8_t* name, const uint8_t* args, const uint8_t* env)
+{
+    // the program name, then at most one argument per 2 characters of the 128 byte command line and one
+    // environment string per 2 bytes of the environment
+    uint32_t strings[1 + 128 / 2 + ENV_SIZE / 2];
+    int32_t argc = 0;
+    int32_t envc = 0;
+    int32_t len;
+    int32_t i;
+    uint32_t sp = USER_STACK_ADDR;
+    uint32_t* words;
+    uint32_t flags;
+
+    // a process switch would map the program region back to the running process
+    cli_and_save(flags);
+    set_program_pde(pid);
+    flush_tlb();
+
+    len = strlen((int8_t*)name);
+    sp -= len + 1;
+    memcpy((void*)sp, name, len + 1);
+    strings[argc++] = sp;
+    while (*args != '\0') {
+        for (len = 0; args[len] != '\0' && args[len] != ' '; len++) {
+            // find the end of the argument
+        }
+        sp -= len + 1;
+        memcpy((void*)sp, args, len);
+        ((uint8_t*)sp)[len] = '\0';
+        strings[argc++] = sp;
+        args += (args[len] == ' ') ? len + 1 : len;
+    }
+    for (; *env != '\0'; env += len + 1) {
+        len = strlen((int8_t*)env);
+        sp -= len + 1;
+        memcpy((void*)sp, env, len + 1);
+        strings[argc + envc++] = sp;
+    }
+
+    // 3 - argc, argv and envp, 2 - the NULLs ending the arrays
+    words = (uint32_t*)(sp & ~3) - (argc + envc + 2) - 3;
+    words[0] = argc;
+    words[1] = (uint32_t)&words[3];
+    words[2] = (uint32_t)&words[3 + argc + 1];
+    for (i = 0; i < argc; i++) {
+        words[3 + i] = strings[i];
+    }
+    words[3 + argc] = 0;
+    for (i = 0; i < envc; i++) {
+        words[4 + argc + i] = strings[argc + i];
+    }
+    words[4 + argc + envc] = 0;
+    restore_flags(flags);
+    return (uint32_t)words;
+}
+
+/*
+* process_create
+*   DESCRIPTION: load a program into a new process that is not running yet
+*   INPUTS: command -- the program name followed by its arguments
+*           term -- the terminal of the new process
+*           in_pipe -- pipe for the standard input, -1 for the keyboard
+*           out_pipe -- pipe for the standard output, -1 for the screen
+*   OUTPUTS: none
+*   RETURN VALUE: the process id, -1 if the program does not exist, is not an executable, or no process id or
+*                 memory is available
+*   SIDE EFFECTS: the program region is mapped to the new process, the process is in state PROC_WAITING
+*/
+static int32_t process_create(const uint8_t* command, int32_t term, int32_t in_pipe, int32_t out_pipe)
 {
     int i;
     int j;
@@ -126,11 +274,10 @@ int32_t execute(const uint8_t* command)
     uint8_t args[128]; // the command line arguments, 128 is the maximum length
     uint8_t filename[32]; // the maximum length of a filename is 32
     uint8_t filename_length = 0; // the length of the filename
+    uint32_t flags;
     dentry_t dentry;
     pcb* pcb_ptr;
-    uint32_t entry_point;
-    // in executable file, a header that occupies the first 40 bytes gives information for loading and starting the program
-    uint8_t buf_header[40];
+    program_image_t* image;
     if (command == NULL)
     {
         return -1;
@@ -169,13 +316,20 @@ int32_t execute(const uint8_t* command)
     {
         args[0] = '\0';
     }
-    // copy the arguments
+    // copy every argument, separated by single spaces
     j = 0;
-    while (i < strlen((int8_t*)command) && command[i] != '\0' && command[i] != ' ')
+    for (; i < strlen((int8_t*)command) && command[i] != '\0'; i++)
     {
+        if (command[i] == ' ' && (j == 0 || args[j - 1] == ' '))
+        {
+            continue;
+        }
         args[j] = command[i];
-        i++;
-        j++; 
+        j++;
+    }
+    if (j > 0 && args[j - 1] == ' ')
+    {
+        j--;
     }
     // null-terminate the argument
     args[j] = '\0';    
@@ -184,64 +338,64 @@ int32_t execute(const uint8_t* command)
     {
         return -1;
     }
-    // read the header of the file (the first 40 bytes), return -1 if the read fails
-    if (read_data(dentry.inode_num, 0, buf_header, 40) != 40)
-    {
-        return -1;
-    }
-    // check if the file is an executable
-    // The first 4 bytes (0: 0x7f; 1: 0x45; 2: 0x4c; 3: 0x46) of the file represent a “magic number” that identifies the file as an executable.
-    if ((buf_header[0] != 0x7f) || (buf_header[1] != 0x45) || (buf_header[2] != 0x4c) || (buf_header[3] != 0x46))
+    // get the prepared image of the file, return -1 if the file is not an executable
+    image = image_get(dentry.inode_num);
+    if (image == NULL)
     {
         return -1;
     }
-    // find an available process id
+    // find an available process id, the scheduler must not see it before it is marked as not started
     // 6 is the maximum number of processes
+    cli_and_save(flags);
     for (i = 0; i < 6; i++)
     {
         if (pid_bitmap[i] == 0)
         {
+            get_pcb_ptr(i)->state = PROC_WAITING;
             pid_bitmap[i] = 1;
             new_pid = i;
             break;
         }
     }
+    restore_flags(flags);
     // if no available process id, return -1
     if (i == 6)
     {
         printf("----------------------------------------------------\n");
         printf("|            Maximum process number reached        |\n");
         printf("----------------------------------------------------\n");
+        image_put(image);
         return -1;
     }
-    
-    pid_bitmap[i] = 1;           
-    new_pid = i;
+
     pcb_ptr = get_pcb_ptr(new_pid);
     pcb_ptr->pid = new_pid;
 
     // set the parent pid of the new process if there is a parent process
-    if (new_pid == 0 || new_pid == 1 || new_pid == 2) {
+    if (new_pid < num_terminals) {
         pcb_ptr->parent_pid = 255;
     } else {
         pcb_ptr->parent_pid = get_pid();
     }
 
-    // 3 - total number of terminal
-    for (i = 0; i < 3; i++) {
-        if (schedule[i] == -1 || schedule[i] == pcb_ptr->parent_pid){
-            schedule[i] = pcb_ptr->pid;
-            break;
-        }
-    }
+    pcb_ptr->terminal = term;
+    pcb_ptr->detached = 0;
+    pcb_ptr->waitable = 0;
 
     // copy the arguments to the pcb
     memcpy(pcb_ptr->args, args, 128);
+    // 0, 1 - the lowest descriptors of the empty table
+    fd_table_init(pcb_ptr);
+    fd_alloc(pcb_ptr);
+    fd_alloc(pcb_ptr);
     // When a process is started, automatically open stdin and stdout, which correspond to file descriptors 0 and 1 respectively.
     pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.read = terminal_read;
     pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.open = invalid_open;
     pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.close = invalid_close;
     pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.write = invalid_write;
+    pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.readv = NULL;
+    pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.writev = NULL;
+    pcb_ptr->file_descriptor_array[0].file_operations_table_ptr.poll = terminal_poll;
 
     pcb_ptr->file_descriptor_array[0].inode = 0;
     pcb_ptr->file_descriptor_array[0].file_position = 0;
@@ -251,11 +405,22 @@ int32_t execute(const uint8_t* command)
     pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.open = invalid_open;
     pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.close = invalid_close;
     pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.write = terminal_write;
+    pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.readv = NULL;
+    pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.writev = terminal_writev;
+    pcb_ptr->file_descriptor_array[1].file_operations_table_ptr.poll = terminal_poll;
 
     pcb_ptr->file_descriptor_array[1].inode = 0;
     pcb_ptr->file_descriptor_array[1].file_position = 0;
     pcb_ptr->file_descriptor_array[1].flags = 1;
 
+    // the stages of a pipeline read from and write to pipes instead
+    if (in_pipe != -1) {
+        pipe_attach(&pcb_ptr->file_descriptor_array[0], in_pipe, PIPE_READ_END);
+    }
+    if (out_pipe != -1) {
+        pipe_attach(&pcb_ptr->file_descriptor_array[1], out_pipe, PIPE_WRITE_END);
+    }
+
     // 5 - total signal number
     for (signal = 0; signal < 5; signal++) {
         
@@ -269,17 +434,262 @@ int32_t execute(const uint8_t* command)
         }
         
         // 0 for mask - unmask all signals
-        // 0 for flage - signal not raised currently
         pcb_ptr->signals[signal].mask = 0;
-        pcb_ptr->signals[signal].flag = 0;
+    }
+    // no signal raised currently
+    pcb_ptr->sig_pending = 0;
+    timer_init(&pcb_ptr->sleep_timer, sleep_wake, new_pid);
+    timer_init(&pcb_ptr->alarm_timer, alarm_fire, new_pid);
+
+    // a program inherits the environment of the one that starts it, the base shells get the default one
+    if (pcb_ptr->parent_pid == 255) {
+        memcpy(pcb_ptr->env, ENV_DEFAULT, sizeof(ENV_DEFAULT));
+    } else {
+        memcpy(pcb_ptr->env, get_cur_pcb_ptr()->env, ENV_SIZE);
     }
 
-	// set up the 4MB program paging
-    set_pde(page_directory,USER_ADDR >> 22,(KERNEL_BOTTOM_ADDR+new_pid*KERNEL_ADDR) >> 12,1,0,1);
-    // flush the TLB
+    // map the segments of the program and its stack, the process keeps the image until it halts
+    pcb_ptr->image = image;
+    if (image_map(image, new_pid) == -1)
+    {
+        process_destroy(new_pid);
+        return -1;
+    }
+    pcb_ptr->user_esp = process_stack_setup(new_pid, filename, args, pcb_ptr->env);
+    return new_pid;
+}
+
+/*
+* process_destroy
+*   DESCRIPTION: free a process made by process_create that never ran
+*   INPUTS: pid -- the process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: closes its pipe ends and releases its pages, image and process id
+*/
+static void process_destroy(int32_t pid)
+{
+    int32_t i;
+    pcb* pcb_ptr = get_pcb_ptr(pid);
+    for (i = 0; i < pcb_ptr->fd_capacity; i++) {
+        if (pcb_ptr->file_descriptor_array[i].flags == 1 && pcb_ptr->file_descriptor_array[i].file_operations_table_ptr.close == pipe_close) {
+            pipe_detach(&pcb_ptr->file_descriptor_array[i]);
+        }
+        pcb_ptr->file_descriptor_array[i].flags = 0;
+    }
+    fd_table_release(pcb_ptr);
+    image_unmap(pid);
+    image_put(pcb_ptr->image);
+    pcb_ptr->image = NULL;
+    pid_bitmap[pid] = 0;
+}
+
+/*
+* process_launch
+*   DESCRIPTION: let the scheduler run a process made by process_create without anyone waiting for it.
+*                Its kernel stack is given the frame switch_stack expects, returning to process_start_linkage
+*                which irets to the entry point of the program.
+*   INPUTS: pid -- the process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the process becomes PROC_RUNNING
+*/
+static void process_launch(int32_t pid)
+{
+    pcb* pcb_ptr = get_pcb_ptr(pid);
+    // each kernal stack starts at the bottom (larger addr) of an 8KB (0x2000) block inside the kernel
+    uint32_t* sp = (uint32_t*)(KERNEL_BOTTOM_ADDR - pid * 0x2000 - 4);
+
+    // the iret context, as execute pushes it: User DS (as SS), ESP, EFLAG, CS, EIP
+    *(--sp) = USER_DS;
+    *(--sp) = pcb_ptr->user_esp;
+    // 0x202 - interrupts enabled, bit 1 is always set
+    *(--sp) = 0x202;
+    *(--sp) = USER_CS;
+    *(--sp) = pcb_ptr->image->entry_point;
+    // the frame of switch_stack: return address, ebp, ebx, esi, edi
+    *(--sp) = (uint32_t)process_start_linkage;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    pcb_ptr->run_esp = (uint32_t)sp;
+    pcb_ptr->detached = 1;
+    pcb_ptr->state = PROC_RUNNING;
+}
+
+/*
+* process_start
+*   DESCRIPTION: start a program that runs next to the current process, nobody waits for it
+*   INPUTS: command -- the program name followed by its arguments
+*           term -- the terminal of the new process
+*   OUTPUTS: none
+*   RETURN VALUE: the process id, -1 on failure
+*   SIDE EFFECTS: the process runs on the next turn the scheduler gives it
+*/
+int32_t process_start(const uint8_t* command, int32_t term)
+{
+    int32_t pid = process_create(command, term, -1, -1);
+    if (pid != -1)
+    {
+        process_launch(pid);
+    }
+    restore_program_region();
+    return pid;
+}
+
+/*
+* pipeline_split
+*   DESCRIPTION: split a command at '|' into the commands of a pipeline
+*   INPUTS: command -- the command line
+*           stages -- filled with one null-terminated command per program
+*   OUTPUTS: none
+*   RETURN VALUE: the number of programs, -1 if a program is missing or there are too many
+*   SIDE EFFECTS: none
+*/
+static int32_t pipeline_split(const uint8_t* command, uint8_t stages[PIPELINE_MAX][128])
+{
+    int32_t n = 0;
+    int32_t len = 0;
+    int32_t blank = 1;
+    for (;; command++)
+    {
+        if (*command == '|' || *command == '\0')
+        {
+            // every program of the pipeline needs a name
+            if (blank == 1)
+            {
+                return -1;
+            }
+            stages[n][len] = '\0';
+            n++;
+            if (*command == '\0')
+            {
+                return n;
+            }
+            if (n == PIPELINE_MAX)
+            {
+                return -1;
+            }
+            len = 0;
+            blank = 1;
+            continue;
+        }
+        // 127 - room for the terminating null
+        if (len == 127)
+        {
+            return -1;
+        }
+        if (*command != ' ')
+        {
+            blank = 0;
+        }
+        stages[n][len++] = *command;
+    }
+}
+
+/*
+* pipeline_create
+*   DESCRIPTION: create the programs of a command, joined by pipes for "a | b | c". Nothing is left behind
+*                if one of them cannot be created
+*   INPUTS: command -- the command line
+*           pids -- filled with the process id of each program, in pipeline order
+*   OUTPUTS: none
+*   RETURN VALUE: the number of programs, -1 on failure
+*   SIDE EFFECTS: the program region is mapped to the last program on success, to the current process on failure
+*/
+static int32_t pipeline_create(const uint8_t* command, int32_t pids[PIPELINE_MAX])
+{
+    int32_t i;
+    int32_t n;
+    int32_t in_pipe = -1;
+    int32_t out_pipe = -1;
+    uint8_t stages[PIPELINE_MAX][128]; // 128 is the maximum length of a command
+    if (command == NULL)
+    {
+        return -1;
+    }
+    n = pipeline_split(command, stages);
+    if (n == -1)
+    {
+        return -1;
+    }
+    // create every program first, so that nothing runs if one of them cannot be started
+    for (i = 0; i < n; i++)
+    {
+        out_pipe = -1;
+        if (i < n - 1 && (out_pipe = pipe_create()) == -1)
+        {
+            break;
+        }
+        pids[i] = process_create(stages[i], run_terminal, in_pipe, out_pipe);
+        if (pids[i] == -1)
+        {
+            break;
+        }
+        in_pipe = out_pipe;
+    }
+    if (i < n)
+    {
+        pipe_release(in_pipe);
+        pipe_release(out_pipe);
+        while (--i >= 0)
+        {
+            process_destroy(pids[i]);
+        }
+        restore_program_region();
+        return -1;
+    }
+    return n;
+}
+
+/*
+* execute
+*   DESCRIPTION: execute a new program, handing off the processor to the new program until it terminates.
+*                For "a | b | c" the programs are started together with pipes between them, the earlier
+*                ones run detached and execute waits for the last one.
+*   INPUTS: command -- the command to be executed
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, for example, the command cannot be executed,the program does not exist or the filename specified is not an executable
+*                 256 if the program dies by an exception
+*                 a value in the range 0 to 255 if the program executes a halt system call, in which case the value returned is that given by the program’s call to halt
+*/
+int32_t execute(const uint8_t* command)
+{
+    int32_t i;
+    int32_t n;
+    int32_t new_pid;
+    int32_t pids[PIPELINE_MAX];
+    pcb* pcb_ptr;
+    uint32_t entry_point;
+    uint32_t user_esp;
+    n = pipeline_create(command, pids);
+    if (n == -1)
+    {
+        return -1;
+    }
+    for (i = 0; i < n - 1; i++)
+    {
+        process_launch(pids[i]);
+    }
+    // the last program was created last, the program region is already mapped to it
+    new_pid = pids[n - 1];
+    pcb_ptr = get_pcb_ptr(new_pid);
+    entry_point = pcb_ptr->image->entry_point;
+    user_esp = pcb_ptr->user_esp;
+
+    // from here on a switch would park the parent's stack as if the child were not started
+    cli();
+    // a switch before cli may have mapped the program region back to the parent
+    set_program_pde(new_pid);
     flush_tlb();
-    // load the program into memory
-    read_data(dentry.inode_num, 0, (uint8_t*)USER_IMAGE, USER_STACK_ADDR - USER_IMAGE);
+    pcb_ptr->state = PROC_RUNNING;
+    schedule[pcb_ptr->terminal] = new_pid;
+    // the parent waits in execute until the child halts
+    if (pcb_ptr->parent_pid != 255)
+    {
+        get_pcb_ptr(pcb_ptr->parent_pid)->state = PROC_WAITING;
+    }
 
     // context switch
     // For each CPU which executes processes possibly wanting to do system calls via interrupts, one TSS is required.
@@ -289,16 +699,13 @@ int32_t execute(const uint8_t* command)
     tss.ss0 = KERNEL_DS;
     // each kernal stack starts at the bottom (larger addr) of an 8KB (0x2000) block inside the kernel
     tss.esp0 = KERNEL_BOTTOM_ADDR - (new_pid) * 0x2000 - 4;
-    // the entry point of the program (the virtual address of the first instruction that should be executed) is the 24th to 27th bytes of the header
-    entry_point = buf_header[27] << 24 | buf_header[26] << 16 | buf_header[25] << 8 | buf_header[24];
     // store the esp and ebp
     asm volatile ("movl %%ebp, %0" : "=r"(pcb_ptr->ebp));
     asm volatile ("movl %%esp, %0" : "=r"(pcb_ptr->esp));
 
-    sti();
     // push the iret context onto the stack
     // IRET needs 5 elements on stack: User DS,ESP,EFLAG,CS,EIP
-    // The ESP is the user stack pointer to the bottom of the 4 MB page already holding the executable image - 4 
+    // The ESP points at argc, below the arguments and environment process_stack_setup put at the top of the stack
     // The DS is the user data segment, which is 0x2B
     // The CS is the user code segment, which is 0x23
     // The EIP need to jump to is the entry point from bytes 24-27 of the executable that you have just loaded
@@ -306,16 +713,105 @@ int32_t execute(const uint8_t* command)
         "pushl %0;"
         "pushl %1;"
         "pushfl;"
+        "orl $0x200, (%%esp);"      // 0x200 - interrupts are enabled again by iret
         "pushl %2;"
         "pushl %3;"
         "iret;"
         :
-        : "r"(USER_DS), "r"(USER_STACK_ADDR - 4), "r"(USER_CS),"r"(entry_point)
+        : "r"(USER_DS), "r"(user_esp), "r"(USER_CS),"r"(entry_point)
         : "memory", "cc"
     );
     return 0;
 }
 
+/*
+* spawn
+*   DESCRIPTION: start a command like execute but return right away, the programs run next to the caller.
+*                The last program of a pipeline stays a zombie when it halts until the caller collects
+*                its status with waitpid
+*   INPUTS: command -- the command to be started
+*   OUTPUTS: none
+*   RETURN VALUE: the process id of the last program, -1 on failure
+*   SIDE EFFECTS: the programs run on the next turns the scheduler gives them
+*/
+int32_t spawn(const uint8_t* command)
+{
+    int32_t i;
+    int32_t n;
+    int32_t pids[PIPELINE_MAX];
+
+    n = pipeline_create(command, pids);
+    if (n == -1)
+    {
+        return -1;
+    }
+    get_pcb_ptr(pids[n - 1])->waitable = 1;
+    for (i = 0; i < n; i++)
+    {
+        process_launch(pids[i]);
+    }
+    restore_program_region();
+    return pids[n - 1];
+}
+
+/*
+* waitpid
+*   DESCRIPTION: wait for a program started by spawn to halt and free its process id
+*   INPUTS: pid -- the child to wait for, -1 for any child
+*           status -- where to store the value execute would have returned for it, may be NULL
+*           options -- WNOHANG to return 0 instead of waiting when no child has halted yet
+*   OUTPUTS: the status in *status
+*   RETURN VALUE: the process id of the child, 0 with WNOHANG if none has halted, -1 if there is no such
+*                 child or a signal arrives while waiting
+*   SIDE EFFECTS: gives the processor to other processes while waiting
+*/
+int32_t waitpid(int32_t pid, int32_t* status, int32_t options)
+{
+    int32_t me = get_pid();
+    int32_t found;
+    int32_t i;
+    uint32_t flags;
+    pcb* child;
+
+    if (pid < -1 || pid >= PROCESS_MAX || (options & ~WNOHANG) != 0 ||
+        (status != NULL && !user_range_ok(status, sizeof(int32_t), 1))) {
+        return -1;
+    }
+    while (1) {
+        found = 0;
+        cli_and_save(flags);
+        for (i = 0; i < PROCESS_MAX; i++) {
+            child = get_pcb_ptr(i);
+            if (pid_bitmap[i] == 0 || child->waitable == 0 || child->parent_pid != me || (pid != -1 && pid != i)) {
+                continue;
+            }
+            found = 1;
+            if (child->state == PROC_ZOMBIE) {
+                // reap it, the process id can be used again
+                child->waitable = 0;
+                pid_bitmap[i] = 0;
+                restore_flags(flags);
+                if (status != NULL) {
+                    *status = child->exit_status;
+                }
+                return i;
+            }
+        }
+        restore_flags(flags);
+        if (found == 0) {
+            return -1;
+        }
+        if (options & WNOHANG) {
+            return 0;
+        }
+        // a signal such as ctrl-c ends the wait
+        if (signal_pending()) {
+            return -1;
+        }
+        yield();
+    }
+}
+
 /*
 * read
 *   DESCRIPTION: read data from the keyboard, a file, device (RTC), or directory
@@ -333,12 +829,17 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes)
     int32_t ret = 0;
     
     // Validate arguments
-    // fd - index to file_descriptor_array of size 8
+    // fd - index to file_descriptor_array of size fd_capacity
     // nbytes - byte to be read, invalid if less than / equals 0
-    if (fd < 0 || fd >= 8 || buf == NULL || nbytes <= 0) {
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || buf == NULL || nbytes <= 0) {
         return -1;          // return -1 for failure
     }
 
+    // the whole buffer has to be mapped and writable, the program region has holes
+    if (!user_range_ok(buf, nbytes, 1)) {
+        return -1;
+    }
+
     // If the file hasn't been open
     if (cur_pcb->file_descriptor_array[fd].flags == 0) {
         return -1;
@@ -373,12 +874,17 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes)
     int32_t ret = 0;
     
     // Validate arguments
-    // fd - index to file_descriptor_array of size 8
+    // fd - index to file_descriptor_array of size fd_capacity
     // nbytes - byte to be read, invalid if less than / equals 0
-    if (fd < 0 || fd >= 8 || buf == NULL || nbytes <= 0) {
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || buf == NULL || nbytes <= 0) {
         return -1;          // return -1 for failure
     }
 
+    // the whole buffer has to be mapped, the program region has holes
+    if (!user_range_ok(buf, nbytes, 0)) {
+        return -1;
+    }
+
     // If the file hasn't been open
     if (cur_pcb->file_descriptor_array[fd].flags == 0) {
         return -1;
@@ -394,6 +900,360 @@ int32_t write(int32_t fd, const void* buf, int32_t nbytes)
     return ret;
 }
 
+/*
+* iov_check
+*   DESCRIPTION: validate a vector of buffers passed to readv or writev, the vector and the buffers
+*                have to be mapped in the program region
+*   INPUTS: iov -- the vector of buffers
+*           iovcnt -- the number of buffers
+*           write -- 1 if the buffers are written to (readv)
+*   OUTPUTS: none
+*   RETURN VALUE: -1 if the vector is invalid, the total number of bytes otherwise
+*/
+static int32_t iov_check(const iovec_t* iov, int32_t iovcnt, int32_t write)
+{
+    int32_t i;
+    int32_t total = 0;
+
+    if (iov == NULL || iovcnt <= 0 || iovcnt > IOV_MAX || !user_range_ok(iov, iovcnt * sizeof(iovec_t), 0)) {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        // a buffer may be empty, but the total has to fit in the return value
+        if (iov[i].len < 0 || (iov[i].len > 0 && iov[i].base == NULL) || iov[i].len > 0x7FFFFFFF - total) {
+            return -1;
+        }
+        if (iov[i].len > 0 && !user_range_ok(iov[i].base, iov[i].len, write)) {
+            return -1;
+        }
+        total += iov[i].len;
+    }
+    return total;
+}
+
+/*
+* readv
+*   DESCRIPTION: read data into a vector of buffers with one system call. Drivers with a readv
+*                fast path fill every buffer at once, the others are read one buffer at a time
+*                until a read returns fewer bytes than asked for.
+*   INPUTS: fd -- file descriptor
+*           iov -- the buffers to be filled, in order
+*           iovcnt -- the number of buffers, up to IOV_MAX
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, the total number of bytes read on success
+*/
+int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    file_descriptor* file;
+    int32_t i;
+    int32_t ret;
+    int32_t total = 0;
+
+    // fd - index to file_descriptor_array of size fd_capacity
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || iov_check(iov, iovcnt, 1) == -1) {
+        return -1;
+    }
+    file = &cur_pcb->file_descriptor_array[fd];
+    if (file->flags == 0) {
+        return -1;
+    }
+
+    if (file->file_operations_table_ptr.readv != NULL) {
+        total = file->file_operations_table_ptr.readv(fd, iov, iovcnt);
+        if (total > 0) {
+            file->file_position += total;
+        }
+        return total;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) {
+            continue;
+        }
+        ret = file->file_operations_table_ptr.read(fd, iov[i].base, iov[i].len);
+        if (ret < 0) {
+            // report the bytes already read, the error shows up on the next call
+            return (total > 0) ? total : -1;
+        }
+        file->file_position += ret;
+        total += ret;
+        if (ret < iov[i].len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/*
+* writev
+*   DESCRIPTION: write a vector of buffers with one system call. Drivers with a writev fast path
+*                write every buffer at once (the terminal updates the screen once), the others
+*                are written one buffer at a time.
+*   INPUTS: fd -- file descriptor
+*           iov -- the buffers to be written, in order
+*           iovcnt -- the number of buffers, up to IOV_MAX
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, the total number of bytes written on success
+*/
+int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    file_descriptor* file;
+    int32_t i;
+    int32_t ret;
+    int32_t total = 0;
+
+    // fd - index to file_descriptor_array of size fd_capacity
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || iov_check(iov, iovcnt, 0) == -1) {
+        return -1;
+    }
+    file = &cur_pcb->file_descriptor_array[fd];
+    if (file->flags == 0) {
+        return -1;
+    }
+
+    if (file->file_operations_table_ptr.writev != NULL) {
+        return file->file_operations_table_ptr.writev(fd, iov, iovcnt);
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].len == 0) {
+            continue;
+        }
+        ret = file->file_operations_table_ptr.write(fd, iov[i].base, iov[i].len);
+        if (ret < 0) {
+            return (total > 0) ? total : -1;
+        }
+        total += ret;
+        if (ret < iov[i].len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/*
+* getdents
+*   DESCRIPTION: read a batch of directory entries, each with its name, file type, inode and length
+*   INPUTS: fd -- file descriptor of an open directory
+*           buf -- the buffer of directory entries to be filled
+*           nbytes -- the size of the buffer, at least one entry
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, 0 at the end of the directory, the number of bytes filled on success
+*/
+int32_t getdents(int32_t fd, void* buf, int32_t nbytes)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+
+    // fd - index to file_descriptor_array of size fd_capacity
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || buf == NULL || cur_pcb->file_descriptor_array[fd].flags == 0) {
+        return -1;
+    }
+    if (nbytes <= 0 || !user_range_ok(buf, nbytes, 1)) {
+        return -1;
+    }
+    // only directories are read with dir_read
+    if (cur_pcb->file_descriptor_array[fd].file_operations_table_ptr.read != dir_read) {
+        return -1;
+    }
+    return dir_getdents(fd, (dirent_t*)buf, nbytes);
+}
+
+/*
+* isatty
+*   DESCRIPTION: check whether a file descriptor is the terminal, a program in a pipeline reads a pipe instead
+*   INPUTS: fd -- file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if fd reads the keyboard or writes the screen, 0 for other files, -1 if fd is not open
+*/
+int32_t isatty(int32_t fd)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+
+    // fd - index to file_descriptor_array of size fd_capacity
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || cur_pcb->file_descriptor_array[fd].flags == 0) {
+        return -1;
+    }
+    if (cur_pcb->file_descriptor_array[fd].file_operations_table_ptr.read == terminal_read ||
+        cur_pcb->file_descriptor_array[fd].file_operations_table_ptr.write == terminal_write) {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+* ms_to_ticks
+*   DESCRIPTION: convert a time in milliseconds to timer ticks, rounded up, without overflowing for
+*                times near INT_MAX
+*   INPUTS: ms - milliseconds, not negative
+*   OUTPUTS: none
+*   RETURN VALUE: the ticks, at most TIMER_MAX_TICKS
+*   SIDE EFFECTS: none
+*/
+static uint32_t ms_to_ticks(int32_t ms)
+{
+    // 1000 - milliseconds per second, unsigned so rounding up INT_MAX does not wrap
+    uint32_t ticks = ((uint32_t)ms + 1000 / PIT_HZ - 1) / (1000 / PIT_HZ);
+
+    return (ticks > TIMER_MAX_TICKS) ? TIMER_MAX_TICKS : ticks;
+}
+
+/*
+* poll
+*   DESCRIPTION: wait until one of several file descriptors is ready, checked through the poll
+*                operation of each file. The process gives up the processor between checks
+*   INPUTS: fds - the file descriptors and the conditions to wait for, negative fds are skipped
+*           nfds - number of entries in fds, at most POLL_MAX
+*           timeout - milliseconds to wait, 0 to check once, negative to wait forever
+*   OUTPUTS: fills in revents of every entry
+*   RETURN VALUE: number of entries with revents set, 0 on timeout, -1 on failure or when a signal arrives
+*   SIDE EFFECTS: none
+*/
+int32_t poll(pollfd_t* fds, int32_t nfds, int32_t timeout)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    file_descriptor* file;
+    uint32_t deadline;
+    int32_t ready;
+    int32_t fd;
+    int32_t i;
+
+    if (fds == NULL || nfds < 0 || nfds > POLL_MAX || !user_range_ok(fds, nfds * sizeof(pollfd_t), 1)) {
+        return -1;
+    }
+    // a negative timeout never expires
+    deadline = pit_ticks + ((timeout > 0) ? ms_to_ticks(timeout) : 0);
+
+    while (1) {
+        ready = 0;
+        for (i = 0; i < nfds; i++) {
+            fd = fds[i].fd;
+            fds[i].revents = 0;
+            if (fd < 0) {
+                continue;
+            }
+            // fd - index to file_descriptor_array, which grows to fd_capacity entries
+            if (fd >= cur_pcb->fd_capacity || cur_pcb->file_descriptor_array[fd].flags == 0) {
+                fds[i].revents = POLLNVAL;
+            } else {
+                file = &cur_pcb->file_descriptor_array[fd];
+                fds[i].revents = file->file_operations_table_ptr.poll(fd) & (fds[i].events | POLLHUP);
+            }
+            if (fds[i].revents != 0) {
+                ready++;
+            }
+        }
+        if (ready > 0 || timeout == 0 || (timeout > 0 && (int32_t)(pit_ticks - deadline) >= 0)) {
+            return ready;
+        }
+        // a signal such as ctrl-c ends the wait
+        if (signal_pending()) {
+            return -1;
+        }
+        yield();
+    }
+}
+
+/*
+* sleep_wake
+*   DESCRIPTION: timer function of the sleep timer, lets the scheduler run the process again
+*   INPUTS: pid - the sleeping process
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void sleep_wake(uint32_t pid)
+{
+    pcb* pcb_ptr = get_pcb_ptr(pid);
+
+    if (pcb_ptr->state == PROC_SLEEPING) {
+        pcb_ptr->state = PROC_RUNNING;
+    }
+}
+
+/*
+* alarm_fire
+*   DESCRIPTION: timer function of the alarm timer
+*   INPUTS: pid - the process that set the alarm
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: raises ALARM on the process
+*/
+static void alarm_fire(uint32_t pid)
+{
+    signal_raise(pid, SIG_ALARM);
+}
+
+/*
+* sleep
+*   DESCRIPTION: put the current process on the timer wheel and take it off the scheduler until the
+*                time has passed
+*   INPUTS: ms - milliseconds to sleep, rounded up to whole timer ticks
+*   OUTPUTS: none
+*   RETURN VALUE: 0 after the full time, -1 for a negative time or when a signal arrives first
+*   SIDE EFFECTS: gives the processor to other processes
+*/
+int32_t sleep(int32_t ms)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    uint32_t flags;
+    int32_t ret = 0;
+
+    if (ms < 0) {
+        return -1;
+    }
+    // interrupts stay off between the checks and the switch, so the wake up is not missed
+    cli_and_save(flags);
+    timer_add(&cur_pcb->sleep_timer, pit_ticks + ms_to_ticks(ms));
+    while (timer_pending(&cur_pcb->sleep_timer)) {
+        if (signal_pending()) {
+            timer_del(&cur_pcb->sleep_timer);
+            ret = -1;
+            break;
+        }
+        cur_pcb->state = PROC_SLEEPING;
+        yield();
+        // nothing else could run, wait here for the next interrupt
+        if (cur_pcb->state == PROC_SLEEPING) {
+            asm volatile ("sti; hlt; cli");
+        }
+    }
+    cur_pcb->state = PROC_RUNNING;
+    restore_flags(flags);
+    return ret;
+}
+
+/*
+* alarm
+*   DESCRIPTION: raise ALARM on the current process after a time, replacing the alarm set before
+*   INPUTS: ms - milliseconds until the alarm, rounded up to whole timer ticks, 0 to cancel the alarm
+*   OUTPUTS: none
+*   RETURN VALUE: milliseconds left of the previous alarm, 0 if there was none, -1 for a negative time
+*   SIDE EFFECTS: none
+*/
+int32_t alarm(int32_t ms)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    uint32_t flags;
+    int32_t left = 0;
+
+    if (ms < 0) {
+        return -1;
+    }
+    cli_and_save(flags);
+    if (timer_del(&cur_pcb->alarm_timer)) {
+        // 1000 - milliseconds per second
+        left = (int32_t)(cur_pcb->alarm_timer.expires - pit_ticks) * (1000 / PIT_HZ);
+        if (left < 0) {
+            left = 0;
+        }
+    }
+    if (ms > 0) {
+        timer_add(&cur_pcb->alarm_timer, pit_ticks + ms_to_ticks(ms));
+    }
+    restore_flags(flags);
+    return left;
+}
+
 /*
 * open
 *   DESCRIPTION: open the file corresponding to the given filename
@@ -407,7 +1267,6 @@ int32_t open(const uint8_t* filename)
     uint32_t filetype;
     dentry_t dentry;
     int32_t i;
-    int32_t full = 0;
 
     // Validate arguments
     if (filename == NULL) {
@@ -423,25 +1282,8 @@ int32_t open(const uint8_t* filename)
     // Get pcb structure of current pid_array (pid)
     cur_pcb = get_cur_pcb_ptr();
 
-    // 8 - maximum number of files open in one pid_array
-    for (i = 0; i < 8; i++) {
-
-        // 0 - file descriptor is available
-        if (cur_pcb->file_descriptor_array[i].flags == 0) {
-            break;
-        } else {
-
-            // 7 - reaches the last file descriptor, but it is still occupied
-            if (i == 7) {
-
-                // 1 - no available file descriptors
-                full = 1;
-            }
-        }
-    }
-
-    // If no available file descriptors
-    if (full == 1) {
+    // the lowest free file descriptor, the table grows when all of them are open
+    if ((i = fd_alloc(cur_pcb)) == -1) {
         return -1;
     }
 
@@ -456,6 +1298,9 @@ int32_t open(const uint8_t* filename)
         cur_pcb->file_descriptor_array[i].file_operations_table_ptr.write = RTC_write;
         cur_pcb->file_descriptor_array[i].file_operations_table_ptr.open = RTC_open;
         cur_pcb->file_descriptor_array[i].file_operations_table_ptr.close = RTC_close;
+        cur_pcb->file_descriptor_array[i].file_operations_table_ptr.readv = NULL;
+        cur_pcb->file_descriptor_array[i].file_operations_table_ptr.writev = NULL;
+        cur_pcb->file_descriptor_array[i].file_operations_table_ptr.poll = RTC_poll;
     } else {
         
         // 1 - directory
@@ -467,6 +1312,9 @@ int32_t open(const uint8_t* filename)
             cur_pcb->file_descriptor_array[i].file_operations_table_ptr.write = dir_write;
             cur_pcb->file_descriptor_array[i].file_operations_table_ptr.open = dir_open;
             cur_pcb->file_descriptor_array[i].file_operations_table_ptr.close = dir_close;
+            cur_pcb->file_descriptor_array[i].file_operations_table_ptr.readv = NULL;
+            cur_pcb->file_descriptor_array[i].file_operations_table_ptr.writev = NULL;
+            cur_pcb->file_descriptor_array[i].file_operations_table_ptr.poll = file_poll;
         } else {
             
             // 2 - ordinary file
@@ -478,10 +1326,13 @@ int32_t open(const uint8_t* filename)
                 cur_pcb->file_descriptor_array[i].file_operations_table_ptr.write = file_write;
                 cur_pcb->file_descriptor_array[i].file_operations_table_ptr.open = file_open;
                 cur_pcb->file_descriptor_array[i].file_operations_table_ptr.close = file_close;
+                cur_pcb->file_descriptor_array[i].file_operations_table_ptr.readv = file_readv;
+                cur_pcb->file_descriptor_array[i].file_operations_table_ptr.writev = NULL;
+                cur_pcb->file_descriptor_array[i].file_operations_table_ptr.poll = file_poll;
             } else {
 
                 // Other filetype values are invalid
-                cur_pcb->file_descriptor_array[i].flags = 0;
+                fd_free(cur_pcb, i);
                 return -1;
             }
         }
@@ -504,9 +1355,9 @@ int32_t close(int32_t fd)
     pcb* cur_pcb = get_cur_pcb_ptr();
     
     // Validate arguments
-    // fd - index to file_descriptor_array of size 8
+    // fd - index to file_descriptor_array of size fd_capacity
     // not allow the user to close the default descriptors (0 for input and 1 for output)
-    if (fd <= 1 || fd >= 8) {
+    if (fd <= 1 || fd >= cur_pcb->fd_capacity) {
         return -1;          // return -1 for failure
     }
 
@@ -517,15 +1368,89 @@ int32_t close(int32_t fd)
 
     // 3 - the fourth operation in file_operations_table_ptr is "read"
     ((cur_pcb->file_descriptor_array)[fd]).file_operations_table_ptr.close(fd);
-    ((cur_pcb->file_descriptor_array)[fd]).flags = 0;
+    fd_free(cur_pcb, fd);
 
     // Return 0 for success
     return 0;
 }
 
+/*
+* dup_file
+*   DESCRIPTION: fill a taken file descriptor with a copy of an open one
+*   INPUTS: cur_pcb -- the current process
+*           oldfd -- the open file descriptor
+*           newfd -- the taken file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: newfd
+*   SIDE EFFECTS: the copy has its own file position, starting where oldfd is
+*/
+static int32_t dup_file(pcb* cur_pcb, int32_t oldfd, int32_t newfd)
+{
+    memcpy(&cur_pcb->file_descriptor_array[newfd], &cur_pcb->file_descriptor_array[oldfd], sizeof(file_descriptor));
+    // a pipe stays open while any copy of an end is
+    if (cur_pcb->file_descriptor_array[newfd].file_operations_table_ptr.close == pipe_close) {
+        pipe_dup(&cur_pcb->file_descriptor_array[newfd]);
+    }
+    return newfd;
+}
+
+/*
+* dup
+*   DESCRIPTION: copy an open file descriptor to the lowest free one
+*   INPUTS: fd -- the open file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, the new file descriptor on success
+*   SIDE EFFECTS: may grow the file descriptor table
+*/
+int32_t dup(int32_t fd)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    int32_t newfd;
+
+    if (fd < 0 || fd >= cur_pcb->fd_capacity || cur_pcb->file_descriptor_array[fd].flags == 0) {
+        return -1;
+    }
+    if ((newfd = fd_alloc(cur_pcb)) == -1) {
+        return -1;
+    }
+    return dup_file(cur_pcb, fd, newfd);
+}
+
+/*
+* dup2
+*   DESCRIPTION: copy an open file descriptor to a given one, closing what it held first. Unlike close
+*                it may replace stdin and stdout, which is how a program redirects them
+*   INPUTS: oldfd -- the open file descriptor
+*           newfd -- the file descriptor to fill, below FD_MAX
+*   OUTPUTS: none
+*   RETURN VALUE: -1 on failure, newfd on success
+*   SIDE EFFECTS: may grow the file descriptor table
+*/
+int32_t dup2(int32_t oldfd, int32_t newfd)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+
+    if (oldfd < 0 || oldfd >= cur_pcb->fd_capacity || cur_pcb->file_descriptor_array[oldfd].flags == 0 ||
+        newfd < 0 || newfd >= FD_MAX) {
+        return -1;
+    }
+    if (oldfd == newfd) {
+        return newfd;
+    }
+    if (newfd < cur_pcb->fd_capacity && cur_pcb->file_descriptor_array[newfd].flags == 1) {
+        cur_pcb->file_descriptor_array[newfd].file_operations_table_ptr.close(newfd);
+        fd_free(cur_pcb, newfd);
+    }
+    if (fd_claim(cur_pcb, newfd) == -1) {
+        return -1;
+    }
+    return dup_file(cur_pcb, oldfd, newfd);
+}
+
 /*
 * getargs
-*   DESCRIPTION: get the arguments of the command
+*   DESCRIPTION: get the arguments of the command, all of them separated by single spaces.
+*                main also finds them split up as argc and argv on its stack
 *   INPUTS: buf -- the buffer to which the arguments are copied
 *           nbytes -- the number of bytes to be read
 *   OUTPUTS: none
@@ -540,18 +1465,18 @@ int32_t getargs(uint8_t* buf, int32_t nbytes)
     {
         return -1;
     }
-    // check if args are merely copied into the user space, return -1 if not
-    if ((int32_t)buf < USER_ADDR || (int32_t)buf > USER_STACK_ADDR)
+    // check if args are merely copied into mapped, writable user pages, return -1 if not
+    if (!user_range_ok(buf, nbytes, 1))
     {
         return -1;
     }
-    // check if the length of args is greater than nbytes, return -1 if so
-    if (strlen((int8_t*)cur_pcb->args) > nbytes)
+    // check if args and the terminating null fit in nbytes, return -1 if not
+    if (strlen((int8_t*)cur_pcb->args) >= nbytes)
     {
         return -1;
     }
     // copy args to the buffer
-    memcpy(buf, cur_pcb->args, nbytes);
+    memcpy(buf, cur_pcb->args, strlen((int8_t*)cur_pcb->args) + 1);
     // Return 0 for success
     return 0;
 }
@@ -566,7 +1491,7 @@ int32_t getargs(uint8_t* buf, int32_t nbytes)
 int32_t vidmap(uint8_t** screen_start)
 {
     // check if the screen_start is valid
-    if (screen_start == NULL || (uint32_t)screen_start < USER_ADDR || (uint32_t)screen_start > USER_STACK_ADDR)
+    if (screen_start == NULL || !user_range_ok(screen_start, sizeof(uint8_t*), 1))
     {
         return -1;
     }
@@ -593,27 +1518,25 @@ int32_t set_handler(int32_t signum, void* handler_address)
 {
     // Get current pcb structure of current process
     pcb* cur_pcb = get_cur_pcb_ptr();
-    
+
+    // signum only valid for 0, 1, 2, 3 and 4
+    if (signum < 0 || signum >= SIGNAL_NUM) {
+        return -1;
+    }
+
     // If handler_address is NULL, set to default action
     if (handler_address == NULL) {
-        
         // for signal 0, 1 and 2, default action is "kill the task"
-        if (signum == 0 || signum == 1 || signum == 2) {
-            (cur_pcb->signals[signum]).handler = KILL;
-        } else {
-            
-            // for signal 3 and 4, default action is "ignore"
-            if (signum == 3 || signum == 4) {
-                (cur_pcb->signals[signum]).handler = IGNORE;
-            }
-        }
+        // for signal 3 and 4, default action is "ignore"
+        (cur_pcb->signals[signum]).handler = (signum <= SIG_INTERRUPT) ? (void*)KILL : (void*)IGNORE;
+        return 0;
     }
 
-    // signum only valid for 0, 1, 2, 3 and 4
-    if (signum < 0 || signum > 4) {
+    // the handler runs in user space, it must be inside the program region
+    if ((uint32_t)handler_address < USER_ADDR || (uint32_t)handler_address >= USER_STACK_ADDR) {
         return -1;
     }
-    
+
     // Set handler
     (cur_pcb->signals[signum]).handler = handler_address;
     
@@ -621,24 +1544,52 @@ int32_t set_handler(int32_t signum, void* handler_address)
     return 0;
 }
 
+/*
+* get_user_context
+*   DESCRIPTION: get the hw_context saved when the current process last entered the kernel from user
+*                space. The int 0x80, sysenter, interrupt and exception linkages all build it at the
+*                top of the kernel stack, right below tss.esp0
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: pointer to the context
+*/
+static hw_context* get_user_context(void)
+{
+    // 0x2000 - 8KB kernel stack per process, 4 - esp0 is one word below the top
+    return (hw_context*)(KERNEL_BOTTOM_ADDR - get_pid() * 0x2000 - 4 - sizeof(hw_context));
+}
+
 /*
 * sigreturn
-*   DESCRIPTION: copies the hardware context that was on the user-level stack back onto the
-*                processor
+*   DESCRIPTION: copies the hardware context that the signal handler frame saved on the user-level stack
+*                back into the context the process returns to
 *   INPUTS: none
-*   OUTPUTS: copies current hardware context onto the processor
-*   RETURN VALUE: -1 on failure, 0 on success
+*   OUTPUTS: copies the saved hardware context into the kernel stack
+*   RETURN VALUE: eax of the saved context, so the return value of the interrupted call is kept;
+*                 -1 on failure
 */
 int32_t sigreturn(void)
 {
     int32_t i;                                          // Looping index
-    uint32_t ebp_k;                                     // Kernel ebp value
-    pcb* cur_pcb = get_cur_pcb_ptr();                   // Get current pcb of current process 
-    asm volatile ("movl %%ebp, %0" : "=r"(ebp_k));      // Get ebp of hardware context structure
-    
-    // 20 - offset to get return address on the hardware context structure
-    // 4 - offset to get previous hardware context structure on user-level stack frame
-    memcpy((hw_context*)(ebp_k + 20), (hw_context*)(((hw_context*)(ebp_k + 20))->esp + 4), sizeof(*((hw_context*)(ebp_k + 20))));
+    pcb* cur_pcb = get_cur_pcb_ptr();                   // Get current pcb of current process
+    hw_context* context = get_user_context();
+    // the handler returned into the trampoline, which popped the return address; signum is on top
+    hw_context* saved = (hw_context*)(context->esp + 4);
+    uint32_t eflags = context->eflags;
+
+    if (!user_range_ok(saved, sizeof(hw_context), 0)) {
+        return -1;
+    }
+    memcpy(context, saved, sizeof(hw_context));
+
+    // the process may have written the copy, only let it return to user mode with interrupts on
+    context->cs = USER_CS;
+    context->ss = USER_DS;
+    context->ds = USER_DS;
+    context->es = USER_DS;
+    context->fs = USER_DS;
+    // the other flags (VM, IOPL, NT, RF, AC, VIF, VIP) come from the frame of this call, 0x200 - IF
+    context->eflags = (context->eflags & EFLAGS_USER) | (eflags & ~EFLAGS_USER) | 0x200;
     
     // 5 - total number of signals
     for (i = 0; i < 5; i++) {
@@ -647,7 +1598,117 @@ int32_t sigreturn(void)
         (cur_pcb->signals[i]).mask = 0;
     }
     
-    // 0 - success
+    return context->eax;
+}
+
+/*
+* signal_raise
+*   DESCRIPTION: mark signal signum pending for process pid, it is delivered the next time the process
+*                returns to user space. Callable from interrupt handlers
+*   INPUTS: pid - the process
+*           signum - the signal
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void signal_raise(int32_t pid, int32_t signum)
+{
+    uint32_t flags;
+
+    if (pid < 0 || pid >= PROCESS_MAX || signum < 0 || signum >= SIGNAL_NUM) {
+        return;
+    }
+    cli_and_save(flags);
+    get_pcb_ptr(pid)->sig_pending |= 1 << signum;
+    // a sleeping process runs again to look at the signal
+    if (get_pcb_ptr(pid)->state == PROC_SLEEPING) {
+        get_pcb_ptr(pid)->state = PROC_RUNNING;
+    }
+    restore_flags(flags);
+}
+
+/*
+* signal_pending
+*   DESCRIPTION: check whether the current process has a signal that will stop what it is doing, for
+*                kernel loops that wait for a device so they can return early
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if an unmasked signal without the ignore action is pending, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+int32_t signal_pending(void)
+{
+    pcb* cur_pcb = get_cur_pcb_ptr();
+    int32_t signum;
+
+    for (signum = 0; signum < SIGNAL_NUM; signum++) {
+        if ((cur_pcb->sig_pending & (1 << signum)) && cur_pcb->signals[signum].mask == 0 &&
+            cur_pcb->signals[signum].handler != (void*)IGNORE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+* do_signal
+*   DESCRIPTION: deliver the lowest pending unmasked signal of the current process, called with
+*                interrupts off by the linkages just before they return through context.
+*                The default actions run here; for a user handler the user stack gets, from the top,
+*                the sigreturn trampoline, a copy of context, the signal number and a return address
+*                pointing at the trampoline, and context is changed to enter the handler
+*   INPUTS: context - the hw_context the linkage is about to return through
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if context now enters a handler, 0 otherwise
+*   SIDE EFFECTS: does not return when the action kills the process
+*/
+int32_t do_signal(hw_context* context)
+{
+    // movl $10, %eax; int $0x80, padded to a word
+    static const uint8_t trampoline[SIG_TRAMPOLINE_SIZE] = {0xB8, 0x0A, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90};
+    pcb* cur_pcb;
+    int32_t signum, i;
+    uint32_t esp;
+    void* handler;
+
+    // 3 - privilege level, only frames going back to user space deliver signals
+    if ((context->cs & 3) != 3) {
+        return 0;
+    }
+    cur_pcb = get_cur_pcb_ptr();
+    for (signum = 0; signum < SIGNAL_NUM; signum++) {
+        if (!(cur_pcb->sig_pending & (1 << signum)) || cur_pcb->signals[signum].mask == 1) {
+            continue;
+        }
+        cur_pcb->sig_pending &= ~(1 << signum);
+        handler = cur_pcb->signals[signum].handler;
+        if (handler == (void*)IGNORE) {
+            continue;
+        }
+        if (handler == (void*)KILL) {
+            KILL();
+        }
+
+        // 4 - the signal number and the return address
+        if (context->esp < USER_ADDR + SIG_TRAMPOLINE_SIZE + sizeof(hw_context) + 2 * 4 ||
+            !user_range_ok((void*)(context->esp - SIG_TRAMPOLINE_SIZE - sizeof(hw_context) - 2 * 4),
+                           SIG_TRAMPOLINE_SIZE + sizeof(hw_context) + 2 * 4, 1)) {
+            KILL();
+        }
+        esp = context->esp - SIG_TRAMPOLINE_SIZE - sizeof(hw_context) - 2 * 4;
+        memcpy((void*)(context->esp - SIG_TRAMPOLINE_SIZE), trampoline, SIG_TRAMPOLINE_SIZE);
+        memcpy((void*)(esp + 2 * 4), context, sizeof(hw_context));
+        ((uint32_t*)esp)[1] = signum;
+        ((uint32_t*)esp)[0] = context->esp - SIG_TRAMPOLINE_SIZE;
+
+        // handlers do not nest, sigreturn unmasks
+        for (i = 0; i < SIGNAL_NUM; i++) {
+            cur_pcb->signals[i].mask = 1;
+        }
+        context->esp = esp;
+        context->ret_addr = (uint32_t)handler;
+        return 1;
+    }
     return 0;
 }
 
@@ -670,8 +1731,8 @@ int32_t KILL()
         cur_pcb->signals[i].mask = 0;
     }
     
-    // Call halt to stop current process
-    halt(0);
+    // Call halt to stop current process, 1 - the parent sees 256 like for an exception
+    halt(1);
     
     // 0 - success
     return 0;
@@ -811,3 +1872,50 @@ void flush_tlb()
         : "eax"
     );
 }
+
+/*
+* sysenter_init
+*   DESCRIPTION: set up the SYSENTER/SYSEXIT fast system call entry. The kernel stack is read from
+*                tss.esp0 on entry, so context switches do not have to reprogram the MSRs
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: 0 on success, -1 if the processor has no SYSENTER
+*   SIDE EFFECTS: writes the SYSENTER_CS, SYSENTER_ESP and SYSENTER_EIP MSRs
+*/
+int32_t sysenter_init(void)
+{
+    uint32_t features;
+
+    // 1 - cpuid leaf with the feature flags, bit 11 of edx is SEP
+    asm volatile("cpuid" : "=d"(features) : "a"(1) : "ebx", "ecx");
+    if (!(features & (1 << 11))) {
+        return -1;
+    }
+
+    // SYSEXIT uses SYSENTER_CS + 16 and + 24 as the user code and stack segments,
+    // which are USER_CS and USER_DS in the GDT
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_CS), "a"(KERNEL_CS), "d"(0));
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_ESP), "a"((uint32_t)&tss.esp0), "d"(0));
+    asm volatile("wrmsr" : : "c"(MSR_SYSENTER_EIP), "a"((uint32_t)sysenter_handler_linkage), "d"(0));
+    return 0;
+}
+
+/*
+* sysenter_frame
+*   DESCRIPTION: finish the frame the sysenter linkage built. The caller's stack pointer came in ebp
+*                with the address to return to on top, which has to be mapped memory of the caller
+*                before the kernel reads it
+*   INPUTS: context - the frame, its esp is the caller's ebp
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 if the return address cannot be read
+*   SIDE EFFECTS: sets the return address of the frame and pops it off the caller's stack
+*/
+int32_t sysenter_frame(hw_context* context)
+{
+    if (!user_range_ok((const void*)context->esp, sizeof(uint32_t), 0)) {
+        return -1;
+    }
+    context->ret_addr = *(uint32_t*)context->esp;
+    context->esp += sizeof(uint32_t);
+    return 0;
+}
@@ -5,12 +5,57 @@ system_calls.h - Defines for various system calls
 #define SYSTEM_CALLS_H
 #include "types.h"
 #include "pit.h"
+#include "loader.h"
+#include "trace.h"
+#include "timer.h"
 
 #define KERNEL_BOTTOM_ADDR 0x800000 // 8MB in physical memory
 #define USER_ADDR 0x8000000 // 128MB in physical memory
 #define USER_IMAGE 0x08048000 // The program image itself is linked to execute at virtual address 0x08048000.
 #define USER_STACK_ADDR 0x8400000 // 132MB in physical memory
 #define USER_VIDEO_ADDR 0x8800000 // 136MB in physical memory
+#define IOV_MAX 16 // maximum number of buffers in one readv/writev
+#define PROCESS_MAX 6 // maximum number of processes
+#define TERMINAL_MAX 8 // maximum number of terminals, one per 4KB page of VGA text memory
+#ifndef TERMINAL_COUNT
+#define TERMINAL_COUNT 3 // terminals without "terminals=N" on the boot command line, make TERMINALS=N sets it
+#endif
+// the base shells are pids 0 - TERMINAL_COUNT - 1, one process has to be left for programs
+#if TERMINAL_COUNT < 1 || TERMINAL_COUNT > TERMINAL_MAX || TERMINAL_COUNT >= PROCESS_MAX
+#error "TERMINAL_COUNT must be between 1 and TERMINAL_MAX, and below PROCESS_MAX"
+#endif
+#define PIPELINE_MAX 4 // maximum number of programs joined by '|' in one command
+#define ENV_SIZE 128 // environment strings of a process, each null-terminated, ended by an empty string
+#define ENV_DEFAULT "HOME=/\0TERM=ece391\0" // environment of the base shells, inherited by what they start
+#define FD_INLINE 8 // file descriptors held in the pcb, the table moves to the kernel page pool when they run out
+#define FD_MAX 1024 // maximum number of open files per process
+// poll conditions, the Linux values
+#define POLLIN 0x01 // read does not block
+#define POLLOUT 0x04 // write does not block
+#define POLLHUP 0x10 // the other end is closed, always reported
+#define POLLNVAL 0x20 // the file descriptor is not open, always reported
+#define POLL_MAX 8 // maximum number of file descriptors watched by one poll
+// model specific registers of the sysenter entry point
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+// CF, PF, AF, ZF, SF, TF, DF, OF - the flags a program may change in a saved context
+#define EFLAGS_USER 0xDD5
+// process states seen by the scheduler
+#define PROC_RUNNING 0 // can be given the processor
+#define PROC_WAITING 1 // blocked in execute until its child halts, or not started yet
+#define PROC_SLEEPING 2 // in sleep until its timer fires or a signal is raised
+#define PROC_ZOMBIE 3 // halted, keeps its process id until the parent collects the status with waitpid
+// waitpid options
+#define WNOHANG 1 // return 0 instead of waiting when no child has halted
+// signals, the numbers user programs use
+#define SIG_DIV_ZERO 0 // divide error exception, default kill
+#define SIG_SEGFAULT 1 // any other exception, default kill
+#define SIG_INTERRUPT 2 // ctrl-c on the terminal, default kill
+#define SIG_ALARM 3 // default ignore
+#define SIG_USER1 4 // default ignore
+#define SIGNAL_NUM 5 // total signal number
+#define SIG_TRAMPOLINE_SIZE 8 // code on the user stack that calls sigreturn when a handler returns
 // invalid file operations for stdin and stdout
 extern int32_t invalid_read(int32_t fd, void* buf, int32_t nbytes);
 extern int32_t invalid_write(int32_t fd, const void* buf, int32_t nbytes);
@@ -22,6 +67,9 @@ typedef int32_t(*read_ptr)(int32_t fd, void* buf, int32_t nbyte);
 typedef int32_t(*write_ptr)(int32_t fd, const void* buf, int32_t nbyte);
 typedef int32_t(*open_ptr)(const uint8_t* filename);
 typedef int32_t(*close_ptr)(int32_t fd);
+typedef int32_t(*readv_ptr)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+typedef int32_t(*writev_ptr)(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+typedef int32_t(*poll_ptr)(int32_t fd);
 
 // the file operations table
 typedef struct file_operations_table
@@ -30,6 +78,9 @@ typedef struct file_operations_table
     close_ptr close;
     read_ptr read;
     write_ptr write; 
+    readv_ptr readv;    // fast path for a vector of buffers, NULL to call read once per buffer
+    writev_ptr writev;  // fast path for a vector of buffers, NULL to call write once per buffer
+    poll_ptr poll;      // POLLIN / POLLOUT / POLLHUP conditions of the file right now
 } file_operations_table;
 
 // the file descriptor as an element in a file descriptor array
@@ -44,7 +95,6 @@ typedef struct file_descriptor
 // sigaction - information of a signal
 typedef struct sigaction
 {
-    int32_t flag;       // flag - whether this signal is raised
     int32_t mask;       // mask - whether this is permitted to be raised
     void* handler;      // handler - specific task for this signal to do
 } sigaction;
@@ -52,15 +102,31 @@ typedef struct sigaction
 // the Process Control Block (pcb) struct
 typedef struct pcb
 {
-    file_descriptor file_descriptor_array[8]; // Up to 8 open files per task
+    file_descriptor* file_descriptor_array; // the open files, fd_inline or pages of the kernel page pool
+    int32_t fd_capacity; // number of entries in file_descriptor_array, valid descriptors are below it
+    int32_t fd_pages; // kernel pool pages holding file_descriptor_array, 0 while it is fd_inline
+    uint32_t fd_bitmap[FD_MAX / 32]; // bit fd - descriptor fd is taken, 32 bits per word
+    file_descriptor fd_inline[FD_INLINE]; // the table of a process that never has more than FD_INLINE files open
     uint32_t parent_pid; // the parent process id
     uint32_t pid; // the current process id
     uint32_t esp; // the current stack pointer esp
     uint32_t ebp; // the current base pointer ebp
-    uint32_t run_ebp; // current running process's base pointer
-    uint8_t args[128]; // the command line arguments, 128 is the keyboard buffer size
+    uint32_t run_esp; // kernel stack pointer saved by switch_stack while the process is switched out
+    int32_t terminal; // the terminal the process reads from and writes to
+    int32_t state; // PROC_RUNNING or PROC_WAITING
+    int32_t detached; // 1 - no parent waits in execute for this process (earlier stages of a pipeline, spawned programs)
+    int32_t waitable; // 1 - started by spawn, becomes a zombie at halt until the parent calls waitpid
+    int32_t exit_status; // what execute would have returned, kept for waitpid while a zombie
+    uint8_t args[128]; // the command line arguments separated by single spaces, 128 is the keyboard buffer size
+    uint8_t env[ENV_SIZE]; // the environment, copied onto the user stack with the arguments
+    uint32_t user_esp; // user stack pointer the process starts with, pointing at argc
     // uint8_t terminal_num;
     sigaction signals[5];
+    uint32_t sig_pending; // bit n - signal n raised and not delivered yet
+    ktimer_t sleep_timer; // wakes the process from sleep
+    ktimer_t alarm_timer; // raises ALARM
+    program_image_t* image; // the executable image mapped into the program region, released at halt
+    trace_call_t trace; // the system call in progress, while tracing is on
 } pcb;
 
 // the hardware context structure
@@ -95,6 +161,23 @@ extern int32_t getargs(uint8_t* buf, int32_t nbytes);
 extern int32_t vidmap(uint8_t** screen_start);
 extern int32_t set_handler(int32_t signum, void* handler_address);
 extern int32_t sigreturn(void);
+extern int32_t readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+extern int32_t writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+extern int32_t getdents(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t isatty(int32_t fd);
+extern int32_t poll(pollfd_t* fds, int32_t nfds, int32_t timeout);
+extern int32_t sleep(int32_t ms);
+extern int32_t alarm(int32_t ms);
+extern int32_t spawn(const uint8_t* command);
+extern int32_t waitpid(int32_t pid, int32_t* status, int32_t options);
+extern int32_t dup(int32_t fd);
+extern int32_t dup2(int32_t oldfd, int32_t newfd);
+extern int32_t process_start(const uint8_t* command, int32_t term);
+extern int32_t sysenter_init(void);
+extern int32_t sysenter_frame(hw_context* context);
+extern void signal_raise(int32_t pid, int32_t signum);
+extern int32_t signal_pending(void);
+extern int32_t do_signal(hw_context* context);
 
 extern int32_t KILL();
 extern int32_t IGNORE();
@@ -103,8 +186,10 @@ extern void flush_tlb();
 extern pcb* get_pcb_ptr(int32_t pid);
 extern pcb* get_cur_pcb_ptr();
 extern int32_t get_pid();
+extern uint8_t pid_bitmap[PROCESS_MAX];
 
-extern int32_t schedule[3];     // 3 - total number of terminal
+extern int32_t schedule[TERMINAL_MAX];  // foreground process of each terminal
+extern int32_t num_terminals;   // terminals in use, with base shells pid 0 - num_terminals - 1
 extern int32_t run_terminal;    // Current running terminal id number
 
 #endif
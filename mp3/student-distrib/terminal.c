@@ -9,8 +9,13 @@
 #include "system_calls.h"
 #include "page.h"
 #include "cursor.h"
+#include "serial.h"
+#include "aio.h"
+#include "pit.h"
 
-struct terminal_t terminal[3];              // Terminal window
+terminal_t* terminal;                       // Terminal windows, in the kernel page pool
+int32_t num_terminals = TERMINAL_COUNT;     // Terminals in use
+int32_t serial_terminal = -1;               // Terminal on the serial port, -1 if none
 int32_t cur_terminal = 0;                   // Current terminal id
 
 /*
@@ -53,7 +58,7 @@ int32_t terminal_close(int32_t fd)
 *           buffer - pointer to the buffer read
 *           number - byte number to be read
 *   OUTPUTS: none
-*   RETURN VALUE: byte number read for success, -1 for invalid arguments
+*   RETURN VALUE: byte number read for success, -1 for invalid arguments or when a signal arrives while waiting
 *   SIDE EFFECTS: none
 */
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
@@ -68,20 +73,38 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
     int ret = 0;                    // ret - record number of bytes read
     int i;                          // i - loop count while adding 0s to the end of buffer
     int last = 0;                   // last - "binary" variable to indicate '\n' appearance
+    uint32_t flags;
     
-    memset(terminal[run_terminal].keyboard_buffer, 0, 128);	
-	terminal[run_terminal].index = 0;	
+    // raw mode returns the keys typed so far, waiting for the first one
+    if (terminal[run_terminal].raw_pid != -1) {
+        while (terminal[run_terminal].index == 0) {
+            if (signal_pending()) {
+                return -1;
+            }
+        }
+        cli_and_save(flags);
+        ret = (nbytes < terminal[run_terminal].index) ? nbytes : terminal[run_terminal].index;
+        memcpy(buffer, terminal[run_terminal].keyboard_buffer, ret);
+        memmove(terminal[run_terminal].keyboard_buffer, terminal[run_terminal].keyboard_buffer + ret, terminal[run_terminal].index - ret);
+        terminal[run_terminal].index -= ret;
+        restore_flags(flags);
+        return ret;
+    }
 
-    // Initialize enter_pressed to be 0
-    terminal[run_terminal].enter_pressed = 0;                // 0 - enter key not pressed down
-    while (!(terminal[run_terminal].enter_pressed)) {}       // Wait until enter key pressed down
+    // A line entered before the read (reported by poll) is returned right away, and one being typed
+    // is kept. Wait until enter key pressed down, a signal such as ctrl-c ends the read
+    while (!(terminal[run_terminal].enter_pressed)) {
+        if (signal_pending()) {
+            return -1;
+        }
+    }
     
     // Loop to read
     for (ct = 0; ct < nbytes; ct++) {
         
-        // Buffer overflow, 128 - maximum charater number from keyboard
-        if (ct >= 128) {
-            return ret;
+        // Buffer overflow
+        if (ct >= LDISC_LINE) {
+            break;
         } else {
             
             // If new line reached
@@ -109,11 +132,70 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
         }
     }
     
+    // The line is consumed, the next one starts in an empty buffer
+    // 0 - enter key not pressed down
+    terminal[run_terminal].enter_pressed = 0;
+    terminal[run_terminal].index = 0;
+
     // Return the number of bytes read
     return ret;
 }
 
 
+/*
+* terminal_poll
+*   DESCRIPTION: Report whether terminal_read would return without waiting
+*   INPUTS: fd - file descriptor
+*   OUTPUTS: none
+*   RETURN VALUE: POLLOUT, with POLLIN once a line has been entered, or a key typed in raw mode
+*   SIDE EFFECTS: none
+*/
+int32_t terminal_poll(int32_t fd)
+{
+    if (terminal[run_terminal].raw_pid != -1) {
+        return (terminal[run_terminal].index != 0) ? (POLLIN | POLLOUT) : POLLOUT;
+    }
+    return terminal[run_terminal].enter_pressed ? (POLLIN | POLLOUT) : POLLOUT;
+}
+
+/*
+* terminal_write_lock
+*   DESCRIPTION: Wait until no other process is writing to a terminal and claim it, so the output of
+*                one write is not interleaved with another. Interrupts stay on while the writer renders,
+*                the waiters give the processor away
+*   INPUTS: tid - terminal id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void terminal_write_lock(int32_t tid)
+{
+    uint32_t flags;
+    while (1) {
+        cli_and_save(flags);
+        if (terminal[tid].write_busy == 0) {
+            terminal[tid].write_busy = 1;
+            restore_flags(flags);
+            return;
+        }
+        restore_flags(flags);
+        yield();
+    }
+}
+
+/*
+* terminal_write_unlock
+*   DESCRIPTION: Let the next writer of a terminal in
+*   INPUTS: tid - terminal id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void terminal_write_unlock(int32_t tid)
+{
+    terminal[tid].write_busy = 0;
+}
+
 /*
 * terminal_write
 *   DESCRIPTION: Write to the terminal window
@@ -126,83 +208,463 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes)
 */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes)
 {
+    int32_t tid = run_terminal;
+    int32_t ret;
+
     // If buffer pointer is invalid or byte number to read is invalid, return -1 for failure
     if (buf == NULL || nbytes < 0) {
         return -1;      // -1 - return value for failure
     }
     
-    char* buffer = (char*)buf;      // Convert buffer from void* to char*
-    int ct;                         // ct - loop count while reading
-    
-    // Loop to write
-    for (ct = 0; ct < nbytes; ct++) {
-        
-        // Write byte to the terminal window
-        putc(buffer[ct], 0);
+    // Write the bytes to the terminal window, moving the cursor once
+    terminal_write_lock(tid);
+    ret = putbuf_terminal((const uint8_t*)buf, nbytes, tid, 0);
+    terminal_write_unlock(tid);
+    return ret;
+}
+
+
+/*
+* terminal_writev
+*   DESCRIPTION: Write a vector of buffers to the terminal window as one update
+*   INPUTS: fd - file descriptor
+*           iov - buffers to write, in order, checked by the caller
+*           iovcnt - number of buffers
+*   OUTPUTS: none
+*   RETURN VALUE: total byte number written
+*   SIDE EFFECTS: the output is not interleaved with other writers
+*/
+int32_t terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t tid = run_terminal;
+    int32_t i;
+    int32_t total = 0;
+
+    // the other writers wait for the whole vector, interrupts stay on
+    terminal_write_lock(tid);
+    for (i = 0; i < iovcnt; i++) {
+        total += putbuf_terminal((const uint8_t*)iov[i].base, iov[i].len, tid, 0);
+    }
+    terminal_write_unlock(tid);
+    return total;
+}
+
+
+/*
+* boot_arg
+*   DESCRIPTION: Find "name=N" on the boot command line
+*   INPUTS: cmdline - the boot command line
+*           name - the option with its '='
+*   OUTPUTS: none
+*   RETURN VALUE: N, up to TERMINAL_MAX + 1, -1 if the option is not there
+*   SIDE EFFECTS: none
+*/
+static int32_t boot_arg(const int8_t* cmdline, const int8_t* name)
+{
+    int32_t len = strlen(name);
+    int32_t value = 0;
+
+    while (*cmdline != '\0' && strncmp(cmdline, name, len) != 0) {
+        cmdline++;
+    }
+    if (*cmdline == '\0') {
+        return -1;
+    }
+    for (cmdline += len; *cmdline >= '0' && *cmdline <= '9' && value <= TERMINAL_MAX; cmdline++) {
+        // 10 - decimal
+        value = value * 10 + (*cmdline - '0');
+    }
+    return value;
+}
+
+
+/*
+* terminal_set_count
+*   DESCRIPTION: Take the number of terminals from "terminals=N" on the boot command line. The count
+*                stays TERMINAL_COUNT without it, and is kept between 1 and TERMINAL_MAX, and below
+*                PROCESS_MAX so the base shells leave a process for programs
+*   INPUTS: cmdline - the boot command line
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: called before terminal_init
+*/
+void terminal_set_count(const int8_t* cmdline)
+{
+    int32_t count = boot_arg(cmdline, "terminals=");
+
+    if (count > TERMINAL_MAX) {
+        count = TERMINAL_MAX;
+    }
+    if (count > PROCESS_MAX - 1) {
+        count = PROCESS_MAX - 1;
+    }
+    if (count > 0) {
+        num_terminals = count;
+    }
+}
+
+
+/*
+* terminal_set_serial
+*   DESCRIPTION: Put terminal N on the serial console as well as the screen for "serial=N" on the boot
+*                command line
+*   INPUTS: cmdline - the boot command line
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: called after terminal_init and serial_init
+*/
+void terminal_set_serial(const int8_t* cmdline)
+{
+    int32_t tid = boot_arg(cmdline, "serial=");
+
+    if (tid != -1) {
+        terminal_set_backend(tid, TERMINAL_VGA | TERMINAL_SERIAL);
+    }
+}
+
+
+/*
+* terminal_set_backend
+*   DESCRIPTION: Choose where the output of a terminal goes, the screen, the serial port or both. One
+*                terminal at a time has the serial port, and takes the input typed on it
+*   INPUTS: tid - terminal id
+*           backend - TERMINAL_VGA and TERMINAL_SERIAL bits
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success, -1 for a bad terminal or backend, or no UART for TERMINAL_SERIAL
+*   SIDE EFFECTS: the terminal that had the serial port keeps only its other backends, the screen if none
+*/
+int32_t terminal_set_backend(int32_t tid, uint8_t backend)
+{
+    uint32_t flags;
+
+    if (tid < 0 || tid >= num_terminals || backend == 0 || (backend & ~(TERMINAL_VGA | TERMINAL_SERIAL)) != 0) {
+        return -1;
+    }
+    if ((backend & TERMINAL_SERIAL) && serial_present() == 0) {
+        return -1;
+    }
+    cli_and_save(flags);
+    if (serial_terminal != -1 && serial_terminal != tid && (backend & TERMINAL_SERIAL)) {
+        terminal[serial_terminal].backend &= ~TERMINAL_SERIAL;
+        if (terminal[serial_terminal].backend == 0) {
+            terminal[serial_terminal].backend = TERMINAL_VGA;
+        }
+    }
+    if (backend & TERMINAL_SERIAL) {
+        serial_terminal = tid;
+    } else if (serial_terminal == tid) {
+        serial_terminal = -1;
+    }
+    if ((backend & TERMINAL_VGA) && !(terminal[tid].backend & TERMINAL_VGA)) {
+        // 1 - every row of the screen is dirty, nothing was drawn while it was off
+        terminal[tid].dirty = (1U << NUM_ROWS) - 1;
+    }
+    terminal[tid].backend = backend;
+    restore_flags(flags);
+    return 0;
+}
+
+
+/*
+* terminal_line_entered
+*   DESCRIPTION: Hand the line in the keyboard buffer of a terminal to a reader
+*   INPUTS: tid - terminal id
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: an asynchronous read takes the line first and the buffer starts a new line,
+*                 otherwise terminal_read is woken up
+*/
+void terminal_line_entered(int32_t tid)
+{
+    if (aio_terminal_line(tid, (uint8_t*)terminal[tid].keyboard_buffer, terminal[tid].index) == 1) {
+        terminal[tid].index = 0;
+        return;
+    }
+    // 1 - enter key is pressed 
+    terminal[tid].enter_pressed = 1;
+}
+
+
+/*
+* terminal_input
+*   DESCRIPTION: Hand a character typed on the serial console to the line discipline of a terminal.
+*                Return is enter and delete is backspace, the escape sequences of the arrow, home, end,
+*                insert, delete and page keys become their keys, and ctrl + c interrupts the foreground
+*                program
+*   INPUTS: tid - terminal id
+*           c - the character
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void terminal_input(int32_t tid, uint8_t c)
+{
+    // ESC [ or ESC O, then the final byte, with a parameter for ESC [ 2 ~ - ESC [ 6 ~
+    static int32_t esc_state = ESC_NONE;
+    static int32_t esc_param = 0;
+
+    if (esc_state == ESC_START) {
+        esc_state = (c == '[' || c == 'O') ? ESC_CSI : ESC_NONE;
+        esc_param = 0;
+        return;
+    }
+    if (esc_state == ESC_CSI) {
+        if (c >= '0' && c <= '9') {
+            // 10 - decimal
+            esc_param = esc_param * 10 + (c - '0');
+            return;
+        }
+        esc_state = ESC_NONE;
+        if (c == 'A') {
+            ldisc_input(tid, KEY_UP);
+        } else if (c == 'B') {
+            ldisc_input(tid, KEY_DOWN);
+        } else if (c == 'C') {
+            ldisc_input(tid, KEY_RIGHT);
+        } else if (c == 'D') {
+            ldisc_input(tid, KEY_LEFT);
+        } else if (c == 'H') {
+            ldisc_input(tid, KEY_HOME);
+        } else if (c == 'F') {
+            ldisc_input(tid, KEY_END);
+        } else if (c == '~' && esc_param == 2) {
+            ldisc_input(tid, KEY_INSERT);
+        } else if (c == '~' && esc_param == 3) {
+            ldisc_input(tid, KEY_DELETE);
+        } else if (c == '~' && esc_param == 5) {
+            ldisc_input(tid, KEY_PAGE_UP);
+        } else if (c == '~' && esc_param == 6) {
+            ldisc_input(tid, KEY_PAGE_DOWN);
+        }
+        return;
+    }
+    if (c == ESC_CHAR) {
+        esc_state = ESC_START;
+        return;
+    }
+    // 3 - ctrl + c, the base shells are kept
+    if (c == 3) {
+        if (schedule[tid] >= num_terminals) {
+            signal_raise(schedule[tid], SIG_INTERRUPT);
+        }
+        return;
+    }
+    // 0x7F - delete, which most terminals send for the backspace key
+    if (c == '\r') {
+        c = '\n';
+    } else if (c == 0x7F) {
+        c = 8;
+    }
+    ldisc_input(tid, c);
+}
+
+
+/*
+* terminal_serial_input
+*   DESCRIPTION: Give the bytes received on the serial port to the terminal that has it, from the PIT
+*                tick. Without one they are dropped
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void terminal_serial_input(void)
+{
+    int32_t c;
+
+    while ((c = serial_getc()) != -1) {
+        if (serial_terminal != -1) {
+            terminal_input(serial_terminal, c);
+        }
     }
-    
-    // Return the number of bytes written
-    return ct;
 }
 
 
 /*
 * terminal_init
-*   DESCRIPTION: Initialize terminal driver
+*   DESCRIPTION: Initialize terminal driver, num_terminals of them
 *   INPUTS: none
 *   OUTPUTS: none
-*   RETURN VALUE: 0 for success
+*   RETURN VALUE: 0 for success, -1 if the kernel page pool has no room for the terminals
 *   SIDE EFFECTS: none
 */
 int terminal_init() 
 {
     int i;
+    int j;
     
-    // Loop through each terminal (three terminals in total)
-    for (i = 0; i < 3; i++) {
+    // the shadows make a terminal several pages, too big to keep one for every terminal there could be
+    terminal = kpage_alloc((num_terminals * sizeof(terminal_t) + PAGE_SIZE - 1) / PAGE_SIZE);
+    if (terminal == NULL) {
+        return -1;
+    }
+
+    // Loop through each terminal
+    for (i = 0; i < num_terminals; i++) {
         
         // Initialize various attributes of the terminal structure
         terminal[i].index = 0;              // 0 - starting position of keyboard buffer
         terminal[i].enter_pressed = 0;      // 0 - enter key is not pressed
         terminal[i].cursor_x = 0;           // 0 - starting position of cursor
         terminal[i].cursor_y = 0;           // 0 - starting position of cursor
+        // a blank screen, written out by the first flush
+        terminal[i].top = 0;
+        terminal[i].history = 0;
+        terminal[i].view = 0;
+        for (j = 0; j < SHADOW_ROWS * NUM_COLS; j++) {
+            terminal[i].shadow[j] = CELL(' ');
+        }
+        // 1 - every row of the screen is dirty
+        terminal[i].dirty = (1U << NUM_ROWS) - 1;
+        terminal[i].attrib = ATTRIB;
+        terminal[i].backend = TERMINAL_VGA;
+        terminal[i].write_busy = 0;
+        terminal[i].line_cursor = 0;
+        terminal[i].raw_pid = -1;
+        terminal[i].cmd_count = 0;
+        terminal[i].cmd_browse = 0;
+        for (j = 0; j <= LDISC_HISTORY; j++) {
+            terminal[i].cmd_history[j][0] = '\0';
+        }
+        terminal[i].esc_state = ESC_NONE;
+        terminal[i].saved_x = 0;
+        terminal[i].saved_y = 0;
         enable_cursor(0, 14);
         update_cursor(terminal[i].cursor_x, terminal[i].cursor_y);
     }
+    // 0 - show terminal 0 from the first page of video memory
+    set_screen_start(0);
     
     return 0;
 }
 
 
 /*
-* memory_switch
-*   DESCRIPTION: Set user video page when switching terminals
-*   INPUTS: switch_id - terminal id to switch to
+* terminal_flush
+*   DESCRIPTION: Copy the rows of a terminal that changed to its page of video memory, whether it is
+*                shown or not. Writes render into the shadow in RAM, so a write that scrolls many
+*                times still touches each row of video memory once
+*   INPUTS: tid - terminal id
 *   OUTPUTS: none
-*   RETURN VALUE: 0 for success
-*   SIDE EFFECTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: moves the hardware cursor if the terminal is visible
 */
-int32_t memory_switch(int32_t switch_id) 
+void terminal_flush(int32_t tid)
 {
-    // If terminal id to be switch to is current terminal id
-    if (switch_id == cur_terminal) {
+    uint32_t flags;
+    uint16_t* screen = TERMINAL_SCREEN(tid);
+    int32_t row;
 
-        // 12 - 4kB size
-        set_pte(page_table, VIDEO >> 12, VIDEO >> 12, 0);
+    cli_and_save(flags);
+    for (row = 0; row < NUM_ROWS; row++) {
+        if (terminal[tid].dirty & (1U << row)) {
+            memcpy(screen + row * NUM_COLS, VIEW_ROW(&terminal[tid], row), NUM_COLS * sizeof(uint16_t));
+        }
+    }
+    terminal[tid].dirty = 0;
+    if (tid == cur_terminal) {
+        // a cursor pushed below the screen by the view is off the screen, hidden
+        update_cursor(terminal[tid].cursor_x, terminal[tid].cursor_y + terminal[tid].view);
+    }
+    restore_flags(flags);
+}
 
-        // 0x003FF000 - take middle 10 bits
-		set_pte(user_video_page_table, (USER_VIDEO_ADDR & 0x003FF000) >> 12, VIDEO >> 12, 1);
-    } else {
 
-        // 12 - 4kB size
-        // 2 - offset of terminal video backup buffers
-        set_pte(page_table, VIDEO >> 12, (VIDEO >> 12) + 2 + switch_id, 0);
+/*
+* terminal_scroll_view
+*   DESCRIPTION: Move the screen of a terminal back or forward through its scrollback. The rows stay
+*                where they are in the ring, only the view changes
+*   INPUTS: tid - terminal id
+*           lines - rows to move back, negative to move toward the output
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the view stops at the oldest row kept and at the output
+*/
+void terminal_scroll_view(int32_t tid, int32_t lines)
+{
+    uint32_t flags;
+    int32_t view;
 
-        // 0x003FF000 - take middle 10 bits
-		set_pte(user_video_page_table, (USER_VIDEO_ADDR & 0x003FF000) >> 12, (VIDEO >> 12) + 2 + switch_id, 1);
+    cli_and_save(flags);
+    view = terminal[tid].view + lines;
+    if (view > terminal[tid].history) {
+        view = terminal[tid].history;
+    }
+    if (view < 0) {
+        view = 0;
     }
+    if (view != terminal[tid].view) {
+        terminal[tid].view = view;
+        // 1 - every row of the screen is dirty
+        terminal[tid].dirty = (1U << NUM_ROWS) - 1;
+        if (tid == cur_terminal) {
+            terminal_flush(tid);
+        }
+    }
+    restore_flags(flags);
+}
+
+
+/*
+* terminal_flush_all
+*   DESCRIPTION: Flush the output of processes on terminals that are not visible. Nobody sees their
+*                screens, so it is left to the PIT tick instead of every write
+*   INPUTS: none
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void terminal_flush_all(void)
+{
+    int32_t i;
+
+    for (i = 0; i < num_terminals; i++) {
+        if (i != cur_terminal && terminal[i].dirty != 0) {
+            terminal_flush(i);
+        }
+    }
+}
+
+
+/*
+* terminal_switch
+*   DESCRIPTION: Show another terminal. Every terminal renders into its own page of video memory, so
+*                the switch points the CRTC start address at that page instead of copying screens
+*   INPUTS: switch_id - terminal id to show
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: moves the hardware cursor to the cursor of the terminal
+*/
+void terminal_switch(int32_t switch_id)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cur_terminal = switch_id;
+    // 2 - bytes per cell
+    set_screen_start(switch_id * (PAGE_SIZE / 2));
+    // rows left for the PIT tick and the cursor
+    terminal_flush(switch_id);
+    restore_flags(flags);
+}
+
+
+/*
+* memory_switch
+*   DESCRIPTION: Point the video memory of user programs (vidmap) at the page of a terminal, when a
+*                process of that terminal is scheduled
+*   INPUTS: switch_id - terminal id of the running process
+*   OUTPUTS: none
+*   RETURN VALUE: 0 for success
+*   SIDE EFFECTS: none
+*/
+int32_t memory_switch(int32_t switch_id) 
+{
+    // 12 - 4kB size
+    // 0x003FF000 - take middle 10 bits
+    set_pte(user_video_page_table, (USER_VIDEO_ADDR & 0x003FF000) >> 12, (uint32_t)TERMINAL_SCREEN(switch_id) >> 12, 1);
 
-    // Update cr3 after setting page table and user video page table
+    // Update cr3 after setting the user video page table
     flush_tlb();
     
     return 0;
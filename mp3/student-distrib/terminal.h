@@ -11,13 +11,59 @@
 #include "types.h"
 #include "lib.h"
 #include "keyboard.h"
+#include "page.h"
+#include "ldisc.h"
+
+#define SCROLLBACK_ROWS 200         // lines kept above the screen of each terminal, shown with shift+PgUp
+#define SHADOW_ROWS (NUM_ROWS + SCROLLBACK_ROWS)
+// the page of video memory terminal tid renders into, shown while it is the current terminal
+#define TERMINAL_SCREEN(tid) ((uint16_t*)(VIDEO + (tid) * PAGE_SIZE))
+
+// backends of a terminal, its output goes to each one set
+#define TERMINAL_VGA 0x1            // the screen
+#define TERMINAL_SERIAL 0x2         // the serial console, which also gives the terminal input
+
+#define ESC_CHAR 0x1B               // starts an escape sequence
+#define ESC_PARAMS_MAX 8            // numeric parameters kept for one escape sequence
+// states of the escape sequence parser
+#define ESC_NONE 0                  // text
+#define ESC_START 1                 // after ESC
+#define ESC_CSI 2                   // after ESC [, reading parameters up to the final byte
+#define ESC_IGNORE 3                // a CSI sequence with a private marker, skipped up to the final byte
+
+// a screen cell, the character in the low byte and its attribute in the high byte
+#define CELL_ATTR(c, a) ((uint16_t)(uint8_t)(c) | ((uint16_t)(uint8_t)(a) << 8))
+#define CELL(c) CELL_ATTR(c, ATTRIB)
+// the cells of row y of the output of terminal t, the shadow is a ring of rows whose row top is the
+// top of the screen and whose rows above it are the scrollback
+#define SHADOW_ROW(t, y) ((t)->shadow + ((((t)->top + (y)) % SHADOW_ROWS) * NUM_COLS))
+// the cells shown in screen row y of terminal t, view rows back in the scrollback
+#define VIEW_ROW(t, y) SHADOW_ROW(t, (y) + SHADOW_ROWS - (t)->view)
 
 typedef struct terminal_t {    
-    char keyboard_buffer[128];      // 128 - maximum charater number from keyboard
+    char keyboard_buffer[LDISC_LINE];   // the line being typed, the keys typed in raw mode
     volatile int enter_pressed;     // If enter_pressed, read from terminal
     int cursor_x;                   // x location of the cursor
     int cursor_y;                   // y location of the cursor
-    int index;                      // Next buffer location to put the new character
+    volatile int index;             // Next buffer location to put the new character, the length of the line
+    int line_cursor;                // position of the cursor in the line being typed
+    int raw_pid;                    // process that put the terminal in raw mode, -1 in cooked mode
+    char cmd_history[LDISC_HISTORY + 1][LDISC_LINE];    // the lines entered, a ring with a spare slot for the line being typed
+    int cmd_count;                  // lines ever put in the history
+    int cmd_browse;                 // lines back in the history the line being typed came from, 0 for a new line
+    uint16_t shadow[SHADOW_ROWS * NUM_COLS];    // the screen and its scrollback rendered in RAM, copied to video memory by terminal_flush
+    int top;                        // row of shadow at the top of the output, scrolling moves it down one
+    int history;                    // rows of scrollback above top, up to SCROLLBACK_ROWS
+    int view;                       // rows the screen shows back in the scrollback, 0 to show the output
+    uint32_t dirty;                 // bit r - screen row r has changed since the last flush
+    uint8_t attrib;                 // attribute of the cells written, set by ESC [ ... m
+    int esc_state;                  // ESC_NONE unless the output is inside an escape sequence
+    int esc_count;                  // index of the parameter being read
+    int esc_params[ESC_PARAMS_MAX]; // parameters of the escape sequence, 0 when left out
+    int saved_x;                    // cursor saved by ESC [ s
+    int saved_y;
+    uint8_t backend;                // TERMINAL_VGA / TERMINAL_SERIAL - where the output goes
+    volatile int write_busy;        // 1 - a process is writing, other writers wait for the whole write
 } terminal_t;
 
 // Open terminal driver
@@ -32,13 +78,50 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 // Write to terminal
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
 
+// Write a vector of buffers to terminal
+int32_t terminal_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+// Check for an entered line
+int32_t terminal_poll(int32_t fd);
+
 // Initialize terminal driver
 int32_t terminal_init();
 
-// Switch to terminal[switch_id] from terminal[cur_terminal]
+// Map the video memory of user programs to the page of terminal[switch_id]
 int32_t memory_switch(int32_t switch_id);
 
-extern terminal_t terminal[3];      // Terminal window
+// Show terminal[switch_id] instead of terminal[cur_terminal]
+void terminal_switch(int32_t switch_id);
+
+// Copy the changed rows of a terminal to its screen
+void terminal_flush(int32_t tid);
+
+// Take the number of terminals from "terminals=N" on the boot command line, before terminal_init
+void terminal_set_count(const int8_t* cmdline);
+
+// Put terminal N on the serial console for "serial=N" on the boot command line
+void terminal_set_serial(const int8_t* cmdline);
+
+// Send the output of a terminal to the screen, the serial console or both
+int32_t terminal_set_backend(int32_t tid, uint8_t backend);
+
+// Hand the line typed into terminal[tid] to a reader
+void terminal_line_entered(int32_t tid);
+
+// Type a character from the serial console into terminal[tid]
+void terminal_input(int32_t tid, uint8_t c);
+
+// Give the input of the serial console to its terminal, from the PIT tick
+void terminal_serial_input(void);
+
+// Flush the terminals that are not visible, from the PIT tick
+void terminal_flush_all(void);
+
+// Move the view of a terminal lines rows back in its scrollback, negative to move forward
+void terminal_scroll_view(int32_t tid, int32_t lines);
+
+extern terminal_t* terminal;        // Terminal windows, num_terminals of them
 extern int32_t cur_terminal;        // Current terminal id
+extern int32_t serial_terminal;     // Terminal on the serial console, -1 if none
 
 #endif /* terminal_h */
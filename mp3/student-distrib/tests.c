@@ -8,6 +8,16 @@
 #include "cursor.h"
 #include "filesystem.h"    
 #include "system_calls.h"
+#include "ata.h"
+#include "loader.h"
+#include "pipe.h"
+#include "assembly_linkage.h"
+#include "trace.h"
+#include "aio.h"
+#include "fdtable.h"
+#include "page.h"
+#include "serial.h"
+#include "ldisc.h"
 
 #define PASS 1
 #define FAIL 0
@@ -795,6 +805,887 @@ int close_test()
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
 
+/* Extension tests */
+
+/*
+* ata_read_test
+* Reads the boot block straight from the ATA disk and compares it with the mounted file system
+* Returns PASS if the disk holds the same directory entries, or if there is no disk because the
+* file system came from the GRUB module.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int ata_read_test()
+{
+	TEST_HEADER;
+	boot_block_t boot_block;
+	dentry_t dentry;
+	int32_t i;
+
+	// 0 - ata_init found no drive, nothing to compare
+	if (ata_sector_count() == 0) {
+		return PASS;
+	}
+	// 8 - sectors in one 4KB block
+	if (ata_read_sectors(0, BLOCK_SIZE / ATA_SECTOR_SIZE, (uint8_t*)&boot_block) != BLOCK_SIZE / ATA_SECTOR_SIZE) {
+		return FAIL;
+	}
+	for (i = 0; i < boot_block.num_dir_entries; i++) {
+		if (read_dentry_by_index(i, &dentry) == -1 || dentry.inode_num != boot_block.dir_entries[i].inode_num) {
+			return FAIL;
+		}
+	}
+	return PASS;
+}
+
+
+/*
+* image_cache_test
+* Loads an executable twice and a text file once through the image cache
+* Returns PASS if the second load hits the cache and the text file is rejected.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int image_cache_test()
+{
+	TEST_HEADER;
+	dentry_t dentry;
+	program_image_t* first;
+	program_image_t* second;
+	int result = PASS;
+
+	if (read_dentry_by_name((uint8_t*)"hello", &dentry) == -1) {
+		return FAIL;
+	}
+	first = image_get(dentry.inode_num);
+	second = image_get(dentry.inode_num);
+	if (first == NULL || first != second || first->entry_point < USER_IMAGE) {
+		result = FAIL;
+	}
+	image_put(first);
+	image_put(second);
+
+	if (read_dentry_by_name((uint8_t*)"frame0.txt", &dentry) == -1 || image_get(dentry.inode_num) != NULL) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* elf_segment_test
+* Checks the PT_LOAD segments parsed from an executable
+* Returns PASS if the entry point is in a read-only segment and every segment lies in the program region.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int elf_segment_test()
+{
+	TEST_HEADER;
+	dentry_t dentry;
+	program_image_t* image;
+	elf32_phdr_t* seg;
+	uint32_t i;
+	int result = FAIL;
+
+	if (read_dentry_by_name((uint8_t*)"hello", &dentry) == -1 || (image = image_get(dentry.inode_num)) == NULL) {
+		return FAIL;
+	}
+	for (i = 0; i < image->num_segments; i++) {
+		seg = &image->segments[i];
+		if (seg->vaddr < USER_ADDR || seg->vaddr + seg->memsz > USER_STACK_ADDR || seg->filesz > seg->memsz) {
+			result = FAIL;
+			break;
+		}
+		if (image->entry_point >= seg->vaddr && image->entry_point < seg->vaddr + seg->memsz && !(seg->flags & PF_W)) {
+			result = PASS;
+		}
+	}
+	image_put(image);
+	return result;
+}
+
+/*
+* image_map_test
+* Maps an executable into the program region of an unused process and checks it page by page
+* Returns PASS if the text is readable but not writable, the stack is writable, the page below the
+* program is a hole, and nothing stays mapped once the pages are freed.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: leaves the program region on the empty table of the last process
+*/
+int image_map_test()
+{
+	TEST_HEADER;
+	dentry_t dentry;
+	program_image_t* image;
+	int result = PASS;
+
+	if (read_dentry_by_name((uint8_t*)"hello", &dentry) == -1 || (image = image_get(dentry.inode_num)) == NULL) {
+		return FAIL;
+	}
+	// the last process id is free while the tests run at boot
+	if (image_map(image, PROCESS_MAX - 1) == -1) {
+		image_put(image);
+		return FAIL;
+	}
+	if (!user_range_ok((void*)image->entry_point, 4, 0) || user_range_ok((void*)image->entry_point, 4, 1)) {
+		result = FAIL;
+	}
+	if (!user_range_ok((void*)(USER_STACK_ADDR - PAGE_SIZE), PAGE_SIZE, 1) || user_range_ok((void*)USER_ADDR, 4, 0)) {
+		result = FAIL;
+	}
+	image_unmap(PROCESS_MAX - 1);
+	flush_tlb();
+	if (user_range_ok((void*)(USER_STACK_ADDR - PAGE_SIZE), PAGE_SIZE, 0)) {
+		result = FAIL;
+	}
+	image_put(image);
+	return result;
+}
+
+/*
+* terminal_writev_test
+* Writes a line made of three buffers to the terminal with one call
+* Returns PASS if every byte of the vector is written.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: prints "writev: ok" to the screen
+*/
+int terminal_writev_test()
+{
+	TEST_HEADER;
+	iovec_t iov[3];
+
+	iov[0].base = "writev";
+	iov[0].len = 6;
+	iov[1].base = ": ";
+	iov[1].len = 2;
+	iov[2].base = "ok\n";
+	iov[2].len = 3;
+	if (terminal_writev(1, iov, 3) != 11) {
+		return FAIL;
+	}
+	return PASS;
+}
+
+/*
+* pipe_pool_test
+* Allocates every pipe, then frees them
+* Returns PASS if allocation fails only once the pool is exhausted and freed pipes can be reused.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int pipe_pool_test()
+{
+	TEST_HEADER;
+	int32_t ids[PIPE_MAX];
+	int32_t i;
+	int result = PASS;
+
+	for (i = 0; i < PIPE_MAX; i++) {
+		if ((ids[i] = pipe_create()) == -1) {
+			result = FAIL;
+		}
+	}
+	if (pipe_create() != -1) {
+		result = FAIL;
+	}
+	for (i = 0; i < PIPE_MAX; i++) {
+		pipe_release(ids[i]);
+	}
+	if ((i = pipe_create()) == -1) {
+		result = FAIL;
+	}
+	pipe_release(i);
+	return result;
+}
+
+/*
+* sysenter_msr_test
+* Reads back the sysenter MSRs
+* Returns PASS if they hold the kernel code segment, &tss.esp0 and the sysenter linkage.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int sysenter_msr_test()
+{
+	TEST_HEADER;
+	uint32_t lo, hi;
+	int result = PASS;
+
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(MSR_SYSENTER_CS));
+	if (lo != KERNEL_CS) {
+		result = FAIL;
+	}
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(MSR_SYSENTER_ESP));
+	if (lo != (uint32_t)&tss.esp0) {
+		result = FAIL;
+	}
+	asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(MSR_SYSENTER_EIP));
+	if (lo != (uint32_t)sysenter_handler_linkage) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* sysenter_frame_test
+* Hands sysenter_frame stack pointers the caller cannot read
+* Returns PASS if a kernel address and the top of the program region are refused and the frame is untouched.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int sysenter_frame_test()
+{
+	TEST_HEADER;
+	hw_context context;
+	uint32_t ret_addr = 0x8048000;
+	int result = PASS;
+
+	context.ret_addr = 0;
+	context.esp = (uint32_t)&ret_addr;
+	if (sysenter_frame(&context) != -1 || context.ret_addr != 0 || context.esp != (uint32_t)&ret_addr) {
+		result = FAIL;
+	}
+	// 2 - the return address would straddle the end of the program region
+	context.esp = USER_STACK_ADDR - 2;
+	if (sysenter_frame(&context) != -1 || context.ret_addr != 0) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* trace_log_test
+* Traces one call by hand and reads it back
+* Returns PASS if the entry and the histogram hold the call, reading consumes the entry and systrace
+* refuses a kernel buffer.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: Clears the trace and leaves tracing off
+*/
+int trace_log_test()
+{
+	TEST_HEADER;
+	trace_entry_t entries[2];
+	uint32_t hist[TRACE_SYSCALLS][TRACE_BUCKETS];
+	uint32_t i, total;
+	int result = PASS;
+
+	systrace(TRACE_ON, NULL, 0);
+	// 3 - read
+	trace_begin(3, 1, 2, 3);
+	trace_end(5);
+	systrace(TRACE_OFF, NULL, 0);
+
+	// the system call only copies into memory of the caller's program region
+	if (systrace(TRACE_READ, entries, sizeof(entries)) != -1 || systrace(TRACE_HIST, hist, sizeof(hist)) != -1) {
+		result = FAIL;
+	}
+	if (trace_read(TRACE_READ, entries, sizeof(entries)) != sizeof(trace_entry_t)) {
+		result = FAIL;
+	} else if (entries[0].num != 3 || entries[0].args[1] != 2 || entries[0].ret != 5) {
+		result = FAIL;
+	}
+	if (trace_read(TRACE_READ, entries, sizeof(entries)) != 0) {
+		result = FAIL;
+	}
+	if (trace_read(TRACE_HIST, hist, sizeof(hist)) != sizeof(hist)) {
+		result = FAIL;
+	}
+	total = 0;
+	for (i = 0; i < TRACE_BUCKETS; i++) {
+		total += hist[3][i];
+	}
+	if (total != 1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* aio_idle_test
+* Delivers a line and an RTC tick with no asynchronous reads pending
+* Returns PASS if the line is left to terminal_read.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int aio_idle_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+
+	if (aio_terminal_line(0, (uint8_t*)"ls\n", 3) != 0) {
+		result = FAIL;
+	}
+	aio_rtc_tick(0);
+	return result;
+}
+
+/*
+* poll_hook_test
+* Checks the poll operations of files and the terminal, and poll's argument checks
+* Returns PASS if files are always ready, the terminal is writable and bad arguments fail.
+* Inputs: None
+* Outputs: PASS/FAIL
+* Side Effects: None
+*/
+int poll_hook_test()
+{
+	TEST_HEADER;
+	pollfd_t fds[1];
+	int result = PASS;
+
+	if (file_poll(2) != (POLLIN | POLLOUT)) {
+		result = FAIL;
+	}
+	if (!(terminal_poll(0) & POLLOUT)) {
+		result = FAIL;
+	}
+	// kernel addresses are not user buffers
+	if (poll(NULL, 1, 0) != -1 || poll(fds, 1, 0) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* signal_frame_test
+*   DESCRIPTION: check the hw_context matches the frame the linkages push and that signals are only
+*                delivered on the way back to user mode
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: none
+*/
+int signal_frame_test()
+{
+	TEST_HEADER;
+	hw_context context;
+	int result = PASS;
+
+	// 17 - words pushed by the linkages and the processor
+	if (sizeof(hw_context) != 17 * 4) {
+		result = FAIL;
+	}
+	context.cs = KERNEL_CS;
+	if (do_signal(&context) != 0) {
+		result = FAIL;
+	}
+	if (set_handler(-1, NULL) != -1 || set_handler(SIGNAL_NUM, NULL) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* timer_wheel_test
+*   DESCRIPTION: start and stop timers in different levels of the timer wheel
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: none
+*/
+static void timer_test_func(uint32_t data) {}
+int timer_wheel_test()
+{
+	TEST_HEADER;
+	ktimer_t near, far;
+	int result = PASS;
+
+	timer_init(&near, timer_test_func, 0);
+	timer_init(&far, timer_test_func, 0);
+	if (timer_pending(&near) || timer_del(&near) != 0) {
+		result = FAIL;
+	}
+	// 100 - in the root level, 0x7FFFFFFF - beyond the wheel, clamped
+	timer_add(&near, pit_ticks + 100);
+	timer_add(&far, pit_ticks + 0x7FFFFFFF);
+	if (!timer_pending(&near) || !timer_pending(&far) || far.expires - pit_ticks > TIMER_MAX_TICKS) {
+		result = FAIL;
+	}
+	if (timer_del(&far) != 1 || timer_pending(&far) || !timer_pending(&near)) {
+		result = FAIL;
+	}
+	if (timer_del(&near) != 1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* spawn_wait_test
+*   DESCRIPTION: check that spawn and waitpid reject bad arguments
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: none
+*/
+int spawn_wait_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+
+	if (spawn(NULL) != -1 || spawn((uint8_t*)"a | | b") != -1) {
+		result = FAIL;
+	}
+	// 2 - not a waitpid option
+	if (waitpid(-2, NULL, 0) != -1 || waitpid(PROCESS_MAX, NULL, 0) != -1 || waitpid(-1, NULL, 2) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* fd_table_test
+*   DESCRIPTION: check that the file descriptor table hands out the lowest free descriptor, grows past
+*                the inline entries, and that dup and dup2 reject bad descriptors
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: none
+*/
+int fd_table_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	static pcb fake;
+	int32_t i;
+
+	fd_table_init(&fake);
+	for (i = 0; i <= FD_INLINE; i++) {
+		if (fd_alloc(&fake) != i) {
+			result = FAIL;
+		}
+	}
+	// the entry after the inline ones moved the table to the page pool
+	if (fake.fd_pages != 1 || fake.fd_capacity <= FD_INLINE || fake.file_descriptor_array == fake.fd_inline) {
+		result = FAIL;
+	}
+	// 3 - a hole below the others is filled first
+	fd_free(&fake, 3);
+	if (fd_alloc(&fake) != 3 || fd_claim(&fake, FD_MAX) != -1) {
+		result = FAIL;
+	}
+	fd_table_release(&fake);
+	if (fake.fd_pages != 0 || fake.fd_capacity != FD_INLINE || fd_alloc(&fake) != 0) {
+		result = FAIL;
+	}
+
+	if (dup(-1) != -1 || dup(FD_MAX) != -1 || dup2(0, -1) != -1 || dup2(0, FD_MAX) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* terminal_shadow_test
+*   DESCRIPTION: check that output is rendered into the shadow screen and that a write to the visible
+*                terminal is flushed to video memory before it returns
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: clears the screen
+*/
+int terminal_shadow_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	uint16_t* screen = TERMINAL_SCREEN(cur_terminal);
+	int32_t i;
+	int32_t top;
+
+	clear();
+	top = terminal[cur_terminal].top;
+	putbuf((uint8_t*)"ab\n", 3, 1);
+	if (SHADOW_ROW(&terminal[cur_terminal], 0)[0] != CELL('a') || SHADOW_ROW(&terminal[cur_terminal], 0)[1] != CELL('b') ||
+		terminal[cur_terminal].dirty != 0 || screen[0] != CELL('a') || screen[1] != CELL('b')) {
+		result = FAIL;
+	}
+	// the first line scrolls off by moving the top of the ring, attributes move with the characters
+	for (i = 1; i < NUM_ROWS; i++) {
+		putbuf((uint8_t*)"\n", 1, 1);
+	}
+	if (SHADOW_ROW(&terminal[cur_terminal], 0)[0] != CELL(' ') || screen[0] != CELL(' ') ||
+		terminal[cur_terminal].top != (top + 1) % SHADOW_ROWS || terminal[cur_terminal].cursor_y != NUM_ROWS - 1) {
+		result = FAIL;
+	}
+	clear();
+	return result;
+}
+
+/*
+* scrollback_test
+*   DESCRIPTION: check that a line scrolled off the screen can be viewed again and that typing
+*                returns to the output
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: clears the screen
+*/
+int scrollback_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	uint16_t* screen = TERMINAL_SCREEN(cur_terminal);
+	int32_t i;
+
+	clear();
+	putbuf((uint8_t*)"x", 1, 1);
+	for (i = 0; i < NUM_ROWS; i++) {
+		putbuf((uint8_t*)"\n", 1, 1);
+	}
+	// the line with x is the newest line of the scrollback
+	if (screen[0] == CELL('x') || terminal[cur_terminal].history < 1) {
+		result = FAIL;
+	}
+	terminal_scroll_view(cur_terminal, 1);
+	if (terminal[cur_terminal].view != 1 || screen[0] != CELL('x')) {
+		result = FAIL;
+	}
+	// the view stops at the oldest row kept
+	terminal_scroll_view(cur_terminal, SHADOW_ROWS);
+	if (terminal[cur_terminal].view != terminal[cur_terminal].history) {
+		result = FAIL;
+	}
+	putbuf((uint8_t*)"y", 1, 1);
+	if (terminal[cur_terminal].view != 0 || screen[0] == CELL('x')) {
+		result = FAIL;
+	}
+	clear();
+	return result;
+}
+
+/* write a string to the running terminal */
+static void put_string(const char* s)
+{
+	putbuf((const uint8_t*)s, strlen((const int8_t*)s), 0);
+}
+
+/*
+* ansi_escape_test
+*   DESCRIPTION: check cursor movement, erasing and colors through escape sequences, including one
+*                split across writes
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: clears the screen
+*/
+int ansi_escape_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	terminal_t* t = &terminal[run_terminal];
+
+	// ESC [ 2 J ESC [ 3 ; 5 H - clear the screen and go to row 3, column 5
+	put_string("\033[2J\033[3;5H");
+	if (t->cursor_y != 2 || t->cursor_x != 4) {
+		result = FAIL;
+	}
+	// ESC [ 31 m - red on the default background, 4 - VGA red
+	put_string("\033[3");
+	put_string("1mR\033[0mW");
+	if (SHADOW_ROW(t, 2)[4] != CELL_ATTR('R', (ATTRIB & 0xF0) | 4) || SHADOW_ROW(t, 2)[5] != CELL('W') ||
+		t->attrib != ATTRIB || t->esc_state != ESC_NONE) {
+		result = FAIL;
+	}
+	// ESC [ 2 D ESC [ K - back two columns and erase to the end of the row
+	put_string("\033[2D\033[K");
+	if (t->cursor_x != 4 || SHADOW_ROW(t, 2)[4] != CELL(' ') || SHADOW_ROW(t, 2)[5] != CELL(' ')) {
+		result = FAIL;
+	}
+	clear();
+	return result;
+}
+
+/*
+* terminal_switch_test
+*   DESCRIPTION: check that switching terminals only moves the start address, so the cursor of the
+*                shown terminal lands in its own page of video memory
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: switches to terminal 1 and back to terminal 0
+*/
+int terminal_switch_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	// 2 - bytes per cell
+	uint16_t page_cells = PAGE_SIZE / 2;
+
+	terminal_switch(1);
+	if (cur_terminal != 1 || get_cursor_position() != page_cells + terminal[1].cursor_y * NUM_COLS + terminal[1].cursor_x) {
+		result = FAIL;
+	}
+	terminal_switch(0);
+	if (cur_terminal != 0 || get_cursor_position() >= page_cells) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* terminal_count_test
+*   DESCRIPTION: check that "terminals=N" on the boot command line sets the number of terminals,
+*                kept within the terminals there is room for
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: none, the number of terminals is put back
+*/
+int terminal_count_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	int32_t saved = num_terminals;
+
+	terminal_set_count((int8_t*)"root=hd0 terminals=2 quiet");
+	if (num_terminals != 2) {
+		result = FAIL;
+	}
+	terminal_set_count((int8_t*)"terminals=99");
+	if (num_terminals > TERMINAL_MAX || num_terminals >= PROCESS_MAX) {
+		result = FAIL;
+	}
+	// 0 and a missing count leave it as it is
+	num_terminals = 2;
+	terminal_set_count((int8_t*)"terminals=0");
+	terminal_set_count((int8_t*)"quiet");
+	if (num_terminals != 2) {
+		result = FAIL;
+	}
+	num_terminals = saved;
+	return result;
+}
+
+/*
+* serial_backend_test
+*   DESCRIPTION: check that a terminal takes the serial console only with a UART, that one terminal
+*                has it at a time, and that typing on it fills the keyboard buffer of that terminal
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: terminal 0 is put back on the screen only
+*/
+int serial_backend_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	const uint8_t* typed = (const uint8_t*)"ab\x7f" "c";
+	int32_t i;
+
+	if (terminal_set_backend(num_terminals, TERMINAL_VGA) != -1 || terminal_set_backend(0, 0) != -1) {
+		result = FAIL;
+	}
+	if (serial_present() == 0) {
+		if (terminal_set_backend(0, TERMINAL_SERIAL) != -1) {
+			result = FAIL;
+		}
+		return result;
+	}
+	if (terminal_set_backend(0, TERMINAL_VGA | TERMINAL_SERIAL) != 0 || serial_terminal != 0) {
+		result = FAIL;
+	}
+	// delete erases the b
+	terminal[0].index = 0;
+	terminal[0].line_cursor = 0;
+	for (i = 0; i < 4; i++) {
+		terminal_input(0, typed[i]);
+	}
+	if (terminal[0].index != 2 || terminal[0].keyboard_buffer[0] != 'a' || terminal[0].keyboard_buffer[1] != 'c') {
+		result = FAIL;
+	}
+	terminal[0].index = 0;
+	terminal[0].line_cursor = 0;
+	if (num_terminals > 1) {
+		terminal_set_backend(1, TERMINAL_SERIAL);
+		if (serial_terminal != 1 || terminal[0].backend != TERMINAL_VGA) {
+			result = FAIL;
+		}
+		terminal_set_backend(1, TERMINAL_VGA);
+	}
+	terminal_set_backend(0, TERMINAL_VGA);
+	if (serial_terminal != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* line_discipline_test
+*   DESCRIPTION: check editing in the middle of a line, the history, tab completion and raw mode on the
+*                running terminal
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: adds "xz" to the history of the terminal
+*/
+int line_discipline_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	terminal_t* t = &terminal[run_terminal];
+	const uint8_t* keys = (const uint8_t*)"xyz";
+	uint8_t buf[LDISC_LINE];
+	int32_t i;
+
+	t->index = 0;
+	t->line_cursor = 0;
+	for (i = 0; i < 3; i++) {
+		ldisc_input(run_terminal, keys[i]);
+	}
+	// left, backspace - the y goes, the cursor stays before the z
+	ldisc_input(run_terminal, KEY_LEFT);
+	ldisc_input(run_terminal, 8);
+	if (t->index != 2 || t->line_cursor != 1 || strncmp(t->keyboard_buffer, "xz", 2) != 0) {
+		result = FAIL;
+	}
+	ldisc_input(run_terminal, '\n');
+	if (terminal_read(0, buf, LDISC_LINE) != 3 || strncmp((int8_t*)buf, "xz\n", 3) != 0) {
+		result = FAIL;
+	}
+	// up brings the line back
+	ldisc_input(run_terminal, KEY_UP);
+	if (t->index != 2 || strncmp(t->keyboard_buffer, "xz", 2) != 0) {
+		result = FAIL;
+	}
+	ldisc_input(run_terminal, KEY_DOWN);
+	if (t->index != 0) {
+		result = FAIL;
+	}
+	// "fram" is only the start of frame0.txt and frame1.txt in the file system image
+	for (i = 0; i < 4; i++) {
+		ldisc_input(run_terminal, "fram"[i]);
+	}
+	ldisc_input(run_terminal, '\t');
+	if (t->index != 5 || strncmp(t->keyboard_buffer, "frame", 5) != 0) {
+		result = FAIL;
+	}
+	t->index = 0;
+	t->line_cursor = 0;
+	putc('\n', 0);
+	// raw mode returns keys without enter
+	ldisc_set_mode(run_terminal, TERM_RAW);
+	ldisc_input(run_terminal, 'q');
+	ldisc_input(run_terminal, KEY_UP);
+	if (terminal_read(0, buf, LDISC_LINE) != 2 || buf[0] != 'q' || buf[1] != KEY_UP) {
+		result = FAIL;
+	}
+	if (ldisc_set_mode(run_terminal, TERM_COOKED) != TERM_RAW) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/*
+* keyboard_ring_test
+*   DESCRIPTION: check that scan codes queued like the keyboard interrupt does are decoded in order by
+*                keyboard_drain, and that a full ring drops scan codes instead of overwriting them
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: empties the keyboard buffer of the terminal on the screen
+*/
+int keyboard_ring_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	terminal_t* t = &terminal[cur_terminal];
+	uint32_t flags;
+	int32_t i;
+
+	// the PIT tick drains the ring too, keep it out until the checks are done
+	cli_and_save(flags);
+	t->index = 0;
+	t->line_cursor = 0;
+	// 0x1E / 0x9E - a pressed / released, 0x2E - c pressed
+	if (keyboard_put(0x1E) != 0 || keyboard_put(0x9E) != 0 || keyboard_put(0x2E) != 0) {
+		result = FAIL;
+	}
+	keyboard_drain();
+	if (t->index != 2 || t->keyboard_buffer[0] != 'a' || t->keyboard_buffer[1] != 'c') {
+		result = FAIL;
+	}
+	// releases of a only, decoding them does nothing
+	for (i = 0; i < SCAN_RING_SIZE; i++) {
+		if (keyboard_put(0x9E) != 0) {
+			result = FAIL;
+		}
+	}
+	if (keyboard_put(0x9E) != -1) {
+		result = FAIL;
+	}
+	keyboard_drain();
+	if (t->index != 2) {
+		result = FAIL;
+	}
+	t->index = 0;
+	t->line_cursor = 0;
+	restore_flags(flags);
+	putc('\n', 0);
+	return result;
+}
+
+/*
+* keyboard_map_test
+*   DESCRIPTION: check the key maps: shift and caps lock on letters and symbols, a gray arrow with the
+*                shift the keyboard fakes around it, the keypad with and without num lock, and ctrl + a
+*                letter as a control character in raw mode
+*   INPUTS: none
+*   OUTPUTS: PASS/FAIL
+*   SIDE EFFECTS: empties the keyboard buffer of the terminal on the screen
+*/
+int keyboard_map_test()
+{
+	TEST_HEADER;
+	int result = PASS;
+	terminal_t* t = &terminal[cur_terminal];
+	// shift 1 - '!', caps lock, a - 'A', shift a - 'a', caps lock off,
+	// E0 2A E0 4B E0 CB E0 AA - gray left between a fake shift press and release,
+	// keypad 7 without num lock - home, num lock, keypad 7 - '7', num lock off
+	static const uint8_t scan_codes[] = {
+		0x2A, 0x02, 0x82, 0xAA,
+		0x3A, 0xBA, 0x1E, 0x9E, 0x2A, 0x1E, 0x9E, 0xAA, 0x3A, 0xBA,
+		0xE0, 0x2A, 0xE0, 0x4B, 0xE0, 0xCB, 0xE0, 0xAA,
+		0x47, 0xC7, 0x45, 0xC5, 0x47, 0xC7, 0x45, 0xC5
+	};
+	uint8_t buf[LDISC_LINE];
+	uint32_t flags;
+	uint32_t i;
+
+	// the PIT tick drains the ring too, keep it out until the checks are done
+	cli_and_save(flags);
+	t->index = 0;
+	t->line_cursor = 0;
+	for (i = 0; i < sizeof(scan_codes); i++) {
+		keyboard_put(scan_codes[i]);
+		keyboard_drain();
+	}
+	// "!Aa", left, home, then 7 at the start
+	if (t->index != 4 || t->line_cursor != 1 || strncmp(t->keyboard_buffer, "7!Aa", 4) != 0) {
+		result = FAIL;
+	}
+	if (key_modifiers != 0 || key_locks != 0) {
+		result = FAIL;
+	}
+	t->index = 0;
+	t->line_cursor = 0;
+	restore_flags(flags);
+	putc('\n', 0);
+
+	// ctrl + a - 1, then a once ctrl is released
+	ldisc_set_mode(cur_terminal, TERM_RAW);
+	cli_and_save(flags);
+	keyboard_put(0x1D);
+	keyboard_put(0x1E);
+	keyboard_put(0x9E);
+	keyboard_put(0x9D);
+	keyboard_put(0x1E);
+	keyboard_put(0x9E);
+	keyboard_drain();
+	restore_flags(flags);
+	if (terminal_read(0, buf, LDISC_LINE) != 2 || buf[0] != 1 || buf[1] != 'a') {
+		result = FAIL;
+	}
+	ldisc_set_mode(cur_terminal, TERM_COOKED);
+	return result;
+}
 
 /* Test suite entry point */
 void launch_tests(){
@@ -838,5 +1729,31 @@ void launch_tests(){
 	// TEST_OUTPUT("write_test", write_test());
 	// TEST_OUTPUT("open_test", open_test());
 	// TEST_OUTPUT("close_test", close_test());
+
+	/* extension tests */
+	// TEST_OUTPUT("ata_read_test", ata_read_test());
+	// TEST_OUTPUT("image_cache_test", image_cache_test());
+	// TEST_OUTPUT("elf_segment_test", elf_segment_test());
+	// TEST_OUTPUT("image_map_test", image_map_test());
+	// TEST_OUTPUT("terminal_writev_test", terminal_writev_test());
+	// TEST_OUTPUT("pipe_pool_test", pipe_pool_test());
+	// TEST_OUTPUT("sysenter_msr_test", sysenter_msr_test());
+	// TEST_OUTPUT("sysenter_frame_test", sysenter_frame_test());
+	// TEST_OUTPUT("trace_log_test", trace_log_test());
+	// TEST_OUTPUT("aio_idle_test", aio_idle_test());
+	// TEST_OUTPUT("poll_hook_test", poll_hook_test());
+	// TEST_OUTPUT("signal_frame_test", signal_frame_test());
+	// TEST_OUTPUT("timer_wheel_test", timer_wheel_test());
+	// TEST_OUTPUT("spawn_wait_test", spawn_wait_test());
+	// TEST_OUTPUT("fd_table_test", fd_table_test());
+	// TEST_OUTPUT("terminal_shadow_test", terminal_shadow_test());
+	// TEST_OUTPUT("scrollback_test", scrollback_test());
+	// TEST_OUTPUT("ansi_escape_test", ansi_escape_test());
+	// TEST_OUTPUT("terminal_switch_test", terminal_switch_test());
+	// TEST_OUTPUT("terminal_count_test", terminal_count_test());
+	// TEST_OUTPUT("serial_backend_test", serial_backend_test());
+	// TEST_OUTPUT("line_discipline_test", line_discipline_test());
+	// TEST_OUTPUT("keyboard_ring_test", keyboard_ring_test());
+	// TEST_OUTPUT("keyboard_map_test", keyboard_map_test());
 }
 
@@ -0,0 +1,199 @@
+#include "timer.h"
+#include "lib.h"
+
+#define TIMER_ROOT_MASK (TIMER_ROOT_SIZE - 1)
+#define TIMER_LEVEL_MASK (TIMER_LEVEL_SIZE - 1)
+
+static ktimer_t* timer_root[TIMER_ROOT_SIZE];                   // slot i - timers expiring at a tick with low bits i
+static ktimer_t* timer_levels[TIMER_LEVELS][TIMER_LEVEL_SIZE];
+static uint32_t timer_jiffies = 0;                              // the next tick timer_tick runs
+
+/*
+* timer_link
+*   DESCRIPTION: put a timer into the slot of the wheel its expiry falls in, called with interrupts off
+*   INPUTS: timer - a timer that is not pending
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: clamps the expiry to TIMER_MAX_TICKS from now
+*/
+static void timer_link(ktimer_t* timer)
+{
+    uint32_t idx = timer->expires - timer_jiffies;
+    ktimer_t** slot;
+    int32_t level;
+
+    if ((int32_t)idx < 0) {
+        // already due, runs on the next tick
+        slot = &timer_root[timer_jiffies & TIMER_ROOT_MASK];
+    } else if (idx < TIMER_ROOT_SIZE) {
+        slot = &timer_root[timer->expires & TIMER_ROOT_MASK];
+    } else {
+        if (idx > TIMER_MAX_TICKS) {
+            timer->expires = timer_jiffies + TIMER_MAX_TICKS;
+            idx = TIMER_MAX_TICKS;
+        }
+        // the lowest level whose range holds idx
+        for (level = 0; level < TIMER_LEVELS - 1; level++) {
+            if (idx < (1U << (TIMER_ROOT_BITS + (level + 1) * TIMER_LEVEL_BITS))) {
+                break;
+            }
+        }
+        slot = &timer_levels[level][(timer->expires >> (TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK];
+    }
+    timer->next = *slot;
+    if (*slot != NULL) {
+        (*slot)->pprev = &timer->next;
+    }
+    *slot = timer;
+    timer->pprev = slot;
+}
+
+/*
+* timer_unlink
+*   DESCRIPTION: take a pending timer out of its slot, called with interrupts off
+*   INPUTS: timer - a pending timer
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: the timer is no longer pending
+*/
+static void timer_unlink(ktimer_t* timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/*
+* timer_cascade
+*   DESCRIPTION: move the timers of one slot of an upper level into the levels below, now that the
+*                lower levels have come around to them
+*   INPUTS: level - the upper level
+*           index - the slot
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+static void timer_cascade(int32_t level, int32_t index)
+{
+    ktimer_t* timer;
+
+    while ((timer = timer_levels[level][index]) != NULL) {
+        timer_unlink(timer);
+        timer_link(timer);
+    }
+}
+
+/*
+* timer_init
+*   DESCRIPTION: set up a timer that is not pending
+*   INPUTS: timer - the timer
+*           func - called with data when the timer fires
+*           data - argument of func
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void timer_init(ktimer_t* timer, timer_func_t func, uint32_t data)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+}
+
+/*
+* timer_add
+*   DESCRIPTION: start a timer, restarting it if it is pending. O(1)
+*   INPUTS: timer - a timer set up by timer_init
+*           expires - pit_ticks at which it fires, a tick in the past fires on the next tick
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: none
+*/
+void timer_add(ktimer_t* timer, uint32_t expires)
+{
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (timer->pprev != NULL) {
+        timer_unlink(timer);
+    }
+    timer->expires = expires;
+    timer_link(timer);
+    restore_flags(flags);
+}
+
+/*
+* timer_del
+*   DESCRIPTION: stop a timer. O(1)
+*   INPUTS: timer - a timer set up by timer_init
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if the timer was pending, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+int32_t timer_del(ktimer_t* timer)
+{
+    uint32_t flags;
+    int32_t pending = 0;
+
+    cli_and_save(flags);
+    if (timer->pprev != NULL) {
+        timer_unlink(timer);
+        pending = 1;
+    }
+    restore_flags(flags);
+    return pending;
+}
+
+/*
+* timer_pending
+*   DESCRIPTION: check whether a timer has been started and has not fired or been stopped
+*   INPUTS: timer - a timer set up by timer_init
+*   OUTPUTS: none
+*   RETURN VALUE: 1 if pending, 0 otherwise
+*   SIDE EFFECTS: none
+*/
+int32_t timer_pending(const ktimer_t* timer)
+{
+    return timer->pprev != NULL;
+}
+
+/*
+* timer_tick
+*   DESCRIPTION: run the timers that expired up to tick now. Each tick looks at one root slot, and every
+*                256 ticks one slot of the level above is spread out, so the cost does not grow with the
+*                number of pending timers
+*   INPUTS: now - the current tick
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: calls the functions of the expired timers, with interrupts off
+*/
+void timer_tick(uint32_t now)
+{
+    ktimer_t* timer;
+    int32_t index, level, slot;
+
+    while ((int32_t)(now - timer_jiffies) >= 0) {
+        index = timer_jiffies & TIMER_ROOT_MASK;
+        // the root level wrapped around, bring down the next slot of each level that wrapped
+        if (index == 0) {
+            for (level = 0; level < TIMER_LEVELS; level++) {
+                slot = (timer_jiffies >> (TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS)) & TIMER_LEVEL_MASK;
+                timer_cascade(level, slot);
+                if (slot != 0) {
+                    break;
+                }
+            }
+        }
+        // timers the functions add for this tick or earlier go to the next slot
+        timer_jiffies++;
+        while ((timer = timer_root[index]) != NULL) {
+            timer_unlink(timer);
+            timer->func(timer->data);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/* timer.h - Defines for the kernel timer wheel driven by the PIT
+ */
+#ifndef TIMER_H
+#define TIMER_H
+#include "types.h"
+
+// the wheel has a root level of 256 slots, one tick each, and 3 levels of 64 slots that each cover
+// 64 slots of the level below; a timer is kept in the lowest level its expiry fits in and moves down
+// a level every time the level below wraps around
+#define TIMER_ROOT_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_LEVELS 3
+#define TIMER_ROOT_SIZE (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE (1 << TIMER_LEVEL_BITS)
+// timers further away are clamped to this many ticks, about 7 days at 100 Hz
+#define TIMER_MAX_TICKS ((1 << (TIMER_ROOT_BITS + TIMER_LEVELS * TIMER_LEVEL_BITS)) - 1)
+
+typedef void (*timer_func_t)(uint32_t data);
+
+// a timer, embedded in whatever it wakes up. Not pending while pprev is NULL
+typedef struct ktimer_t
+{
+    struct ktimer_t* next;
+    struct ktimer_t** pprev;        // the pointer to this timer in its slot list
+    uint32_t expires;               // pit_ticks at which the timer fires
+    timer_func_t func;              // runs in the PIT handler with interrupts off
+    uint32_t data;                  // argument of func
+} ktimer_t;
+
+// set up a timer that is not pending
+extern void timer_init(ktimer_t* timer, timer_func_t func, uint32_t data);
+// start timer to fire at pit_ticks expires, restarting it if it is pending
+extern void timer_add(ktimer_t* timer, uint32_t expires);
+// stop timer, 1 if it was pending
+extern int32_t timer_del(ktimer_t* timer);
+// 1 if timer has not fired yet
+extern int32_t timer_pending(const ktimer_t* timer);
+// run the timers that expired up to tick now, called by the PIT handler
+extern void timer_tick(uint32_t now);
+
+#endif
@@ -0,0 +1,198 @@
+#include "trace.h"
+#include "lib.h"
+#include "system_calls.h"
+#include "page.h"
+
+volatile uint32_t trace_enabled = 0;
+
+static trace_entry_t trace_ring[TRACE_ENTRIES];     // completed calls, oldest at trace_head
+static uint32_t trace_head = 0;
+static uint32_t trace_count = 0;
+static uint32_t trace_hist[TRACE_SYSCALLS][TRACE_BUCKETS];
+
+/*
+* trace_log
+*   DESCRIPTION: add a completed call to the ring buffer and its histogram
+*   INPUTS: entry - the call
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: overwrites the oldest entry when the ring buffer is full
+*/
+static void trace_log(const trace_entry_t* entry)
+{
+    uint32_t flags;
+    uint32_t bucket;
+    uint32_t cycles;
+
+    // bucket of the highest set bit, calls of 0 or 1 cycles go in bucket 0
+    bucket = 0;
+    for (cycles = entry->cycles; cycles > 1; cycles >>= 1) {
+        bucket++;
+    }
+
+    cli_and_save(flags);
+    trace_ring[(trace_head + trace_count) % TRACE_ENTRIES] = *entry;
+    if (trace_count == TRACE_ENTRIES) {
+        trace_head = (trace_head + 1) % TRACE_ENTRIES;
+    } else {
+        trace_count++;
+    }
+    if (entry->num < TRACE_SYSCALLS) {
+        trace_hist[entry->num][bucket]++;
+    }
+    restore_flags(flags);
+}
+
+/*
+* trace_begin
+*   DESCRIPTION: start timing a system call of the current process. halt does not return, so it is
+*                logged right away with its status as the return value
+*   INPUTS: num - system call number
+*           arg1, arg2, arg3 - arguments in ebx, ecx, edx
+*   OUTPUTS: none
+*   RETURN VALUE: num, for the linkage to dispatch on
+*   SIDE EFFECTS: records the call in the pcb
+*/
+int32_t trace_begin(int32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    trace_call_t* call = &get_cur_pcb_ptr()->trace;
+
+    call->entry.pid = get_pid();
+    call->entry.num = num;
+    call->entry.args[0] = arg1;
+    call->entry.args[1] = arg2;
+    call->entry.args[2] = arg3;
+    call->entry.ret = 0;
+    call->entry.cycles = 0;
+
+    // 1 - halt
+    if (num == 1) {
+        call->entry.ret = arg1 & 0xFF;
+        trace_log(&call->entry);
+    }
+
+    asm volatile("rdtsc" : "=a"(call->start_lo), "=d"(call->start_hi));
+    return num;
+}
+
+/*
+* trace_end
+*   DESCRIPTION: finish timing the system call started by trace_begin. This runs on the stack of the
+*                caller, which is also the right process after an execute that returns from halt
+*   INPUTS: ret - return value of the call
+*   OUTPUTS: none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: logs the call, except for the systrace calls of the trace reader
+*/
+void trace_end(int32_t ret)
+{
+    uint32_t lo, hi;
+    trace_call_t* call = &get_cur_pcb_ptr()->trace;
+
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+
+    // 15 - systrace
+    if (call->entry.num == 15) {
+        return;
+    }
+
+    // borrow from the high word when the low word wrapped
+    hi -= call->start_hi + (lo < call->start_lo ? 1 : 0);
+    lo -= call->start_lo;
+    call->entry.cycles = (hi != 0) ? 0xFFFFFFFF : lo;
+    call->entry.ret = ret;
+    trace_log(&call->entry);
+}
+
+/*
+* trace_read
+*   DESCRIPTION: copy the trace or the histograms out for TRACE_READ and TRACE_HIST, without checking
+*                that buf belongs to the caller. systrace checks it first, kernel callers pass their own
+*   INPUTS: cmd - TRACE_READ or TRACE_HIST
+*           buf - buffer to fill
+*           nbytes - size of buf
+*   OUTPUTS: TRACE_READ fills buf with whole trace_entry_t, oldest first, and removes them from the
+*            trace. TRACE_HIST fills buf with TRACE_SYSCALLS rows of TRACE_BUCKETS counts
+*   RETURN VALUE: number of bytes copied, -1 on failure
+*   SIDE EFFECTS: none
+*/
+int32_t trace_read(int32_t cmd, void* buf, int32_t nbytes)
+{
+    uint32_t flags;
+    uint32_t i;
+    uint32_t n;
+    trace_entry_t* out;
+
+    if (buf == NULL || nbytes < 0) {
+        return -1;
+    }
+    switch (cmd) {
+    case TRACE_READ:
+        out = (trace_entry_t*)buf;
+        cli_and_save(flags);
+        n = nbytes / sizeof(trace_entry_t);
+        if (n > trace_count) {
+            n = trace_count;
+        }
+        for (i = 0; i < n; i++) {
+            out[i] = trace_ring[trace_head];
+            trace_head = (trace_head + 1) % TRACE_ENTRIES;
+        }
+        trace_count -= n;
+        restore_flags(flags);
+        return n * sizeof(trace_entry_t);
+
+    case TRACE_HIST:
+        if (nbytes < (int32_t)sizeof(trace_hist)) {
+            return -1;
+        }
+        cli_and_save(flags);
+        memcpy(buf, trace_hist, sizeof(trace_hist));
+        restore_flags(flags);
+        return sizeof(trace_hist);
+
+    default:
+        return -1;
+    }
+}
+
+/*
+* systrace
+*   DESCRIPTION: system call to start and stop tracing and to read the trace
+*   INPUTS: cmd - TRACE_OFF, TRACE_ON, TRACE_READ or TRACE_HIST
+*           buf - buffer for TRACE_READ and TRACE_HIST
+*           nbytes - size of buf
+*   OUTPUTS: see trace_read
+*   RETURN VALUE: number of bytes copied, 0 for TRACE_OFF and TRACE_ON, -1 on failure
+*   SIDE EFFECTS: none
+*/
+int32_t systrace(int32_t cmd, void* buf, int32_t nbytes)
+{
+    uint32_t flags;
+
+    switch (cmd) {
+    case TRACE_OFF:
+        trace_enabled = 0;
+        return 0;
+
+    case TRACE_ON:
+        cli_and_save(flags);
+        trace_head = 0;
+        trace_count = 0;
+        memset(trace_hist, 0, sizeof(trace_hist));
+        trace_enabled = 1;
+        restore_flags(flags);
+        return 0;
+
+    case TRACE_READ:
+    case TRACE_HIST:
+        // the copy runs in ring 0, buf must be writable memory of the caller
+        if (buf == NULL || nbytes < 0 || !user_range_ok(buf, nbytes, 1)) {
+            return -1;
+        }
+        return trace_read(cmd, buf, nbytes);
+
+    default:
+        return -1;
+    }
+}
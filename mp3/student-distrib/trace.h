@@ -0,0 +1,46 @@
+/* trace.h - Defines for the system call trace and latency histograms
+ */
+#ifndef TRACE_H
+#define TRACE_H
+#include "types.h"
+
+#define TRACE_ENTRIES 256       // completed calls kept in the ring buffer, the oldest are overwritten
+#define TRACE_SYSCALLS 26       // histograms for system call numbers 0 - 25
+#define TRACE_BUCKETS 32        // bucket i counts calls that took 2^i to 2^(i+1) - 1 cycles
+
+// commands of the systrace system call
+#define TRACE_OFF 0             // stop recording
+#define TRACE_ON 1              // clear the trace and the histograms and start recording
+#define TRACE_READ 2            // move the oldest entries into the buffer
+#define TRACE_HIST 3            // copy the histograms into the buffer
+
+// one completed system call
+typedef struct trace_entry_t
+{
+    uint32_t pid;               // caller
+    uint32_t num;               // system call number
+    uint32_t args[3];           // ebx, ecx, edx
+    int32_t ret;                // return value, the status for halt
+    uint32_t cycles;            // time stamp counter cycles from dispatch to return, saturated at 2^32 - 1
+} trace_entry_t;
+
+// the call a process is making, kept in its pcb while the call runs
+typedef struct trace_call_t
+{
+    trace_entry_t entry;
+    uint32_t start_lo;          // time stamp counter at dispatch
+    uint32_t start_hi;
+} trace_call_t;
+
+// 1 - the system call linkages dispatch through trace_begin and trace_end
+extern volatile uint32_t trace_enabled;
+
+// called by the system call linkages around a traced call
+extern int32_t trace_begin(int32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+extern void trace_end(int32_t ret);
+// system call 15, control and read the trace
+extern int32_t systrace(int32_t cmd, void* buf, int32_t nbytes);
+// TRACE_READ and TRACE_HIST into a kernel buffer
+extern int32_t trace_read(int32_t cmd, void* buf, int32_t nbytes);
+
+#endif
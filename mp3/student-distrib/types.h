@@ -21,6 +21,19 @@ typedef unsigned short uint16_t;
 typedef char int8_t;
 typedef unsigned char uint8_t;
 
+/* One buffer of a vectored read or write (readv/writev), same layout as the user's struct */
+typedef struct iovec_t {
+    void* base;
+    int32_t len;
+} iovec_t;
+
+/* One file descriptor watched by poll, same layout as the user's struct */
+typedef struct pollfd_t {
+    int32_t fd;
+    int16_t events;         // conditions to report
+    int16_t revents;        // conditions found, filled by poll
+} pollfd_t;
+
 #endif /* ASM */
 
 #endif /* _TYPES_H */
@@ -0,0 +1,80 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define LINESIZE 128
+#define NUMSIZE 11
+#define RTC_FREQ 2
+
+/* user_data of the two kinds of reads */
+#define TAG_LINE 1
+#define TAG_TICK 2
+
+static struct ece391_aio_ring* ring;
+
+static void
+submit_read (int32_t fd, void* buf, int32_t nbytes, uint32_t tag)
+{
+    struct ece391_aio_sqe* sqe = &ring->sq[ring->sq_tail % AIO_SQ_ENTRIES];
+
+    sqe->opcode = AIO_READ;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->nbytes = nbytes;
+    sqe->user_data = tag;
+    ring->sq_tail++;
+}
+
+/*
+ * Wait on the keyboard and the RTC at once: count ticks while lines are
+ * typed, and report the count with each line.  "quit" ends the program.
+ */
+int main ()
+{
+    int32_t rtc_fd, freq, ticks, n;
+    uint8_t* line;
+    uint8_t num[NUMSIZE];
+    struct ece391_aio_cqe cqe;
+
+    if (-1 == ece391_aio_setup (&ring)) {
+        ece391_fdputs (1, (uint8_t*)"aio_setup failed\n");
+	return 2;
+    }
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"rtc open failed\n");
+	return 2;
+    }
+    freq = RTC_FREQ;
+    ece391_write (rtc_fd, &freq, 4);
+
+    /* the line is read into the buffer area of the ring */
+    line = AIO_DATA (ring);
+    submit_read (0, line, LINESIZE - 1, TAG_LINE);
+    submit_read (rtc_fd, 0, 0, TAG_TICK);
+    ticks = 0;
+
+    ece391_fdputs (1, (uint8_t*)"type lines, \"quit\" to stop\n");
+    while (1) {
+	ece391_aio_enter (ring->sq_tail - ring->sq_head, 1);
+	while (ring->cq_head != ring->cq_tail) {
+	    cqe = ring->cq[ring->cq_head % AIO_CQ_ENTRIES];
+	    ring->cq_head++;
+	    if (TAG_TICK == cqe.user_data) {
+	        ticks++;
+		submit_read (rtc_fd, 0, 0, TAG_TICK);
+		continue;
+	    }
+	    if (0 > (n = cqe.res))
+	        return 3;
+	    line[n] = '\0';
+	    if (0 == ece391_strncmp (line, (uint8_t*)"quit", 4))
+	        return 0;
+	    ece391_itoa (ticks, num, 10);
+	    ece391_fdputs (1, num);
+	    ece391_fdputs (1, (uint8_t*)" ticks: ");
+	    ece391_fdputs (1, line);
+	    submit_read (0, line, LINESIZE - 1, TAG_LINE);
+	}
+    }
+}
@@ -3,17 +3,14 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-int main ()
+/* copy one file to the standard output */
+static int32_t
+cat_one (const uint8_t* fname)
 {
     int32_t fd, cnt;
     uint8_t buf[1024];
 
-    if (0 != ece391_getargs (buf, 1024)) {
-        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
-	return 3;
-    }
-
-    if (-1 == (fd = ece391_open (buf))) {
+    if (-1 == (fd = ece391_open (fname))) {
         ece391_fdputs (1, (uint8_t*)"file not found\n");
 	return 2;
     }
@@ -26,6 +23,25 @@ int main ()
 	if (-1 == ece391_write (1, buf, cnt))
 	    return 3;
     }
+    ece391_close (fd);
+
+    return 0;
+}
+
+/* cat file... - print the files one after the other */
+int main (int32_t argc, uint8_t* argv[])
+{
+    int32_t i, rval;
+
+    if (argc < 2) {
+        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+	return 3;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (0 != (rval = cat_one (argv[i])))
+	    return rval;
+    }
 
     return 0;
 }
@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <termios.h>
 #include <unistd.h>
 
 #include "ece391support.h"
@@ -49,13 +51,30 @@ DO_CALL(ece391_halt,1 /* SYS_HALT */);
 DO_CALL(__ece391_read,3 /* SYS_READ */);
 DO_CALL(__ece391_write,4 /* SYS_WRITE */);
 DO_CALL(__ece391_close,6 /* SYS_CLOSE */);
+/* Linux readv/writev take the same 32-bit iovec layout */
+DO_CALL(ece391_readv,145 /* Linux SYS_readv */);
+DO_CALL(ece391_writev,146 /* Linux SYS_writev */);
+/* struct pollfd and the POLL bits match Linux */
+DO_CALL(ece391_poll,168 /* Linux SYS_poll */);
+DO_CALL(ece391_dup,41 /* Linux SYS_dup */);
+DO_CALL(ece391_dup2,63 /* Linux SYS_dup2 */);
 
-/* Call the main() function, then halt with its return value. */
+/* 
+ * Call the main() function with argc, argv and envp, as the ECE391
+ * kernel leaves them, then halt with its return value.  Linux puts the
+ * arrays themselves on the stack.
+ */
 
 asm volatile ("                         \n\
 .GLOBAL _start                          \n\
 _start:                                 \n\
 	MOVL	%ESP,start_esp          \n\
+	MOVL	(%ESP),%ECX             \n\
+	LEAL	4(%ESP),%EAX            \n\
+	LEAL	8(%ESP,%ECX,4),%EDX     \n\
+	PUSHL	%EDX                    \n\
+	PUSHL	%EAX                    \n\
+	PUSHL	%ECX                    \n\
         CALL	main                    \n\
 	PUSHL	%EAX                    \n\
 	CALL	ece391_halt             \n\
@@ -64,10 +83,11 @@ _start:                                 \n\
 /* end of fake container function */
 }
 
-int32_t 
-ece391_execute (const uint8_t* command)
+/* fork and exec a command, return the Linux pid */
+static pid_t
+start_program (const uint8_t* command)
 {
-    int status;
+    pid_t pid;
     uint8_t buf[1026];
     char* args[1024];
     uint8_t* scan;
@@ -98,11 +118,17 @@ ece391_execute (const uint8_t* command)
 	}
     }
     args[n_arg] = NULL;
-    if (0 == fork ()) {
+    if (0 == (pid = fork ())) {
 	execv ((char*)buf, args);
         kill (getpid (), 9);
     }
-    (void)wait (&status);
+    return pid;
+}
+
+/* what ece391_execute returns for a Linux wait status */
+static int32_t
+exit_value (int status)
+{
     if (WIFEXITED (status))
         return WEXITSTATUS (status);
     if (9 == WTERMSIG (status))
@@ -110,6 +136,37 @@ ece391_execute (const uint8_t* command)
     return 256;
 }
 
+int32_t 
+ece391_execute (const uint8_t* command)
+{
+    int status;
+    pid_t pid;
+
+    if (-1 == (pid = start_program (command)))
+        return -1;
+    (void)waitpid (pid, &status, 0);
+    return exit_value (status);
+}
+
+int32_t 
+ece391_spawn (const uint8_t* command)
+{
+    return start_program (command);
+}
+
+int32_t 
+ece391_waitpid (int32_t pid, int32_t* status, int32_t options)
+{
+    int st;
+    pid_t rval;
+
+    /* WNOHANG has the Linux value */
+    rval = waitpid (pid, &st, options);
+    if (0 < rval && NULL != status)
+        *status = exit_value (st);
+    return rval;
+}
+
 int32_t 
 ece391_open (const uint8_t* filename)
 {
@@ -205,6 +262,42 @@ ece391_read (int32_t fd, void* buf, int32_t nbytes)
     return copied;
 }
 
+int32_t 
+ece391_getdents (int32_t fd, struct ece391_dirent* buf, int32_t nbytes)
+{
+    struct dirent* de;
+    struct stat st;
+    int32_t count, len;
+
+    if (NULL == dir || dir_fd != fd ||
+        nbytes < (int32_t)sizeof (struct ece391_dirent))
+        return -1;
+    count = 0;
+    while ((count + 1) * (int32_t)sizeof (struct ece391_dirent) <= nbytes &&
+	   NULL != (de = readdir (dir))) {
+	len = 0;
+	while (32 > len && '\0' != de->d_name[len]) {
+	    buf[count].name[len] = de->d_name[len];
+	    len++;
+	}
+	while (32 > len)
+	    buf[count].name[len++] = '\0';
+	buf[count].inode = de->d_ino;
+	buf[count].file_type = 0;
+	buf[count].length = 0;
+	if (0 == stat (de->d_name, &st)) {
+	    if (S_ISDIR (st.st_mode))
+	        buf[count].file_type = 1;
+	    else if (S_ISREG (st.st_mode)) {
+	        buf[count].file_type = 2;
+		buf[count].length = st.st_size;
+	    }
+	}
+	count++;
+    }
+    return count * sizeof (struct ece391_dirent);
+}
+
 int32_t 
 ece391_write (int32_t fd, const void* buf, int32_t nbytes)
 {
@@ -213,6 +306,68 @@ ece391_write (int32_t fd, const void* buf, int32_t nbytes)
     return -1;
 }
 
+int32_t 
+ece391_isatty (int32_t fd)
+{
+    return isatty (fd);
+}
+
+int32_t 
+ece391_systrace (int32_t cmd, void* buf, int32_t nbytes)
+{
+    /* there is no kernel trace to read under Linux */
+    return -1;
+}
+
+int32_t 
+ece391_aio_setup (struct ece391_aio_ring** ring)
+{
+    /* the ring is a kernel mapping, there is none under Linux */
+    return -1;
+}
+
+int32_t 
+ece391_aio_enter (int32_t to_submit, int32_t min_complete)
+{
+    return -1;
+}
+
+int32_t 
+ece391_sleep (int32_t ms)
+{
+    /* a Linux poll on nothing waits for the timeout */
+    return (-1 == ece391_poll (NULL, 0, ms)) ? -1 : 0;
+}
+
+int32_t 
+ece391_alarm (int32_t ms)
+{
+    /* ALARM is not mapped to a Linux signal */
+    return -1;
+}
+
+int32_t 
+ece391_ioctl (int32_t fd, int32_t cmd, int32_t arg)
+{
+    struct termios tio;
+    int32_t old;
+
+    if (0 != tcgetattr (fd, &tio))
+        return -1;
+    old = (tio.c_lflag & ICANON) ? TERM_COOKED : TERM_RAW;
+    if (TERM_RAW == cmd) {
+        tio.c_lflag &= ~(ICANON | ECHO);
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+    } else if (TERM_COOKED == cmd) {
+        tio.c_lflag |= ICANON | ECHO;
+    } else {
+        return -1;
+    }
+    /* arrow keys stay escape sequences under Linux */
+    return (0 == tcsetattr (fd, TCSANOW, &tio)) ? old : -1;
+}
+
 int32_t 
 ece391_close (int32_t fd)
 {
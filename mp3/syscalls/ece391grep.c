@@ -6,17 +6,15 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* print the lines of fd that contain s, prefixed with fname unless it is 0 */
 int32_t
-do_one_file (const char* s, const char* fname) 
+do_one_fd (int32_t fd, const char* s, const char* fname) 
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
+    int32_t cnt, last, line_start, line_end, check, s_len, n;
     uint8_t data[BUFSIZE+1];
+    struct ece391_iovec iov[4];
 
     s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
-        ece391_fdputs (1, (uint8_t*)"file open failed\n");
-        return -1;
-    }
     last = 0;
     while (1) {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
@@ -30,7 +28,9 @@ do_one_file (const char* s, const char* fname)
 	    line_end = line_start;
 	    while (line_end < last && '\n' != data[line_end])
 		line_end++;
-	    if ('\n' != data[line_end] && 0 != cnt && line_start != 0) {
+	    /* a pipe may hand over part of a line, read the rest while there is room */
+	    if (line_end == last && 0 != cnt &&
+	        (line_start != 0 || last < BUFSIZE)) {
 		/* copy from line_start to last down to 0 and fix last */
 		data[line_end] = '\0';
 		ece391_strcpy (data, data + line_start);
@@ -42,10 +42,19 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    /* file name, colon, line and newline in one call */
+		    n = 0;
+		    if (0 != fname) {
+			iov[n].base = (void*)fname;
+			iov[n++].len = ece391_strlen ((uint8_t*)fname);
+			iov[n].base = ":";
+			iov[n++].len = 1;
+		    }
+		    iov[n].base = data + line_start;
+		    iov[n++].len = line_end - line_start;
+		    iov[n].base = "\n";
+		    iov[n++].len = 1;
+		    ece391_writev (1, iov, n);
 		    break;
 		}
 	    }
@@ -58,6 +67,20 @@ do_one_file (const char* s, const char* fname)
 	if (0 == cnt)
 	    break;
     }
+    return 0;
+}
+
+int32_t
+do_one_file (const char* s, const char* fname) 
+{
+    int32_t fd;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+        ece391_fdputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+    if (0 != do_one_fd (fd, s, fname))
+        return -1;
     if (-1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
         return -1;
@@ -65,16 +88,32 @@ do_one_file (const char* s, const char* fname)
     return 0;
 }
 
-int main ()
+/*
+ * grep pattern [file...] - search the named files, the standard input in
+ * a pipeline (cat frame0.txt | grep fish), or else every file
+ */
+int main (int32_t argc, uint8_t* argv[])
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, i;
     uint8_t buf[SBUFSIZE];
-    uint8_t search[BUFSIZE];
+    uint8_t* search;
 
-    if (0 != ece391_getargs (search, BUFSIZE)) {
+    if (argc < 2) {
         ece391_fdputs (1, (uint8_t*)"could not read argument\n");
         return 3;
     }
+    search = argv[1];
+
+    if (argc > 2) {
+        for (i = 2; i < argc; i++) {
+	    if (0 != do_one_file ((char*)search, (char*)argv[i]))
+	        return 3;
+	}
+	return 0;
+    }
+
+    if (0 == ece391_isatty (0))
+        return (0 != do_one_fd (0, (char*)search, 0)) ? 3 : 0;
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
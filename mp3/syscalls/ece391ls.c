@@ -3,25 +3,74 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define NAMELEN 32
+#define NENTRIES 16
+#define ARGSIZE 16
+/* "t " + 10 digit size + " " + name + "\n" per entry */
+#define LINESIZE (2 + 10 + 1 + NAMELEN + 1)
+
+static const uint8_t type_char[3] = {'c', 'd', '-'};
+
+/* append the file name (up to 32 bytes, not always terminated) to out */
+static int32_t
+put_name (uint8_t* out, const uint8_t* name)
+{
+    int32_t len;
+
+    for (len = 0; len < NAMELEN && '\0' != name[len]; len++)
+        out[len] = name[len];
+    return len;
+}
+
+/* append "t       size " for ls -l, the size right-aligned in 10 columns */
+static int32_t
+put_long (uint8_t* out, const struct ece391_dirent* de)
+{
+    uint8_t num[11];
+    int32_t len, pad, i;
+
+    out[0] = (de->file_type < 3) ? type_char[de->file_type] : '?';
+    out[1] = ' ';
+    ece391_itoa (de->length, num, 10);
+    len = ece391_strlen (num);
+    pad = 10 - len;
+    for (i = 0; i < pad; i++)
+        out[2 + i] = ' ';
+    ece391_strcpy (out + 2 + pad, num);
+    out[12] = ' ';
+    return 13;
+}
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, n, i, pos, long_format;
+    struct ece391_dirent de[NENTRIES];
+    uint8_t out[NENTRIES * LINESIZE];
+    uint8_t args[ARGSIZE];
+
+    long_format = (0 == ece391_getargs (args, ARGSIZE) &&
+		   0 == ece391_strcmp (args, (uint8_t*)"-l"));
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* each call returns up to NENTRIES entries, printed with one write */
+    while (0 != (cnt = ece391_getdents (fd, de, sizeof (de)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
+	    n = cnt / sizeof (struct ece391_dirent);
+	    pos = 0;
+	    for (i = 0; i < n; i++) {
+	        if (long_format)
+	            pos += put_long (out + pos, &de[i]);
+	        pos += put_name (out + pos, de[i].name);
+	        out[pos++] = '\n';
+	    }
+	    if (-1 == ece391_write (1, out, pos))
 	        return 3;
     }
 
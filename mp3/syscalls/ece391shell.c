@@ -5,6 +5,82 @@
 
 #define BUFSIZE 1024
 
+/* 
+ * Check the '|' operators of a command line: every program of a
+ * pipeline needs a name.  The kernel's execute starts the programs.
+ */
+static int32_t
+pipeline_ok (const uint8_t* buf)
+{
+    int32_t blank = 1, pipes = 0;
+
+    for (; '\0' != *buf; buf++) {
+        if ('|' == *buf) {
+	    if (blank)
+	        return 0;
+	    blank = 1;
+	    pipes++;
+	} else if (' ' != *buf)
+	    blank = 0;
+    }
+    return !blank || 0 == pipes;
+}
+
+/* print how a command ended, from the value execute returns */
+static void
+report (int32_t rval)
+{
+    if (-1 == rval)
+        ece391_fdputs (1, (uint8_t*)"no such command\n");
+    else if (256 == rval)
+        ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
+    else if (0 != rval)
+        ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+}
+
+/* "[3] " */
+static void
+put_job (int32_t pid)
+{
+    uint8_t num[11];
+
+    ece391_itoa (pid, num, 10);
+    ece391_fdputs (1, (uint8_t*)"[");
+    ece391_fdputs (1, num);
+    ece391_fdputs (1, (uint8_t*)"] ");
+}
+
+/* collect the background jobs that have finished */
+static void
+reap_jobs (void)
+{
+    int32_t pid, status;
+
+    while (0 < (pid = ece391_waitpid (-1, &status, WNOHANG))) {
+        put_job (pid);
+	ece391_fdputs (1, (uint8_t*)"done\n");
+	report (status);
+    }
+}
+
+/*
+ * Strip a trailing '&' and the blanks around it; return 1 if there
+ * was one.
+ */
+static int32_t
+background (uint8_t* buf, int32_t cnt)
+{
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    if (0 == cnt || '&' != buf[cnt - 1])
+        return 0;
+    cnt--;
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    buf[cnt] = '\0';
+    return 1;
+}
+
 int main ()
 {
     int32_t cnt, rval;
@@ -12,6 +88,7 @@ int main ()
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        reap_jobs ();
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -24,13 +101,24 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
-	if (-1 == rval)
-	    ece391_fdputs (1, (uint8_t*)"no such command\n");
-	else if (256 == rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
-	else if (0 != rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	if (!pipeline_ok (buf)) {
+	    ece391_fdputs (1, (uint8_t*)"missing command in pipeline\n");
+	    continue;
+	}
+	if (background (buf, cnt)) {
+	    if ('\0' == buf[0] || !pipeline_ok (buf)) {
+	        ece391_fdputs (1, (uint8_t*)"missing command before '&'\n");
+		continue;
+	    }
+	    if (-1 == (rval = ece391_spawn (buf))) {
+	        report (rval);
+		continue;
+	    }
+	    put_job (rval);
+	    ece391_fdputs (1, (uint8_t*)"started\n");
+	    continue;
+	}
+	report (ece391_execute (buf));
     }
 }
 
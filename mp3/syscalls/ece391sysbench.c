@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+#include "ece391sysnum.h"
+
+#define ITERATIONS 10000
+#define ROUNDS 8
+#define NUMSIZE 11
+
+typedef int32_t (*syscall_fn) (int32_t number, uint32_t arg1,
+			       uint32_t arg2, uint32_t arg3);
+
+/* low 32 bits of the time stamp counter, enough for one round */
+static uint32_t
+read_tsc (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+/*
+ * Cycles per call of the given system call, the best of ROUNDS rounds so
+ * that timer interrupts and other terminals do not count.
+ */
+static uint32_t
+measure (syscall_fn call, int32_t number, uint32_t arg1)
+{
+    uint32_t start, cycles, best;
+    int32_t i, r;
+
+    best = 0xFFFFFFFF;
+    for (r = 0; r < ROUNDS; r++) {
+        start = read_tsc ();
+	for (i = 0; i < ITERATIONS; i++)
+	    call (number, arg1, 0, 0);
+	cycles = read_tsc () - start;
+	if (cycles < best)
+	    best = cycles;
+    }
+    return best / ITERATIONS;
+}
+
+static void
+report (const char* name, uint32_t int_cycles, uint32_t fast_cycles)
+{
+    uint8_t num[NUMSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, (uint8_t*)"  int 0x80: ");
+    ece391_itoa (int_cycles, num, 10);
+    ece391_fdputs (1, num);
+    ece391_fdputs (1, (uint8_t*)"  sysenter: ");
+    ece391_itoa (fast_cycles, num, 10);
+    ece391_fdputs (1, num);
+    ece391_fdputs (1, (uint8_t*)" cycles/call\n");
+}
+
+int main ()
+{
+    /* number 0 is rejected right away, it measures entry and exit only */
+    report ("null  ", measure (ece391_syscall_int, 0, 0),
+	    measure (ece391_syscall_fast, 0, 0));
+    report ("isatty", measure (ece391_syscall_int, SYS_ISATTY, 1),
+	    measure (ece391_syscall_fast, SYS_ISATTY, 1));
+
+    return 0;
+}
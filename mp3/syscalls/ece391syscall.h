@@ -5,6 +5,97 @@
 
 /* All calls return >= 0 on success or -1 on failure. */
 
+/* One buffer of a vectored read or write; up to 16 buffers per call. */
+struct ece391_iovec {
+	void* base;
+	int32_t len;
+};
+
+/* One file descriptor watched by poll; same layout and bits as Linux. */
+struct ece391_pollfd {
+	int32_t fd;		/* negative entries are skipped */
+	int16_t events;
+	int16_t revents;	/* filled by poll */
+};
+
+#define POLLIN		0x01	/* read will not block */
+#define POLLOUT		0x04	/* write will not block */
+#define POLLHUP		0x10	/* the other end of a pipe is closed */
+#define POLLNVAL	0x20	/* fd is not open */
+
+/* Commands of ioctl on the terminal; both return the mode before. */
+#define TERM_COOKED	0	/* read returns an edited line (the default) */
+#define TERM_RAW	1	/* read returns keys as typed, no echo; arrows etc. are 0x80-0x89, F1-F12 0x90-0x9B */
+
+/* Option of waitpid. */
+#define WNOHANG		1	/* return 0 if no spawned child has halted yet */
+
+/* One directory entry returned by getdents. */
+struct ece391_dirent {
+	uint8_t name[32];	/* zero-padded, not necessarily null-terminated */
+	uint32_t file_type;	/* 0 rtc, 1 directory, 2 regular file */
+	uint32_t inode;
+	uint32_t length;	/* file size in bytes, 0 if not a regular file */
+};
+
+/* Commands of systrace. */
+#define TRACE_OFF	0	/* stop recording */
+#define TRACE_ON	1	/* clear the trace and start recording */
+#define TRACE_READ	2	/* move the oldest entries into buf */
+#define TRACE_HIST	3	/* copy the histograms into buf */
+
+#define TRACE_SYSCALLS	26	/* histogram rows, one per call number */
+#define TRACE_BUCKETS	32	/* bucket i counts calls of 2^i to 2^(i+1)-1 cycles */
+
+/* One completed system call read with TRACE_READ. */
+struct ece391_trace_entry {
+	uint32_t pid;
+	uint32_t num;
+	uint32_t args[3];
+	int32_t ret;		/* the status for halt */
+	uint32_t cycles;	/* saturated at 2^32-1 */
+};
+
+/*
+ * Asynchronous I/O ring mapped by aio_setup.  The program writes
+ * submissions at sq[sq_tail % AIO_SQ_ENTRIES] and bumps sq_tail, then
+ * calls aio_enter; completions appear at cq[cq_head % AIO_CQ_ENTRIES]
+ * up to cq_tail.  Read and write buffers must lie in the 4kB buffer
+ * area right after the ring page (AIO_DATA (ring)).  Terminal reads
+ * complete when a line is entered and RTC reads on the next tick.
+ */
+#define AIO_SQ_ENTRIES	64
+#define AIO_CQ_ENTRIES	128
+#define AIO_DATA_SIZE	4096
+#define AIO_DATA(ring)	((uint8_t*)(ring) + 4096)
+
+#define AIO_NOP		0
+#define AIO_READ	1
+#define AIO_WRITE	2
+
+struct ece391_aio_sqe {
+	uint32_t opcode;
+	int32_t fd;
+	void* buf;
+	int32_t nbytes;
+	uint32_t user_data;
+};
+
+struct ece391_aio_cqe {
+	uint32_t user_data;
+	int32_t res;
+};
+
+struct ece391_aio_ring {
+	volatile uint32_t sq_head;	/* advanced by the kernel */
+	volatile uint32_t sq_tail;	/* advanced by the program */
+	volatile uint32_t cq_head;	/* advanced by the program */
+	volatile uint32_t cq_tail;	/* advanced by the kernel */
+	volatile uint32_t cq_overflow;	/* completions lost to a full queue */
+	struct ece391_aio_sqe sq[AIO_SQ_ENTRIES];
+	struct ece391_aio_cqe cq[AIO_CQ_ENTRIES];
+};
+
 /*  
  * Note that the system call for halt will have to make sure that only
  * the low byte of EBX (the status argument) is returned to the calling
@@ -21,6 +112,38 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov,
+			     int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov,
+			      int32_t iovcnt);
+extern int32_t ece391_getdents (int32_t fd, struct ece391_dirent* buf,
+				int32_t nbytes);
+extern int32_t ece391_isatty (int32_t fd);
+extern int32_t ece391_systrace (int32_t cmd, void* buf, int32_t nbytes);
+extern int32_t ece391_aio_setup (struct ece391_aio_ring** ring);
+extern int32_t ece391_aio_enter (int32_t to_submit, int32_t min_complete);
+/* timeout in milliseconds, 0 to check once, negative to wait forever */
+extern int32_t ece391_poll (struct ece391_pollfd* fds, int32_t nfds,
+			    int32_t timeout);
+/* times in milliseconds, rounded up to 10 ms timer ticks */
+extern int32_t ece391_sleep (int32_t ms);
+/* ALARM after ms, 0 cancels; returns what was left of the previous alarm */
+extern int32_t ece391_alarm (int32_t ms);
+/* start a command without waiting; returns the pid to pass to waitpid */
+extern int32_t ece391_spawn (const uint8_t* command);
+/* pid -1 waits for any spawned child; status gets what execute returns */
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+/* copy fd to the lowest free descriptor, or to newfd after closing it */
+extern int32_t ece391_dup (int32_t fd);
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+/* switch the terminal fd reads from to TERM_RAW or back to TERM_COOKED */
+extern int32_t ece391_ioctl (int32_t fd, int32_t cmd, int32_t arg);
+
+/* Make system call number with three arguments through int 0x80 or SYSENTER. */
+extern int32_t ece391_syscall_int (int32_t number, uint32_t arg1,
+				   uint32_t arg2, uint32_t arg3);
+extern int32_t ece391_syscall_fast (int32_t number, uint32_t arg1,
+				    uint32_t arg2, uint32_t arg3);
 
 enum signums {
 	DIV_ZERO = 0,
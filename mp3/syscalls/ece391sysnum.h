@@ -11,5 +11,20 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_READV   11
+#define SYS_WRITEV  12
+#define SYS_GETDENTS 13
+#define SYS_ISATTY  14
+#define SYS_SYSTRACE 15
+#define SYS_AIO_SETUP 16
+#define SYS_AIO_ENTER 17
+#define SYS_POLL    18
+#define SYS_SLEEP   19
+#define SYS_ALARM   20
+#define SYS_SPAWN   21
+#define SYS_WAITPID 22
+#define SYS_DUP     23
+#define SYS_DUP2    24
+#define SYS_IOCTL   25
 
 #endif /* ECE391SYSNUM_H */
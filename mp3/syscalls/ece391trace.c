@@ -0,0 +1,132 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ARGSIZE 16
+#define NENTRIES 32
+#define LINESIZE 128
+
+static const char* const names[TRACE_SYSCALLS] = {
+    "invalid", "halt", "execute", "read", "write", "open", "close",
+    "getargs", "vidmap", "set_handler", "sigreturn", "readv", "writev",
+    "getdents", "isatty", "systrace", "aio_setup", "aio_enter",
+    "poll", "sleep", "alarm", "spawn", "waitpid",
+    "dup", "dup2", "ioctl"
+};
+
+/* append s to line at pos, return the new position */
+static int32_t
+put_str (uint8_t* line, int32_t pos, const char* s)
+{
+    while ('\0' != *s)
+        line[pos++] = *s++;
+    return pos;
+}
+
+static int32_t
+put_num (uint8_t* line, int32_t pos, uint32_t value, int32_t radix)
+{
+    uint8_t num[11];
+
+    if (16 == radix)
+        pos = put_str (line, pos, "0x");
+    ece391_itoa (value, num, radix);
+    return put_str (line, pos, (char*)num);
+}
+
+/* "pid 2 read(0x0, 0x83ffe10, 0x80) = 12  4711 cycles" */
+static void
+print_entry (const struct ece391_trace_entry* te)
+{
+    uint8_t line[LINESIZE];
+    int32_t pos, i;
+
+    pos = put_str (line, 0, "pid ");
+    pos = put_num (line, pos, te->pid, 10);
+    line[pos++] = ' ';
+    pos = put_str (line, pos, te->num < TRACE_SYSCALLS ? names[te->num] : "?");
+    line[pos++] = '(';
+    for (i = 0; i < 3; i++) {
+        if (0 != i)
+	    pos = put_str (line, pos, ", ");
+	pos = put_num (line, pos, te->args[i], 16);
+    }
+    pos = put_str (line, pos, ") = ");
+    if (0 > te->ret) {
+        line[pos++] = '-';
+	pos = put_num (line, pos, -te->ret, 10);
+    } else {
+        pos = put_num (line, pos, te->ret, 10);
+    }
+    line[pos++] = ' ';
+    line[pos++] = ' ';
+    pos = put_num (line, pos, te->cycles, 10);
+    pos = put_str (line, pos, " cycles\n");
+    ece391_write (1, line, pos);
+}
+
+/* one line per call number, "read: 2^9 4  2^10 17" */
+static void
+print_histograms (void)
+{
+    static uint32_t hist[TRACE_SYSCALLS][TRACE_BUCKETS];
+    uint8_t line[TRACE_BUCKETS * 20];
+    int32_t num, b, pos;
+
+    if (-1 == ece391_systrace (TRACE_HIST, hist, sizeof (hist))) {
+        ece391_fdputs (1, (uint8_t*)"histogram read failed\n");
+	return;
+    }
+    ece391_fdputs (1, (uint8_t*)"cycles histogram (bucket 2^i holds 2^i to 2^(i+1)-1):\n");
+    for (num = 0; num < TRACE_SYSCALLS; num++) {
+        pos = put_str (line, 0, names[num]);
+	line[pos++] = ':';
+	for (b = 0; b < TRACE_BUCKETS; b++) {
+	    if (0 == hist[num][b])
+	        continue;
+	    pos = put_str (line, pos, "  2^");
+	    pos = put_num (line, pos, b, 10);
+	    line[pos++] = ' ';
+	    pos = put_num (line, pos, hist[num][b], 10);
+	}
+	/* skip calls that were never made */
+	if (ece391_strlen ((uint8_t*)names[num]) + 1 == pos)
+	    continue;
+	line[pos++] = '\n';
+	ece391_write (1, line, pos);
+    }
+}
+
+/*
+ * trace on   - clear the trace and start recording every system call
+ * trace off  - stop recording
+ * trace      - print and remove the recorded calls, then the histograms
+ */
+int main ()
+{
+    uint8_t args[ARGSIZE];
+    struct ece391_trace_entry te[NENTRIES];
+    int32_t cnt, i;
+
+    if (0 == ece391_getargs (args, ARGSIZE)) {
+        if (0 == ece391_strcmp (args, (uint8_t*)"on"))
+	    return (-1 == ece391_systrace (TRACE_ON, 0, 0)) ? 2 : 0;
+        if (0 == ece391_strcmp (args, (uint8_t*)"off"))
+	    return (-1 == ece391_systrace (TRACE_OFF, 0, 0)) ? 2 : 0;
+	ece391_fdputs (1, (uint8_t*)"usage: trace [on|off]\n");
+	return 3;
+    }
+
+    while (0 < (cnt = ece391_systrace (TRACE_READ, te, sizeof (te)))) {
+	for (i = 0; i < cnt / (int32_t)sizeof (struct ece391_trace_entry); i++)
+	    print_entry (&te[i]);
+    }
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"trace read failed\n");
+	return 2;
+    }
+    print_histograms ();
+
+    return 0;
+}